@@ -0,0 +1,146 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#include "types.hpp"
+#include "addressindex.hpp"
+
+/****************************************************************************/
+
+AddressIndex::AddressIndex()
+{
+  Count = 0;
+}
+
+void AddressIndex::Clear()
+{
+  sArray<sU64>().swap(Tree);
+  sArray<sInt>().swap(TreeRank);
+  sArray<sU64>().swap(Starts);
+  sArray<sU64>().swap(Ends);
+  sArray<sInt>().swap(Ids);
+  Count = 0;
+}
+
+void AddressIndex::Add(sU64 start,sU64 length)
+{
+  sVERIFY(Starts.empty() || start >= Starts.back());
+
+  if(length)
+  {
+    if(!Ends.empty() && Ends.back() > start)
+      Ends.back() = start;
+
+    Starts.push_back(start);
+    Ends.push_back(start + length);
+    Ids.push_back(Count);
+  }
+
+  Count++;
+}
+
+// in-order walk of the implicit tree hands out the sorted positions
+void AddressIndex::BuildTree(sInt node,sInt &next)
+{
+  if(node >= Tree.size())
+    return;
+
+  BuildTree(2*node,next);
+  Tree[node] = Starts[next];
+  TreeRank[node] = next++;
+  BuildTree(2*node+1,next);
+}
+
+void AddressIndex::Build()
+{
+  sInt n = Starts.size();
+  Tree.assign(n + 1,0);
+  TreeRank.assign(n + 1,n);
+
+  sInt next = 0;
+  BuildTree(1,next);
+}
+
+sInt AddressIndex::Lookup(sU64 addr,sInt *next) const
+{
+  sInt n = Starts.size();
+
+  // descend to the first start > addr; the path taken is encoded in k
+  sInt k = 1;
+  while(k <= n)
+    k = 2*k + (Tree[k] <= addr);
+
+  // strip the trailing right turns and the final left turn
+  while(k & 1)
+    k >>= 1;
+  k >>= 1;
+
+  sInt above = k ? TreeRank[k] : n; // sorted position of the first start > addr
+  if(above > 0 && addr < Ends[above-1])
+    return above - 1;
+
+  if(next)
+    *next = above;
+  return -1;
+}
+
+sInt AddressIndex::Find(sU64 addr,sInt *next) const
+{
+  sInt above;
+  sInt pos = Lookup(addr,&above);
+  if(pos >= 0)
+    return Ids[pos];
+
+  if(next)
+    *next = (above < Ids.size()) ? Ids[above] : -1;
+  return -1;
+}
+
+void AddressIndex::FindAll(const sU64 *addrs,sInt count,sInt *ids) const
+{
+  sBool sorted = true;
+  for(sInt i=1;i<count && sorted;i++)
+    sorted = addrs[i-1] <= addrs[i];
+
+  if(!sorted)
+  {
+    for(sInt i=0;i<count;i++)
+      ids[i] = Find(addrs[i]);
+    return;
+  }
+
+  // pos = number of starts <= the current address. It only moves forward;
+  // big gaps between addresses are crossed by galloping ahead.
+  sInt n = Starts.size();
+  sInt pos = 0;
+  for(sInt i=0;i<count;i++)
+  {
+    sU64 addr = addrs[i];
+
+    if(pos < n && Starts[pos] <= addr)
+    {
+      sInt step = 1;
+      sInt lo = pos;
+      while(lo + step < n && Starts[lo + step] <= addr)
+      {
+        lo += step;
+        step *= 2;
+      }
+
+      // Starts[lo] <= addr, first start > addr is in (lo,lo+step]
+      sInt hi = (lo + step < n) ? lo + step : n;
+      while(hi - lo > 1)
+      {
+        sInt mid = (lo + hi) / 2;
+        if(Starts[mid] <= addr)
+          lo = mid;
+        else
+          hi = mid;
+      }
+      pos = hi;
+    }
+
+    ids[i] = (pos > 0 && addr < Ends[pos-1]) ? Ids[pos-1] : -1;
+  }
+}
+
+/****************************************************************************/
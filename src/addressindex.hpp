@@ -0,0 +1,52 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __ADDRESSINDEX_HPP__
+#define __ADDRESSINDEX_HPP__
+
+#include "types.hpp"
+
+/****************************************************************************/
+
+// Finds which of a set of address ranges contains an address. Ranges are
+// added in ascending order of their start (a range that overlaps the next
+// one is cut short) and identified by the order they were added in; empty
+// ones are counted but never found. The starts are kept in Eytzinger
+// (breadth first) order, so a lookup walks down an implicit binary tree
+// whose top levels share a few cache lines. Lookups of many addresses at
+// once that come in ascending order are done in one merge pass instead.
+
+class AddressIndex
+{
+  sArray<sU64> Tree;                // starts, Eytzinger order, 1-based
+  sArray<sInt> TreeRank;            // sorted position of each tree node
+  sArray<sU64> Starts;              // non-empty ranges, sorted
+  sArray<sU64> Ends;
+  sArray<sInt> Ids;                 // range id of each sorted position
+  sInt Count;                       // ranges added, including empty ones
+
+  void BuildTree(sInt node,sInt &next);
+  sInt Lookup(sU64 addr,sInt *next) const; // sorted position, -1 = miss
+
+public:
+  AddressIndex();
+
+  void Clear();
+  void Add(sU64 start,sU64 length);
+  void Build();                     // after the last Add, before lookups
+
+  sInt GetCount() const             { return Count; }
+
+  // id of the range containing addr, or -1. On a miss, *next (if given)
+  // gets the id of the first range starting after addr, or -1.
+  sInt Find(sU64 addr,sInt *next = 0) const;
+
+  // ids[i] = Find(addrs[i]). Ascending addresses are looked up in a single
+  // merge pass; anything else falls back to one Find per address.
+  void FindAll(const sU64 *addrs,sInt count,sInt *ids) const;
+};
+
+/****************************************************************************/
+
+#endif
@@ -0,0 +1,282 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#pragma warning(disable:4996)
+#include "types.hpp"
+#include "cache.hpp"
+#include "snapshot.hpp"
+#include "pdbfile.hpp"
+#include "mappedfile.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(WIN32)
+#include <windows.h>
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+/****************************************************************************/
+
+static const sChar *CacheExtension = ".snap";
+static const sChar *TempExtension = ".tmp";
+static const sInt StaleTempSeconds = 3600; // surely not still being written
+
+struct CacheEntry
+{
+  std::string Name;
+  sU64 Size;
+  sU64 Time;
+  sBool Temp;
+
+  bool operator <(const CacheEntry &b) const
+  {
+    return Time < b.Time || Time == b.Time && Name < b.Name;
+  }
+};
+
+static sBool HasExtension(const std::string &name,const sChar *ext)
+{
+  sInt len = sGetStringLen(ext);
+  return name.size() > len && !name.compare(name.size() - len,len,ext);
+}
+
+// entries, and temporaries of Store ("<key>.snap.<pid>.<address>.tmp")
+static sBool GetEntryType(const std::string &name,sBool &temp)
+{
+  temp = HasExtension(name,TempExtension) && name.find(std::string(CacheExtension) + ".") != std::string::npos;
+  return temp || HasExtension(name,CacheExtension);
+}
+
+#if defined(WIN32)
+
+static void MakeDirectory(const sChar *dir)
+{
+  _mkdir(dir);
+}
+
+static sBool RenameOver(const sChar *from,const sChar *to)
+{
+  return MoveFileExA(from,to,MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+static sInt CurrentProcessId()
+{
+  return (sInt) GetCurrentProcessId();
+}
+
+// in FILETIME units, like CacheEntry::Time
+static sU64 StaleTempTime()
+{
+  FILETIME now;
+  GetSystemTimeAsFileTime(&now);
+  return ((sU64(now.dwHighDateTime) << 32) | now.dwLowDateTime) - sU64(StaleTempSeconds) * 10000000;
+}
+
+static void ListEntries(const std::string &dir,sArray<CacheEntry> &entries)
+{
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileA((dir + "\\*").c_str(),&data);
+  if(find == INVALID_HANDLE_VALUE)
+    return;
+
+  do
+  {
+    CacheEntry entry;
+    entry.Name = data.cFileName;
+    if((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !GetEntryType(entry.Name,entry.Temp))
+      continue;
+
+    entry.Size = (sU64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    entry.Time = (sU64(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+    entries.push_back(entry);
+  }
+  while(FindNextFileA(find,&data));
+
+  FindClose(find);
+}
+
+#else
+
+static void MakeDirectory(const sChar *dir)
+{
+  mkdir(dir,0777);
+}
+
+static sBool RenameOver(const sChar *from,const sChar *to)
+{
+  return rename(from,to) == 0;
+}
+
+static sInt CurrentProcessId()
+{
+  return (sInt) getpid();
+}
+
+// in seconds, like CacheEntry::Time
+static sU64 StaleTempTime()
+{
+  return sU64(time(0)) - StaleTempSeconds;
+}
+
+static void ListEntries(const std::string &dir,sArray<CacheEntry> &entries)
+{
+  DIR *d = opendir(dir.c_str());
+  if(!d)
+    return;
+
+  while(struct dirent *ent = readdir(d))
+  {
+    CacheEntry entry;
+    entry.Name = ent->d_name;
+    if(!GetEntryType(entry.Name,entry.Temp))
+      continue;
+
+    struct stat st;
+    if(stat((dir + "/" + entry.Name).c_str(),&st) != 0 || !S_ISREG(st.st_mode))
+      continue;
+
+    entry.Size = st.st_size;
+    entry.Time = st.st_mtime;
+    entries.push_back(entry);
+  }
+
+  closedir(d);
+}
+
+#endif
+
+// contents hash for inputs without a debug id, 64 bits at a time
+static sU64 HashData(const sU8 *data,sU64 size)
+{
+  sU64 hash = 0xcbf29ce484222325ull;
+  sU64 i;
+
+  for(i=0;i+8<=size;i+=8)
+  {
+    sU64 word;
+    sCopyMem(&word,data + i,8);
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29;
+  }
+
+  for(;i<size;i++)
+    hash = (hash ^ data[i]) * 0x100000001b3ull;
+
+  return hash;
+}
+
+/****************************************************************************/
+
+DebugInfoCache::DebugInfoCache(const sChar *dir,sU64 maxBytes)
+  : Dir(dir), MaxBytes(maxBytes)
+{
+  while(Dir.size() > 1 && (Dir[Dir.size()-1] == '/' || Dir[Dir.size()-1] == '\\'))
+    Dir.erase(Dir.size() - 1);
+}
+
+std::string DebugInfoCache::GetPath(const std::string &key) const
+{
+  return Dir + "/" + key + CacheExtension;
+}
+
+sBool DebugInfoCache::GetKey(const sChar *fileName,std::string &key)
+{
+  sChar buffer[128];
+  sU8 id[20];
+
+  if(PDBFileReader::GetDebugId(fileName,id))
+  {
+    sChar *p = buffer + sSPrintF(buffer,sizeof(buffer),"pdb-");
+    for(sInt i=0;i<16;i++)
+      p += sSPrintF(p,3,"%02x",id[i]);
+
+    sU32 age = id[16] | (id[17] << 8) | (id[18] << 16) | (sU32(id[19]) << 24);
+    sSPrintF(p,16,"-%x",age);
+  }
+  else
+  {
+    MappedFile file;
+    if(!file.Open(fileName))
+      return false;
+
+    sSPrintF(buffer,sizeof(buffer),"file-%016llx-%llx",
+      (unsigned long long) HashData(file.GetData(),file.GetSize()),(unsigned long long) file.GetSize());
+  }
+
+  key = buffer;
+  return true;
+}
+
+sBool DebugInfoCache::Load(const std::string &key,DebugInfo &info)
+{
+  std::string path = GetPath(key);
+  if(!DebugInfoSnapshot::IsSnapshot(path.c_str()) || !DebugInfoSnapshot::Load(path.c_str(),info))
+    return false;
+
+  utime(path.c_str(),0); // most recently used now
+  return true;
+}
+
+sBool DebugInfoCache::Store(const std::string &key,const DebugInfo &info)
+{
+  MakeDirectory(Dir.c_str());
+
+  // unique per process and DebugInfo, diffs store two at the same time
+  sChar suffix[64];
+  sSPrintF(suffix,sizeof(suffix),".%d.%p.tmp",CurrentProcessId(),(const void *) &info);
+
+  std::string path = GetPath(key);
+  std::string temp = path + suffix;
+  if(!DebugInfoSnapshot::Save(temp.c_str(),info))
+    return false;
+
+  if(!RenameOver(temp.c_str(),path.c_str()))
+  {
+    remove(temp.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+void DebugInfoCache::Trim(const sArray<std::string> &keep)
+{
+  sArray<CacheEntry> entries;
+  ListEntries(Dir,entries);
+
+  // other processes may be writing temporaries right now; only old ones go
+  sU64 staleTime = StaleTempTime();
+  sU64 total = 0;
+  sInt count = 0;
+  for(sInt i=0;i<entries.size();i++)
+  {
+    const CacheEntry &entry = entries[i];
+    if(!entry.Temp)
+    {
+      total += entry.Size;
+      entries[count++] = entry;
+    }
+    else if(entry.Time < staleTime)
+      remove((Dir + "/" + entry.Name).c_str());
+  }
+  entries.resize(count);
+
+  std::sort(entries.begin(),entries.end());
+  for(sInt i=0;i<entries.size() && total > MaxBytes;i++)
+  {
+    sBool kept = false;
+    for(sInt j=0;j<keep.size() && !kept;j++)
+      kept = entries[i].Name == keep[j] + CacheExtension;
+
+    if(!kept && remove((Dir + "/" + entries[i].Name).c_str()) == 0)
+      total -= entries[i].Size;
+  }
+}
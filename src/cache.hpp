@@ -0,0 +1,44 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __CACHE_HPP__
+#define __CACHE_HPP__
+
+#include "debuginfo.hpp"
+
+/****************************************************************************/
+
+// A directory of snapshots (see DebugInfoSnapshot) of inputs that were
+// read before, named after what identifies the input: GUID and age of the
+// PDB for executables and PDBs, a hash of the contents for anything else.
+// New entries are written under a temporary name and renamed, so several
+// processes can share one cache. The directory is kept below a size limit
+// by deleting the least recently used entries; using an entry updates its
+// modification time. Trim is called once all inputs of a run are in, so
+// a diff can't evict one of its own inputs to make room for the other.
+
+class DebugInfoCache
+{
+  std::string Dir;
+  sU64 MaxBytes;
+
+  std::string GetPath(const std::string &key) const;
+
+public:
+  DebugInfoCache(const sChar *dir,sU64 maxBytes);
+
+  static sBool GetKey(const sChar *fileName,std::string &key);
+
+  // info as for DebugInfoSnapshot::Load, false on a miss
+  sBool Load(const std::string &key,DebugInfo &info);
+  sBool Store(const std::string &key,const DebugInfo &info);
+
+  // deletes the least recently used entries until the rest fits, except
+  // for the given keys, and temporaries left by interrupted writes
+  void Trim(const sArray<std::string> &keep);
+};
+
+/****************************************************************************/
+
+#endif
@@ -4,57 +4,276 @@
 #pragma warning(disable:4996)
 #include "types.hpp"
 #include "debuginfo.hpp"
-#include <stdarg.h>
+#include "mappedfile.hpp"
+#include "reportwriter.hpp"
 #include <algorithm>
 #include <map>
 
+#if defined(WIN32)
 #include <windows.h>
 #include <DbgHelp.h>
+#pragma comment(lib,"DbgHelp.lib")
+#else
+#include <ctype.h>
+#include <cxxabi.h>
+#endif
 
 #include "sutil.h"
 
 #define ONLY_APEX 1
 
-#pragma comment(lib,"DbgHelp.lib")
+/****************************************************************************/
+
+void DIU64Column::Unpack()
+{
+	Wide.assign(Narrow.begin(),Narrow.end());
+	sArray<sU32>().swap(Narrow);
+	Packed = false;
+}
+
+void DIU64Column::SetPacked(sBool packed)
+{
+	sVERIFY(empty());
+	Packed = packed;
+}
+
+void DIU64Column::clear()
+{
+	Narrow.clear();
+	Wide.clear();
+}
+
+void DIU64Column::reserve(sInt count)
+{
+	if(Packed)
+		Narrow.reserve(count);
+	else
+		Wide.reserve(count);
+}
+
+void DIU64Column::append(const DIU64Column &other)
+{
+	if(Packed && !other.Packed)
+	{
+		for(sInt i=0;i<other.size() && Packed;i++)
+			if(other.Wide[i] > 0xffffffffu)
+				Unpack();
+	}
+
+	if(Packed)
+	{
+		if(other.Packed)
+			Narrow.insert(Narrow.end(),other.Narrow.begin(),other.Narrow.end());
+		else
+		{
+			for(sInt i=0;i<other.size();i++)
+				Narrow.push_back((sU32) other.Wide[i]);
+		}
+	}
+	else
+	{
+		if(other.Packed)
+			Wide.insert(Wide.end(),other.Narrow.begin(),other.Narrow.end());
+		else
+			Wide.insert(Wide.end(),other.Wide.begin(),other.Wide.end());
+	}
+}
+
+void DIU64Column::assign(const sU64 *values,sInt count)
+{
+	clear();
+	if(Packed)
+	{
+		for(sInt i=0;i<count && Packed;i++)
+			if(values[i] > 0xffffffffu)
+				Unpack();
+	}
+
+	if(Packed)
+		Narrow.assign(values,values + count);
+	else
+		Wide.assign(values,values + count);
+}
+
+template<class T> static void PermuteColumn(sArray<T> &column,const sArray<sInt> &order)
+{
+	sArray<T> out(order.size());
+	for(sInt i=0;i<order.size();i++)
+		out[i] = column[order[i]];
+
+	column.swap(out);
+}
+
+void DIU64Column::Permute(const sArray<sInt> &order)
+{
+	if(Packed)
+		PermuteColumn(Narrow,order);
+	else
+		PermuteColumn(Wide,order);
+}
 
 /****************************************************************************/
 
-sU32 DebugInfo::CountSizeInClass(sInt type) const
+void DISymbolTable::clear()
 {
-	sU32 size = 0;
-	for(sInt i=0;i<Symbols.size();i++)
-		size += (Symbols[i].Class == type) ? Symbols[i].Size : 0;
+	name.clear();
+	mangledName.clear();
+	NameSpNum.clear();
+	objFileNum.clear();
+	VA.clear();
+	Size.clear();
+	Class.clear();
+}
+
+void DISymbolTable::reserve(sInt count)
+{
+	name.reserve(count);
+	mangledName.reserve(count);
+	NameSpNum.reserve(count);
+	objFileNum.reserve(count);
+	VA.reserve(count);
+	Size.reserve(count);
+	Class.reserve(count);
+}
 
-	return size;
+void DISymbolTable::push_back(const DISymbol &sym)
+{
+	name.push_back(sym.name);
+	mangledName.push_back(sym.mangledName);
+	NameSpNum.push_back(sym.NameSpNum);
+	objFileNum.push_back(sym.objFileNum);
+	VA.push_back(sym.VA);
+	Size.push_back(sym.Size);
+	Class.push_back(sym.Class);
+}
+
+DISymbol DISymbolTable::Get(sInt i) const
+{
+	DISymbol sym = { name[i], mangledName[i], NameSpNum[i], objFileNum[i], VA[i], Size[i], Class[i] };
+	return sym;
 }
 
+void DISymbolTable::Permute(const sArray<sInt> &order)
+{
+	PermuteColumn(name,order);
+	PermuteColumn(mangledName,order);
+	PermuteColumn(NameSpNum,order);
+	PermuteColumn(objFileNum,order);
+	VA.Permute(order);
+	Size.Permute(order);
+	PermuteColumn(Class,order);
+}
+
+/****************************************************************************/
+
+static const sChar *ReportSectionNames[DIR_COUNT] =
+{
+  "functions", "templates", "data", "bss", "namespaces", "files"
+};
+
 void DebugInfo::Init()
 {
   BaseAddress = 0;
+  m_TotalHits = 0;
+  m_UnattributedHits = 0;
+
+  static const sU64 minSizes[DIR_COUNT] = { 512, 512, 1024, 1024, 2048, 2048 };
+  for(sInt i=0;i<DIR_COUNT;i++)
+  {
+    ReportLimits[i].minSize = minSizes[i];
+    ReportLimits[i].maxCount = 0;
+  }
+}
+
+sBool DebugInfo::SetReportMaxCount(const sChar *section,sInt maxCount)
+{
+  sBool found = false;
+  for(sInt i=0;i<DIR_COUNT;i++)
+  {
+    if(!section || !sCmpStringI(section,ReportSectionNames[i]))
+    {
+      ReportLimits[i].maxCount = maxCount;
+      found = true;
+    }
+  }
+
+  return found;
 }
 
 void DebugInfo::Exit()
 {
+	m_Strings.Clear();
+	sArray<sInt>().swap( m_FileByName );
+	sArray<sInt>().swap( m_NameSpByName );
+	sArray<sInt>().swap( m_NameSpBySymbol );
+	m_SymbolIndex.Clear();
+	sArray<sInt>().swap( m_TemplateBySymbol );
+	sArray<sU64>().swap( m_SymbolHits );
+
+	for( sInt i=0;i<m_Sources.size();i++ )
+		delete m_Sources[i];
+	m_Sources.clear();
 }
 
-sInt DebugInfo::MakeString( sChar *s )
+sInt DebugInfo::MakeString( const sChar *s )
 {
-	string str( s );
-	IndexByStringMap::iterator it = m_IndexByString.find( str );
-	if( it != m_IndexByString.end() )
-		return it->second;
+	return m_Strings.Intern( s, sGetStringLen(s) );
+}
 
-	sInt index = m_IndexByString.size();
-	m_IndexByString.insert( std::make_pair(str,index) );
-	m_StringByIndex.push_back( str );
-	return index;
+sInt DebugInfo::MakeStringRef( const sChar *s, sInt len )
+{
+	return m_Strings.Intern( s, len, StringPool::Hash(s,len), true );
 }
 
-bool virtAddressComp(const DISymbol &a,const DISymbol &b)
+void DebugInfo::MergePart( DebugInfo &part )
 {
-  return a.VA < b.VA;
+	// names point into those, so take them over
+	m_Strings.TakeArena( part.m_Strings );
+	m_Sources.insert( m_Sources.end(), part.m_Sources.begin(), part.m_Sources.end() );
+	part.m_Sources.clear();
+
+	sArray<sInt> stringMap( part.m_Strings.GetCount() );
+	for( sInt i=0;i<stringMap.size();i++ )
+	{
+		const sStringRef &str = part.m_Strings.Get(i);
+		stringMap[i] = m_Strings.Intern( str.Str, str.Len, part.m_Strings.GetHash(i), true );
+	}
+
+	sArray<sInt> fileMap( part.m_Files.size() );
+	for( sInt i=0;i<fileMap.size();i++ )
+		fileMap[i] = GetFile( stringMap[part.m_Files[i].fileName] );
+
+	sArray<sInt> nameSpMap( part.NameSps.size() );
+	for( sInt i=0;i<nameSpMap.size();i++ )
+		nameSpMap[i] = GetNameSpace( stringMap[part.NameSps[i].name] );
+
+	const DISymbolTable &in = part.Symbols;
+	Symbols.reserve( Symbols.size() + in.size() );
+	for( sInt i=0;i<in.size();i++ )
+	{
+		Symbols.name.push_back( stringMap[in.name[i]] );
+		Symbols.mangledName.push_back( stringMap[in.mangledName[i]] );
+		Symbols.NameSpNum.push_back( nameSpMap[in.NameSpNum[i]] );
+		Symbols.objFileNum.push_back( fileMap[in.objFileNum[i]] );
+	}
+
+	Symbols.VA.append( in.VA );
+	Symbols.Size.append( in.Size );
+	Symbols.Class.insert( Symbols.Class.end(), in.Class.begin(), in.Class.end() );
 }
 
+// symbol indices by virtual address (ties keep their order)
+struct VirtAddressOrder
+{
+  const DIU64Column &VA;
+
+  VirtAddressOrder(const DIU64Column &va) : VA(va) {}
+  bool operator()(sInt a,sInt b) const
+  {
+    return VA[a] < VA[b] || VA[a] == VA[b] && a < b;
+  }
+};
+
 static bool StripTemplateParams( std::string& str )
 {
 	bool isTemplate = false;
@@ -94,12 +313,13 @@ void DebugInfo::FinishedReading()
 	// fix strings and aggregate templates
 	typedef std::map<std::string, int> StringIntMap;
 	StringIntMap templateToIndex;
+	m_TemplateBySymbol.assign( Symbols.size(), -1 );
 
 	for(sInt i=0;i<Symbols.size();i++)
 	{
-		DISymbol *sym = &Symbols[i];
+		DISymbolTable::Ref sym = Symbols[i];
 
-		std::string templateName = GetStringPrep( sym->name );
+		std::string templateName = GetStringPrep( sym.name );
 		bool isTemplate = StripTemplateParams( templateName );
 		if( isTemplate )
 		{
@@ -108,7 +328,7 @@ void DebugInfo::FinishedReading()
 			if( it != templateToIndex.end() )
 			{
 				index = it->second;
-				Templates[index].size += sym->Size;
+				Templates[index].size += sym.Size;
 				Templates[index].count++;
 			}
 			else
@@ -118,225 +338,567 @@ void DebugInfo::FinishedReading()
 				TemplateSymbol tsym;
 				tsym.name = templateName;
 				tsym.count = 1;
-				tsym.size = sym->Size;
+				tsym.size = sym.Size;
+				tsym.hits = 0;
 				Templates.push_back( tsym );
 			}
+			m_TemplateBySymbol[i] = index;
 		}
 	}
 
   // sort symbols by virtual address
-  std::sort(Symbols.begin(),Symbols.end(),virtAddressComp);
-
-  // remove address double-covers
   sInt symCount = Symbols.size();
-  DISymbol *syms = new DISymbol[symCount];
-  sCopyMem(syms,&Symbols[0],symCount * sizeof(DISymbol));
+  sArray<sInt> order(symCount);
+  for(sInt i=0;i<symCount;i++)
+    order[i] = i;
+
+  std::sort(order.begin(),order.end(),VirtAddressOrder(Symbols.VA));
 
-  Symbols.clear();
-  sU32 oldVA = 0;
-  sInt oldSize = 0;
+  // remove address double-covers
+  sArray<sInt> kept;
+  kept.reserve(symCount);
+  sU64 oldVA = 0;
 
   for(sInt i=0;i<symCount;i++)
   {
-    DISymbol *in = &syms[i];
-    sU32 newVA = in->VA;
-    sU32 newSize = in->Size;
+    sInt in = order[i];
+    sU64 newVA = Symbols.VA[in];
+    sU64 newSize = Symbols.Size[in];
 
-    if(oldVA != 0)
+    if(oldVA != 0 && newVA < oldVA) // we have to shorten
     {
-      sInt adjust = newVA - oldVA;
-      if(adjust < 0) // we have to shorten
-      {
-        newVA = oldVA;
-        if(newSize >= -adjust)
-          newSize += adjust;
-      }
+      sU64 overlap = oldVA - newVA;
+      newVA = oldVA;
+      if(newSize >= overlap)
+        newSize -= overlap;
     }
 
-    if(newSize || in->Class == DIC_END)
+    if(newSize || Symbols.Class[in] == DIC_END)
     {
-		Symbols.push_back(DISymbol());
-		DISymbol *out = &Symbols.back();
-		*out = *in;
-		out->VA = newVA;
-		out->Size = newSize;
-      
+		Symbols.VA.Set(in,newVA);
+		Symbols.Size.Set(in,newSize);
+		kept.push_back(in);
+
 		oldVA = newVA + newSize;
-		oldSize = newSize;
     }
   }
 
-  delete[] syms;
+  Symbols.Permute(kept);
+  PermuteColumn(m_TemplateBySymbol,kept);
+
+  BuildSymbolIndex();
+}
+
+void DebugInfo::BuildSymbolIndex()
+{
+  m_SymbolIndex.Clear();
+  for(sInt i=0;i<Symbols.size();i++)
+    m_SymbolIndex.Add(Symbols.VA[i],Symbols.Size[i]);
+  m_SymbolIndex.Build();
+}
+
+// looks up the entry for a string id in one of the by-name tables
+static sInt &LookupByName( sArray<sInt> &table, sInt name, sInt stringCount )
+{
+	if( name >= table.size() )
+		table.resize( stringCount > name ? stringCount : name + 1, -1 );
+
+	return table[name];
 }
 
 sInt DebugInfo::GetFile( sInt fileName )
 {
-	for( sInt i=0;i<m_Files.size();i++ )
-		if( m_Files[i].fileName == fileName )
-			return i;
+	sInt &index = LookupByName( m_FileByName, fileName, m_Strings.GetCount() );
+	if( index >= 0 )
+		return index;
 
 	m_Files.push_back( DISymFile() );
 	DISymFile *file = &m_Files.back();
 	file->fileName = fileName;
-	file->codeSize = file->dataSize = 0;
+	file->codeSize = file->dataSize = file->bssSize = 0;
 
-	return m_Files.size() - 1;
+	index = m_Files.size() - 1;
+	return index;
 }
 
-sInt DebugInfo::GetFileByName( sChar *objName )
+sInt DebugInfo::GetFileByName( const sChar *objName )
 {
 	return GetFile( MakeString(objName) );
 }
 
 sInt DebugInfo::GetNameSpace(sInt name)
 {
-  for(sInt i=0;i<NameSps.size();i++)
-    if(NameSps[i].name == name)
-      return i;
+  sInt &index = LookupByName(m_NameSpByName,name,m_Strings.GetCount());
+  if(index >= 0)
+    return index;
 
   DISymNameSp namesp;
   namesp.name = name;
-  namesp.codeSize = namesp.dataSize = 0;
+  namesp.codeSize = namesp.dataSize = namesp.bssSize = 0;
   NameSps.push_back(namesp);
 
-  return NameSps.size() - 1;
+  index = NameSps.size() - 1;
+  return index;
 }
 
-sInt DebugInfo::GetNameSpaceByName(sChar *name)
+// Length of the class/namespace part of a symbol name: everything before
+// the last "::" or "." that isn't inside template arguments.
+static sInt ScopePrefixLength(const sChar *name)
 {
-  sChar *pp = name - 2;
-  sChar *p;
-  sInt cname;
-
-  while((p = (sChar *) sFindString(pp+2,"::")))
-    pp = p;
-
-  while((p = (sChar *) sFindString(pp+1,".")))
-    pp = p;
+  sInt depth = 0;
+  sInt prefix = 0;
 
-  if(pp != name - 2)
+  for(const sChar *p=name;*p;p++)
   {
-    sChar buffer[2048];
-    sCopyString(buffer,name,2048);
+    switch(*p)
+    {
+    case '<':
+      depth++;
+      break;
 
-    if(pp - name < 2048)
-      buffer[pp - name] = 0;
+    case '>': // unbalanced for operator>, operator-> etc.
+      if(depth)
+        depth--;
+      break;
+
+    case ':':
+      if(!depth && p[1] == ':')
+        prefix = p++ - name;
+      break;
 
-    cname = MakeString(buffer);
+    case '.':
+      if(!depth)
+        prefix = p - name;
+      break;
+    }
   }
+
+  return prefix;
+}
+
+sInt DebugInfo::GetNameSpaceByName(const sChar *name)
+{
+  sInt len = ScopePrefixLength(name);
+  sInt cname;
+
+  // the prefix gets hashed in place, and only copied if it's new
+  if(len)
+    cname = m_Strings.Intern(name,len);
   else
     cname = MakeString("<global>");
 
   return GetNameSpace(cname);
 }
 
+sInt DebugInfo::GetNameSpaceOf(sInt symbolName)
+{
+  sInt &nameSp = LookupByName(m_NameSpBySymbol,symbolName,m_Strings.GetCount());
+  if(nameSp < 0)
+    nameSp = GetNameSpaceByName(GetStringPrep(symbolName));
+
+  return nameSp;
+}
+
 void DebugInfo::StartAnalyze()
 {
   sInt i;
 
   for(i=0;i<m_Files.size();i++)
   {
-    m_Files[i].codeSize = m_Files[i].dataSize = 0;
+    m_Files[i].codeSize = m_Files[i].dataSize = m_Files[i].bssSize = 0;
+    m_Files[i].hits = 0;
   }
 
   for(i=0;i<NameSps.size();i++)
   {
-    NameSps[i].codeSize = NameSps[i].dataSize = 0;
+    NameSps[i].codeSize = NameSps[i].dataSize = NameSps[i].bssSize = 0;
+    NameSps[i].hits = 0;
+  }
+
+  for(i=0;i<Templates.size();i++)
+    Templates[i].hits = 0;
+
+  for(i=0;i<=DIC_UNKNOWN;i++)
+  {
+    ClassStats[i].totalSize = 0;
+    ClassStats[i].totalHits = 0;
+    ClassStats[i].count = 0;
+    ClassStats[i].reportSection = -1;
+    ClassStats[i].reportSymbols.clear();
   }
+
+  ClassStats[DIC_CODE].reportSection = DIR_FUNCTIONS;
+  ClassStats[DIC_DATA].reportSection = DIR_DATA;
+  ClassStats[DIC_BSS].reportSection = DIR_BSS;
 }
 
+// sizes of the things listed in the report, by index
+struct SymbolSize
+{
+  const DIU64Column &Size;
+  SymbolSize(const DIU64Column &size) : Size(size) {}
+  sU64 operator()(sInt i) const { return Size[i]; }
+};
+
+struct TemplateSize
+{
+  const sArray<TemplateSymbol> &Templates;
+  TemplateSize(const sArray<TemplateSymbol> &templates) : Templates(templates) {}
+  sU64 operator()(sInt i) const { return Templates[i].size; }
+};
+
+struct SymbolHits
+{
+  const sArray<sU64> &Hits;
+  SymbolHits(const sArray<sU64> &hits) : Hits(hits) {}
+  sU64 operator()(sInt i) const { return Hits[i]; }
+};
+
+struct TemplateHits
+{
+  const sArray<TemplateSymbol> &Templates;
+  TemplateHits(const sArray<TemplateSymbol> &templates) : Templates(templates) {}
+  sU64 operator()(sInt i) const { return Templates[i].hits; }
+};
+
+struct NameSpHits
+{
+  const sArray<DISymNameSp> &NameSps;
+  NameSpHits(const sArray<DISymNameSp> &namesps) : NameSps(namesps) {}
+  sU64 operator()(sInt i) const { return NameSps[i].hits; }
+};
+
+struct FileHits
+{
+  const sArray<DISymFile> &Files;
+  FileHits(const sArray<DISymFile> &files) : Files(files) {}
+  sU64 operator()(sInt i) const { return Files[i].hits; }
+};
+
+struct NameSpCodeSize
+{
+  const sArray<DISymNameSp> &NameSps;
+  NameSpCodeSize(const sArray<DISymNameSp> &namesps) : NameSps(namesps) {}
+  sU64 operator()(sInt i) const { return NameSps[i].codeSize; }
+};
+
+struct FileCodeSize
+{
+  const sArray<DISymFile> &Files;
+  FileCodeSize(const sArray<DISymFile> &files) : Files(files) {}
+  sU64 operator()(sInt i) const { return Files[i].codeSize; }
+};
+
+// biggest first, ties by index
+template<class SizeOf> struct BySize
+{
+  SizeOf Size;
+  BySize(const SizeOf &size) : Size(size) {}
+  bool operator()(sInt a,sInt b) const
+  {
+    sU64 sa = Size(a), sb = Size(b);
+    return sa > sb || sa == sb && a < b;
+  }
+};
+
+// Sorts the indices in list by size and keeps at most limit.maxCount of
+// them; with a count limit only the ones that stay get fully sorted.
+template<class SizeOf> static void SortTop(sArray<sInt> &list,const SizeOf &size,const DIReportLimit &limit)
+{
+  BySize<SizeOf> order(size);
+
+  if(limit.maxCount > 0 && list.size() > limit.maxCount)
+  {
+    std::partial_sort(list.begin(),list.begin() + limit.maxCount,list.end(),order);
+    list.resize(limit.maxCount);
+  }
+  else
+    std::sort(list.begin(),list.end(),order);
+}
+
+// indices of the (at most maxCount) items of at least minSize, biggest first
+template<class SizeOf> static void SelectTop(sInt count,const SizeOf &size,const DIReportLimit &limit,sArray<sInt> &list)
+{
+  list.clear();
+  for(sInt i=0;i<count;i++)
+    if(size(i) >= limit.minSize)
+      list.push_back(i);
+
+  SortTop(list,size,limit);
+}
+
+// One pass over the symbols for everything the report needs: totals per
+// class, code/data/BSS per object file and namespace, and the symbols big
+// enough to be listed. Profile hits are summed up in the same places.
 void DebugInfo::FinishAnalyze()
 {
 	sInt i;
+	const sU64 *hits = HasProfile() ? &m_SymbolHits[0] : 0;
 
 	for(i=0;i<Symbols.size();i++)
 	{
-		if( Symbols[i].Class == DIC_CODE )
+		sU64 size = Symbols.Size[i];
+		sInt type = Symbols.Class[i];
+		DIClassStats &stats = ClassStats[type];
+
+		stats.totalSize += size;
+		stats.count++;
+		if( stats.reportSection >= 0 && size >= ReportLimits[stats.reportSection].minSize )
+			stats.reportSymbols.push_back(i);
+
+		DISymFile &file = m_Files[Symbols.objFileNum[i]];
+		DISymNameSp &namesp = NameSps[Symbols.NameSpNum[i]];
+
+		switch( type )
 		{
-			m_Files[Symbols[i].objFileNum].codeSize += Symbols[i].Size;
-			NameSps[Symbols[i].NameSpNum].codeSize += Symbols[i].Size;
+		case DIC_CODE:
+			file.codeSize += size;
+			namesp.codeSize += size;
+			break;
+
+		case DIC_DATA:
+			file.dataSize += size;
+			namesp.dataSize += size;
+			break;
+
+		case DIC_BSS:
+			file.bssSize += size;
+			namesp.bssSize += size;
+			break;
 		}
-		else if( Symbols[i].Class == DIC_DATA )
+
+		if( hits && hits[i] )
 		{
-			m_Files[Symbols[i].objFileNum].dataSize += Symbols[i].Size;
-			NameSps[Symbols[i].NameSpNum].dataSize += Symbols[i].Size;
+			stats.totalHits += hits[i];
+			file.hits += hits[i];
+			namesp.hits += hits[i];
+			if( m_TemplateBySymbol[i] >= 0 )
+				Templates[m_TemplateBySymbol[i]].hits += hits[i];
 		}
 	}
+
+	for(i=0;i<=DIC_UNKNOWN;i++)
+	{
+		if( ClassStats[i].reportSection >= 0 )
+			SortTop(ClassStats[i].reportSymbols,SymbolSize(Symbols.Size),ReportLimits[ClassStats[i].reportSection]);
+	}
 }
 
-sBool DebugInfo::FindSymbol(sU32 VA,DISymbol **sym)
+sBool DebugInfo::FindSymbol(sU64 VA,sInt *index) const
 {
-  sInt l,r,x;
-
-  l = 0;
-  r = Symbols.size();
-  while(l<r)
-  {
-    x = (l + r) / 2;
-
-    if(VA < Symbols[x].VA)
-      r = x; // continue in left half
-    else if(VA >= Symbols[x].VA + Symbols[x].Size)
-      l = x + 1; // continue in left half
-    else
-    {
-      *sym = &Symbols[x]; // we found a match
-      return true;
-    }
-  }
+  sInt next;
+  sInt found = m_SymbolIndex.Find(VA,&next);
 
-  *sym = (l + 1 < Symbols.size()) ? &Symbols[l+1] : 0;
-  return false;
+  *index = (found >= 0) ? found : next;
+  return found >= 0;
 }
 
-static bool symSizeComp(const DISymbol &a,const DISymbol &b)
+void DebugInfo::FindSymbols(const sU64 *VAs,sInt count,sInt *indices) const
 {
-  return a.Size > b.Size;
+  m_SymbolIndex.FindAll(VAs,count,indices);
 }
 
-static bool templateSizeComp(const TemplateSymbol& a, const TemplateSymbol& b)
+static bool SampleLess(const DISample &a,const DISample &b)
 {
-	return a.size > b.size;
+  return a.RVA < b.RVA;
 }
 
-static bool nameCodeSizeComp( const DISymNameSp &a,const DISymNameSp &b )
+// Samples are sorted first so the whole block is looked up in one merge
+// pass over the symbol index.
+void DebugInfo::AddSamples(DISample *samples,sInt count)
 {
-	return a.codeSize > b.codeSize;
+  m_SymbolHits.resize(Symbols.size(),0);
+  if(count <= 0)
+    return;
+
+  std::sort(samples,samples + count,SampleLess);
+
+  sArray<sU64> VAs(count);
+  sArray<sInt> found(count);
+  for(sInt i=0;i<count;i++)
+    VAs[i] = samples[i].RVA;
+
+  FindSymbols(&VAs[0],count,&found[0]);
+
+  for(sInt i=0;i<count;i++)
+  {
+    sU64 hits = samples[i].Count;
+    m_TotalHits += hits;
+    if(found[i] >= 0)
+      m_SymbolHits[found[i]] += hits;
+    else
+      m_UnattributedHits += hits;
+  }
 }
 
-static bool fileCodeSizeComp(const DISymFile &a,const DISymFile &b)
+// name, size, hits and hits per KB of code
+// hits per KB is whole samples; split up so hits * 1024 can't overflow
+static void AddHeatRow(NVSHARE::HtmlTable *table,const char *name,sU64 size,sU64 hits)
 {
-	return a.codeSize > b.codeSize;
+	table->addColumn(name);
+	table->addColumn((unsigned long long) size);
+	table->addColumn((unsigned long long) hits);
+	table->addColumn((unsigned long long) (size ? hits / size * 1024 + hits % size * 1024 / size : 0));
 }
 
-static void sAppendPrintF(std::string &str,const char *format,...)
+static NVSHARE::HtmlTable *CreateHeatTable(NVSHARE::HtmlDocument *document,const char *heading,const char *header)
 {
-	static const int bufferSize = 512; // cut off after this
-	char buffer[bufferSize];
-	va_list arg;
-
-	va_start(arg,format);
-	_vsnprintf(buffer,bufferSize-1,format,arg);
-	va_end(arg);
-
-	strcpy(&buffer[bufferSize-4],"...");
-	str += buffer;
+	NVSHARE::HtmlTable *table = document->createHtmlTable(heading);
+	table->addHeader(header);
+	table->computeTotals();
+	table->excludeTotals(4);
+	table->addSort("Sorted by hits",3,false,2,false);
+	table->addSort("Sorted by hits per KB",4,false,3,false);
+	return table;
 }
 
 const char * GetUndecorate(const char *str)
 {
 	static std::string temp;
 	temp = str;
+#if defined(WIN32)
 	if ( *str == '?' )
 	{
 		char scratch[1024];
 		UnDecorateSymbolName( str, scratch, 1024, 0);
 		temp = scratch;
 	}
+#endif
 	return temp.c_str();
 }
 
-std::string DebugInfo::WriteReport()
+// Cuts the return type and parameter list off a demangled name, so
+// "void ns::Foo<int>::bar<char>(int) const" is reported as
+// "ns::Foo<int>::bar<char>" like the names in a PDB. Parameters of
+// enclosing functions stay in, as in "foo(int)::counter".
+static void TrimDemangledName(const sChar *name,sInt &start,sInt &len)
+{
+  static const sChar anonNs[] = "(anonymous namespace)";
+  static const sChar opChars[] = "<>=!+-*/%^&|~,[]";
+  sInt depth = 0;
+  sInt cut = -1;
+  sInt space = -1;
+  sInt i;
+
+  for(i=0;name[i];i++)
+  {
+    sChar c = name[i];
+
+    if(!strncmp(name + i,"operator",8) && (i == 0 || !isalnum((sU8) name[i-1]) && name[i-1] != '_')
+      && !isalnum((sU8) name[i+8]) && name[i+8] != '_')
+    {
+      // operator names have brackets that don't nest: operator(), operator<
+      i += 8;
+      if(name[i] == '(' && name[i+1] == ')')
+        i += 2;
+      else if(name[i] == ' ')
+      {
+        while(name[i] && name[i] != '(') // new, delete, conversions
+          i++;
+      }
+      else
+      {
+        while(name[i] && strchr(opChars,name[i]))
+          i++;
+      }
+      i--;
+      continue;
+    }
+
+    switch(c)
+    {
+    case '(':
+      if(depth == 0)
+      {
+        if(!strncmp(name + i,anonNs,sizeof(anonNs) - 1))
+        {
+          i += sizeof(anonNs) - 2;
+          continue;
+        }
+
+        if(cut < 0)
+          cut = i;
+      }
+      depth++;
+      break;
+
+    case '<': case '{': case '[':
+      depth++;
+      break;
+
+    case ')': case '>': case '}': case ']':
+      if(depth > 0)
+        depth--;
+      break;
+
+    case ' ':
+      if(depth == 0 && cut < 0)
+        space = i; // after the return type
+      break;
+
+    case ':':
+      if(depth == 0 && name[i+1] == ':' && cut >= 0)
+      {
+        cut = -1; // that was an enclosing function
+        space = -1;
+      }
+      break;
+    }
+  }
+
+  if(cut > 0)
+  {
+    start = (space >= 0 && space + 1 < cut) ? space + 1 : 0;
+    len = cut - start;
+  }
+  else
+  {
+    start = 0;
+    len = i;
+  }
+}
+
+NameDemangler::NameDemangler()
+{
+  Buffer = 0;
+  BufferSize = 0;
+}
+
+NameDemangler::~NameDemangler()
+{
+  free(Buffer);
+}
+
+const sChar *NameDemangler::Clean(const sChar *name)
+{
+  const sChar *text = name;
+
+#if !defined(WIN32)
+  if(name[0] == '_' && name[1] == 'Z')
+  {
+    int status;
+    sChar *demangled = abi::__cxa_demangle(name,Buffer,&BufferSize,&status);
+    if(demangled && status == 0)
+    {
+      Buffer = demangled;
+      text = demangled;
+    }
+  }
+#endif
+
+  if(text == name && !strchr(name,'(') && !strchr(name,' '))
+    return 0;
+
+  sInt start, len;
+  TrimDemangledName(text,start,len);
+  if(text == name && start == 0 && !name[len])
+    return 0;
+
+  Result.assign(text + start,len);
+  return Result.c_str();
+}
+
+void DebugInfo::WriteReport(ReportWriter &out)
 {
 
 	NVSHARE::HtmlTableInterface *iface = NVSHARE::getHtmlTableInterface();
@@ -357,81 +919,67 @@ std::string DebugInfo::WriteReport()
 	dataTable->computeTotals();
 	dataTable->addSort("Sorted by data size",2,false,1,true);
 
-  const int kMinSymbolSize = 512;
-  const int kMinTemplateSize = 512;
-  const int kMinDataSize = 1024;
-  const int kMinClassSize = 2048;
-  const int kMinFileSize = 2048;
 
-	std::string Report;
   sInt i; //,j;
-  sU32 size;
-
-	Report.reserve(16384); // start out with 16k space
+  sU64 size;
+  sArray<sInt> list;
 
   // symbols
-  sAppendPrintF(Report,"Functions by size\n");
-	std::sort(Symbols.begin(),Symbols.end(),symSizeComp);
+  out.PrintF("Functions by size\n");
+  const sArray<sInt> &functions = ClassStats[DIC_CODE].reportSymbols;
 
-  for(i=0;i<Symbols.size();i++)
+  for(i=0;i<functions.size();i++)
   {
-	if( Symbols[i].Size < kMinSymbolSize )
-		break;
-    if(Symbols[i].Class == DIC_CODE)
-    {
-    	addFunctionReport(GetUndecorate(GetStringPrep(Symbols[i].name)), GetStringPrep(m_Files[Symbols[i].objFileNum].fileName),Symbols[i].Size );
-      sAppendPrintF(Report,"%15s: %-50s %s\n",
-	  NVSHARE::formatNumber(Symbols[i].Size),
-        GetUndecorate(GetStringPrep(Symbols[i].name)), GetStringPrep(m_Files[Symbols[i].objFileNum].fileName));
-    }
+    DISymbolTable::Ref sym = Symbols[functions[i]];
+    addFunctionReport(GetUndecorate(GetStringPrep(sym.name)), GetStringPrep(m_Files[sym.objFileNum].fileName),sym.Size );
+    out.PrintF("%15s: %-50s %s\n",
+      NVSHARE::formatNumber(sym.Size),
+      GetUndecorate(GetStringPrep(sym.name)), GetStringPrep(m_Files[sym.objFileNum].fileName));
   }
 
   // templates
-  sAppendPrintF(Report,"\nAggregated templates by size bytes:\n");
+  out.Flush();
 
-	std::sort(Templates.begin(),Templates.end(),templateSizeComp);
+  out.PrintF("\nAggregated templates by size bytes:\n");
 
-  for(i=0;i<Templates.size();i++)
+	SelectTop(Templates.size(),TemplateSize(Templates),ReportLimits[DIR_TEMPLATES],list);
+
+  for(i=0;i<list.size();i++)
   {
-	  if( Templates[i].size < kMinTemplateSize )
-		  break;
-	  sAppendPrintF(Report,"%15s #%5d: %s\n",
-		  NVSHARE::formatNumber(Templates[i].size),
-		  Templates[i].count,
-		  Templates[i].name.c_str() );
+	  const TemplateSymbol &tsym = Templates[list[i]];
+	  out.PrintF("%15s #%5d: %s\n",
+		  NVSHARE::formatNumber(tsym.size),
+		  tsym.count,
+		  tsym.name.c_str() );
   }
 
-  sAppendPrintF(Report,"\nData by size bytes:\n");
-  for(i=0;i<Symbols.size();i++)
-  {
-    if( Symbols[i].Size < kMinDataSize )
-      break;
-    if(Symbols[i].Class == DIC_DATA)
-    {
+  out.Flush();
 
-		dataTable->addColumn(GetUndecorate(GetStringPrep(Symbols[i].name)));
-		dataTable->addColumn(Symbols[i].Size);
-		dataTable->addColumn(GetStringPrep(m_Files[Symbols[i].objFileNum].fileName));
-		dataTable->nextRow();
-      sAppendPrintF(Report,"%15s: %-50s %s\n",
-		  NVSHARE::formatNumber(Symbols[i].Size),
-        GetStringPrep(Symbols[i].name), GetStringPrep(m_Files[Symbols[i].objFileNum].fileName));
-    }
+  out.PrintF("\nData by size bytes:\n");
+  const sArray<sInt> &data = ClassStats[DIC_DATA].reportSymbols;
+  for(i=0;i<data.size();i++)
+  {
+    DISymbolTable::Ref sym = Symbols[data[i]];
+
+    dataTable->addColumn(GetUndecorate(GetStringPrep(sym.name)));
+    dataTable->addColumn(sym.Size);
+    dataTable->addColumn(GetStringPrep(m_Files[sym.objFileNum].fileName));
+    dataTable->nextRow();
+    out.PrintF("%15s: %-50s %s\n",
+      NVSHARE::formatNumber(sym.Size),
+      GetStringPrep(sym.name), GetStringPrep(m_Files[sym.objFileNum].fileName));
   }
 
+  out.Flush();
 
-
-	sAppendPrintF(Report,"\nBSS by size bytes:\n");
-  for(i=0;i<Symbols.size();i++)
+  out.PrintF("\nBSS by size bytes:\n");
+  const sArray<sInt> &bss = ClassStats[DIC_BSS].reportSymbols;
+  for(i=0;i<bss.size();i++)
   {
-    if( Symbols[i].Size < kMinDataSize )
-      break;
-    if(Symbols[i].Class == DIC_BSS)
-    {
-      sAppendPrintF(Report,"%15s: %-50s %s\n",
-		  NVSHARE::formatNumber(Symbols[i].Size),
-        GetStringPrep(Symbols[i].name), GetStringPrep(m_Files[Symbols[i].objFileNum].fileName));
-    }
+    DISymbolTable::Ref sym = Symbols[bss[i]];
+    out.PrintF("%15s: %-50s %s\n",
+      NVSHARE::formatNumber(sym.Size),
+      GetStringPrep(sym.name), GetStringPrep(m_Files[sym.objFileNum].fileName));
   }
 
   /*
@@ -461,44 +1009,51 @@ std::string DebugInfo::WriteReport()
   }
   */
 
-  sAppendPrintF(Report,"\nClasses/Namespaces by code size bytes:\n");
-	std::sort(NameSps.begin(),NameSps.end(),nameCodeSizeComp);
+  out.Flush();
 
-  for(i=0;i<NameSps.size();i++)
+  out.PrintF("\nClasses/Namespaces by code size bytes:\n");
+	SelectTop(NameSps.size(),NameSpCodeSize(NameSps),ReportLimits[DIR_NAMESPACES],list);
+
+  for(i=0;i<list.size();i++)
   {
-	  if( NameSps[i].codeSize < kMinClassSize )
-		  break;
-    sAppendPrintF(Report,"%15s: %s\n",
-		NVSHARE::formatNumber(NameSps[i].codeSize), GetStringPrep(NameSps[i].name) );
+    const DISymNameSp &namesp = NameSps[list[i]];
+    out.PrintF("%15s: %s\n",
+		NVSHARE::formatNumber(namesp.codeSize), GetStringPrep(namesp.name) );
   }
 
-  sAppendPrintF(Report,"\nObject files by code size bytes:\n");
-	std::sort(m_Files.begin(),m_Files.end(),fileCodeSizeComp);
+  out.Flush();
 
-  for(i=0;i<m_Files.size();i++)
+  out.PrintF("\nObject files by code size bytes:\n");
+	SelectTop(m_Files.size(),FileCodeSize(m_Files),ReportLimits[DIR_FILES],list);
+
+  for(i=0;i<list.size();i++)
   {
-	  if( m_Files[i].codeSize < kMinFileSize )
-		  break;
-	  sAppendPrintF(Report,"%15s: %s\n",NVSHARE::formatNumber(m_Files[i].codeSize),
-      GetStringPrep(m_Files[i].fileName) );
+	  const DISymFile &file = m_Files[list[i]];
+	  out.PrintF("%15s: %s\n",NVSHARE::formatNumber(file.codeSize),
+      GetStringPrep(file.fileName) );
   }
 
-	size = CountSizeInClass(DIC_CODE);
-	sAppendPrintF(Report,"\nOverall code: %15s \n",NVSHARE::formatNumber(size));
+	out.Flush();
+
+	size = ClassStats[DIC_CODE].totalSize;
+	out.PrintF("\nOverall code: %15s \n",NVSHARE::formatNumber(size));
 
-	size = CountSizeInClass(DIC_DATA);
-	sAppendPrintF(Report,"Overall data: %15s\n",NVSHARE::formatNumber(size));
+	size = ClassStats[DIC_DATA].totalSize;
+	out.PrintF("Overall data: %15s\n",NVSHARE::formatNumber(size));
 
-	size = CountSizeInClass(DIC_BSS);
-	sAppendPrintF(Report,"Overall BSS:  %15s\n",NVSHARE::formatNumber(size));
+	size = ClassStats[DIC_BSS].totalSize;
+	out.PrintF("Overall BSS:  %15s\n",NVSHARE::formatNumber(size));
+
+	if( HasProfile() )
+		WriteProfileReport(out);
 
 	for (FunctionReportMap::iterator i=mFunctions.begin(); i!=mFunctions.end(); ++i)
 	{
 		FunctionReport *fr = (*i).second;
 		const char *typeName = (*i).first.c_str();
 		groupTable->addColumn(typeName);
-		groupTable->addColumn(fr->mTotalFunctionCount);
-		groupTable->addColumn(fr->mTotalFunctionSize);
+		groupTable->addColumn((unsigned int) fr->mTotalFunctionCount);
+		groupTable->addColumn((unsigned long long) fr->mTotalFunctionSize);
 		groupTable->nextRow();
 	}
 
@@ -509,7 +1064,7 @@ std::string DebugInfo::WriteReport()
 
 	size_t len = 0;
 	const char *doc = mDocument->saveDocument(len,NVSHARE::HST_SIMPLE_HTML);
-	printf("Saving 'exesizer.html'\r\n");
+	fprintf(stderr,"Saving 'exesizer.html'\n");
 	FILE *fph = fopen("exesizer.html", "wb");
 	if ( fph )
 	{
@@ -521,15 +1076,82 @@ std::string DebugInfo::WriteReport()
 	iface->releaseHtmlDocument(mDocument);
 
 
-  return Report;
 }
 
 
-void DebugInfo::addFunctionReport(const char *function,const char *objectFile,size_t functionSize)
+// "bytes vs. heat": everything that got profile samples, most hits first
+void DebugInfo::WriteProfileReport(ReportWriter &out)
+{
+	sInt i;
+	sArray<sInt> list;
+
+	DIReportLimit limit;
+	limit.minSize = 1; // at least one hit
+
+	NVSHARE::HtmlTable *symbolTable = CreateHeatTable(mDocument,"Profile Hits By Symbol","Symbol/Name,Symbol/Size,Sample/Hits,Hits/Per KB,Object/File");
+	NVSHARE::HtmlTable *fileTable = CreateHeatTable(mDocument,"Profile Hits By Object File","Object/File,Code/Size,Sample/Hits,Hits/Per KB");
+	NVSHARE::HtmlTable *namespTable = CreateHeatTable(mDocument,"Profile Hits By Namespace","Namespace/Name,Code/Size,Sample/Hits,Hits/Per KB");
+	NVSHARE::HtmlTable *templateTable = CreateHeatTable(mDocument,"Profile Hits By Template","Template/Name,Code/Size,Sample/Hits,Hits/Per KB,Instance/Count");
+
+	out.Flush();
+	out.PrintF("\nSymbols by profile hits:\n");
+
+	limit.maxCount = ReportLimits[DIR_FUNCTIONS].maxCount;
+	SelectTop(Symbols.size(),SymbolHits(m_SymbolHits),limit,list);
+
+	for(i=0;i<list.size();i++)
+	{
+		DISymbolTable::Ref sym = Symbols[list[i]];
+		const char *name = GetUndecorate(GetStringPrep(sym.name));
+		const char *fileName = GetStringPrep(m_Files[sym.objFileNum].fileName);
+
+		AddHeatRow(symbolTable,name,sym.Size,m_SymbolHits[list[i]]);
+		symbolTable->addColumn(fileName);
+		symbolTable->nextRow();
+
+		out.PrintF("%15s %15s: %-50s %s\n",
+			NVSHARE::formatNumber(m_SymbolHits[list[i]]),
+			NVSHARE::formatNumber(sym.Size),
+			name, fileName);
+	}
+
+	limit.maxCount = ReportLimits[DIR_FILES].maxCount;
+	SelectTop(m_Files.size(),FileHits(m_Files),limit,list);
+	for(i=0;i<list.size();i++)
+	{
+		const DISymFile &file = m_Files[list[i]];
+		AddHeatRow(fileTable,GetStringPrep(file.fileName),file.codeSize,file.hits);
+		fileTable->nextRow();
+	}
+
+	limit.maxCount = ReportLimits[DIR_NAMESPACES].maxCount;
+	SelectTop(NameSps.size(),NameSpHits(NameSps),limit,list);
+	for(i=0;i<list.size();i++)
+	{
+		const DISymNameSp &namesp = NameSps[list[i]];
+		AddHeatRow(namespTable,GetStringPrep(namesp.name),namesp.codeSize,namesp.hits);
+		namespTable->nextRow();
+	}
+
+	limit.maxCount = ReportLimits[DIR_TEMPLATES].maxCount;
+	SelectTop(Templates.size(),TemplateHits(Templates),limit,list);
+	for(i=0;i<list.size();i++)
+	{
+		const TemplateSymbol &tsym = Templates[list[i]];
+		AddHeatRow(templateTable,tsym.name.c_str(),tsym.size,tsym.hits);
+		templateTable->addColumn((unsigned int) tsym.count);
+		templateTable->nextRow();
+	}
+
+	out.PrintF("\nOverall samples: %15s\n",NVSHARE::formatNumber(m_TotalHits));
+	out.PrintF("  in code:      %15s\n",NVSHARE::formatNumber(ClassStats[DIC_CODE].totalHits));
+	out.PrintF("  unattributed: %15s\n",NVSHARE::formatNumber(m_UnattributedHits));
+}
+
+void DebugInfo::addFunctionReport(const char *function,const char *objectFile,sU64 functionSize)
 {
 
-	char scratch[512];
-	strcpy(scratch,objectFile);
+	std::string scratch = objectFile;
 
 	const char *lastSlash = NULL;
 	const char *scan = objectFile;
@@ -543,24 +1165,25 @@ void DebugInfo::addFunctionReport(const char *function,const char *objectFile,si
 	if ( lastSlash )
 		objectFile = lastSlash+1;
 
-	const char *prefix = scratch;
+	size_t release = scratch.find("\\release");
+	if ( release != std::string::npos )
+	{
+		scratch.resize(release);
+	}
+
+	const char *prefix = scratch.c_str();
 
     //                    01 234567 890123456
-	if ( strncmp(scratch,".\\build\\Xbox 360\\",17) == 0 )
+	if ( strncmp(prefix,".\\build\\Xbox 360\\",17) == 0 )
 	{
 		prefix+=17;
 	}
-	char *sc = strstr(scratch,"\\release");
-	if ( sc )
-	{
-		*sc = 0;
-	}
 
 #if ONLY_APEX
-	char temp[512];
-	strcpy(temp,prefix);
-	strlwr(temp);
-	const char *isApex = strstr(temp,"apex");
+	std::string temp = prefix;
+	for(size_t i=0;i<temp.size();i++)
+		temp[i] = (char) tolower(temp[i]);
+	const char *isApex = strstr(temp.c_str(),"apex");
 	if ( isApex == NULL ) return;
 	if ( temp[0] == 'c' && temp[1] == ':' ) return;
 #endif
@@ -585,17 +1208,17 @@ void DebugInfo::addFunctionReport(const char *function,const char *objectFile,si
 
 	{
 		ObjectReportMap::iterator found = mObjects.find(byType);
-		ObjectReport *or;
+		ObjectReport *orep;
 		if ( found == mObjects.end() )
 		{
-			or = new ObjectReport(byType,mDocument);
-			mObjects[byType] = or;
+			orep = new ObjectReport(byType,mDocument);
+			mObjects[byType] = orep;
 		}
 		else
 		{
-			or = (*found).second;
+			orep = (*found).second;
 		}
-		or->addFunction(function,objectFile,functionSize);
+		orep->addFunction(function,objectFile,functionSize);
 	}
 
 }
@@ -6,8 +6,10 @@
 #define __DEBUGINFO_HPP__
 
 #include "types.hpp"
+#include "stringpool.hpp"
+#include "addressindex.hpp"
 #include <map>
-#include "HtmlTable.h"
+#include "htmltable.h"
 
 using std::string;
 
@@ -22,15 +24,43 @@ using std::string;
 struct DISymFile // File
 {
 	sInt	fileName;
-	sU32	codeSize;
-	sU32	dataSize;
+	sU64	codeSize;
+	sU64	dataSize;
+	sU64	bssSize;
+	sU64	hits;		// profile samples, see DebugInfo::AddSamples
 };
 
 struct DISymNameSp // Namespace
 {
 	sInt	name;
-	sU32	codeSize;
-	sU32	dataSize;
+	sU64	codeSize;
+	sU64	dataSize;
+	sU64	bssSize;
+	sU64	hits;
+};
+
+// report sections with a size listing
+#define DIR_FUNCTIONS	0
+#define DIR_TEMPLATES	1
+#define DIR_DATA		2
+#define DIR_BSS			3
+#define DIR_NAMESPACES	4
+#define DIR_FILES		5
+#define DIR_COUNT		6
+
+struct DIReportLimit
+{
+	sU64	minSize;		// smaller entries aren't listed
+	sInt	maxCount;		// list at most that many, 0 = all
+};
+
+struct DIClassStats // per symbol class (DIC_*)
+{
+	sU64	totalSize;
+	sU64	totalHits;
+	sInt	count;
+	sInt	reportSection;	// DIR_*, -1 if not listed
+	sArray<sInt>	reportSymbols;	// listed symbols, biggest first
 };
 
 struct DISymbol
@@ -39,16 +69,126 @@ struct DISymbol
 	sInt mangledName;
 	sInt NameSpNum;
 	sInt objFileNum;
-	sU32 VA;
-	sU32 Size;
+	sU64 VA;
+	sU64 Size;
 	sInt Class;
 };
 
+// A column of 64 bit addresses or sizes. A packed column stores 32 bit
+// values for as long as everything fits and switches to 64 bits for good
+// when a bigger value comes along, so it's always safe to ask for one.
+class DIU64Column
+{
+	sArray<sU32>	Narrow;
+	sArray<sU64>	Wide;
+	sBool			Packed;
+
+	void Unpack();
+
+public:
+	DIU64Column() : Packed(false) {}
+
+	sInt size() const						{ return Packed ? Narrow.size() : Wide.size(); }
+	sBool empty() const						{ return size() == 0; }
+	sBool IsPacked() const					{ return Packed; }
+	sU64 operator[](sInt i) const			{ return Packed ? Narrow[i] : Wide[i]; }
+
+	void Set(sInt i,sU64 value)
+	{
+		if(Packed && value > 0xffffffffu)
+			Unpack();
+		if(Packed)
+			Narrow[i] = (sU32) value;
+		else
+			Wide[i] = value;
+	}
+
+	void push_back(sU64 value)
+	{
+		if(Packed && value > 0xffffffffu)
+			Unpack();
+		if(Packed)
+			Narrow.push_back((sU32) value);
+		else
+			Wide.push_back(value);
+	}
+
+	// only while empty
+	void SetPacked(sBool packed);
+
+	void clear();
+	void reserve(sInt count);
+	void append(const DIU64Column &other);
+	void assign(const sU64 *values,sInt count);
+	void Permute(const sArray<sInt> &order);
+};
+
+// Symbols are stored by column: the aggregation passes only look at two or
+// three fields each, so they stream through just those. Symbols[i] gives
+// a DISymbol-like reference to all fields of one symbol.
+class DISymbolTable
+{
+public:
+	sArray<sInt>	name;
+	sArray<sInt>	mangledName;
+	sArray<sInt>	NameSpNum;
+	sArray<sInt>	objFileNum;
+	DIU64Column		VA;
+	DIU64Column		Size;
+	sArray<sU8>		Class;
+
+	// VA and Size are copies, change them through the columns
+	struct Ref
+	{
+		sInt &name;
+		sInt &mangledName;
+		sInt &NameSpNum;
+		sInt &objFileNum;
+		sU64 VA;
+		sU64 Size;
+		sU8 &Class;
+
+		Ref(DISymbolTable &t,sInt i)
+			: name(t.name[i]), mangledName(t.mangledName[i]), NameSpNum(t.NameSpNum[i]), objFileNum(t.objFileNum[i]),
+			VA(t.VA[i]), Size(t.Size[i]), Class(t.Class[i]) {}
+
+		operator DISymbol() const
+		{
+			DISymbol sym = { name, mangledName, NameSpNum, objFileNum, VA, Size, Class };
+			return sym;
+		}
+	};
+
+	sInt size() const						{ return VA.size(); }
+	sBool empty() const						{ return VA.empty(); }
+	Ref operator[](sInt i)					{ return Ref(*this,i); }
+
+	// 32 bit VA/Size storage while the values fit; call before adding symbols
+	void SetPacked(sBool packed)			{ VA.SetPacked(packed); Size.SetPacked(packed); }
+	sBool IsPacked() const					{ return VA.IsPacked() && Size.IsPacked(); }
+
+	void clear();
+	void reserve(sInt count);
+	void push_back(const DISymbol &sym);
+	DISymbol Get(sInt i) const;
+
+	// reorders symbols so that the new i-th one is the old order[i]-th one
+	// (order may be shorter, the rest is dropped)
+	void Permute(const sArray<sInt> &order);
+};
+
 struct TemplateSymbol
 {
 	string	name;
-	sU32	size;
+	sU64	size;
 	sU32	count;
+	sU64	hits;
+};
+
+struct DISample // profile sample
+{
+	sU64	RVA;
+	sU64	Count;
 };
 
 
@@ -71,10 +211,10 @@ public:
 	{
 	}
 
-	void addFunction(const char *function,const char *objectFile,size_t functionSize)
+	void addFunction(const char *function,const char *objectFile,sU64 functionSize)
 	{
 		mTable->addColumn(function);
-		mTable->addColumn(functionSize);
+		mTable->addColumn((unsigned long long) functionSize);
 		mTable->addColumn(objectFile);
 		mTable->nextRow();
 		mTotalFunctionSize+=functionSize;
@@ -83,7 +223,7 @@ public:
 
 
 	NVSHARE::HtmlTable	*mTable;
-	size_t mTotalFunctionSize;
+	sU64 mTotalFunctionSize;
 	size_t mTotalFunctionCount;
 };
 
@@ -104,17 +244,17 @@ public:
 		mCodeSize = 0;
 	}
 
-	void addFunction(const char *function,size_t codeSize)
+	void addFunction(const char *function,sU64 codeSize)
 	{
 		mTable->addColumn(function);
-		mTable->addColumn(codeSize);
+		mTable->addColumn((unsigned long long) codeSize);
 		mTable->nextRow();
 		mFunctionCount++;
 		mCodeSize+=codeSize;
 	}
 
 	size_t				mFunctionCount;
-	size_t				mCodeSize;
+	sU64				mCodeSize;
 	NVSHARE::HtmlTable	*mTable;
 };
 
@@ -137,7 +277,7 @@ public:
 	{
 	}
 
-	void addFunction(const char *function,const char *objectFile,size_t functionSize)
+	void addFunction(const char *function,const char *objectFile,sU64 functionSize)
 	{
 		std::string oname = objectFile;
 		ByObject *bo;
@@ -161,13 +301,13 @@ public:
 			const char *oname = (*i).first.c_str();
 			ByObject &bo = *(*i).second;
 			mTable->addColumn(oname);
-			mTable->addColumn(bo.mFunctionCount);
-			mTable->addColumn(bo.mCodeSize);
+			mTable->addColumn((unsigned int) bo.mFunctionCount);
+			mTable->addColumn((unsigned long long) bo.mCodeSize);
 			mTable->nextRow();
 
 			table->addColumn(oname);
-			table->addColumn(bo.mFunctionCount);
-			table->addColumn(bo.mCodeSize);
+			table->addColumn((unsigned int) bo.mFunctionCount);
+			table->addColumn((unsigned long long) bo.mCodeSize);
 			table->nextRow();
 		}
 	}
@@ -179,46 +319,86 @@ public:
 
 typedef std::map< std::string, ObjectReport * > ObjectReportMap;
 
+class MappedFile;
+class ReportWriter;
+class DebugInfoSnapshot;
+
 class DebugInfo
 {
-	typedef std::vector<string>		StringByIndexVector;
-	typedef std::map<string,sInt>	IndexByStringMap;
-
-	StringByIndexVector	m_StringByIndex;
-	IndexByStringMap	m_IndexByString;
-	sU32 BaseAddress;
-
-	sU32 CountSizeInClass(sInt type) const;
+  friend class DebugInfoSnapshot;
+
+	StringPool			m_Strings;
+	sArray<MappedFile *>	m_Sources;
+	sArray<sInt>		m_FileByName;	// by string id, -1 = none yet
+	sArray<sInt>		m_NameSpByName;
+	sArray<sInt>		m_NameSpBySymbol;	// symbol name id -> namespace
+	AddressIndex		m_SymbolIndex;		// by VA, built by FinishedReading
+	sArray<sInt>		m_TemplateBySymbol;	// -1 = not a template instance
+	sArray<sU64>		m_SymbolHits;		// empty without a profile
+	sU64				m_TotalHits;
+	sU64				m_UnattributedHits;	// samples outside any symbol
+	sU64 BaseAddress;
+
+  void BuildSymbolIndex();
 
 public:
-  sArray<DISymbol>			Symbols;
+  DISymbolTable				Symbols;
   sArray<TemplateSymbol>	Templates;
   sArray<DISymFile>			m_Files;
   sArray<DISymNameSp>		NameSps;
+  DIClassStats				ClassStats[DIC_UNKNOWN+1];	// filled by FinishAnalyze
+  DIReportLimit				ReportLimits[DIR_COUNT];
 
   void Init();
   void Exit();
 
   // only use those before reading is finished!!
-  sInt MakeString(sChar *s);
-  const char* GetStringPrep( sInt index ) const { return m_StringByIndex[index].c_str(); }
-  void SetBaseAddress(sU32 base)            { BaseAddress = base; }
+  sInt MakeString(const sChar *s);
+  // doesn't copy: s[len] must be 0 and s must live as long as we do (see AddSource)
+  sInt MakeStringRef(const sChar *s,sInt len);
+  const char* GetStringPrep( sInt index ) const { return m_Strings.GetString(index); }
+  const StringPool &GetStrings() const      { return m_Strings; }
+  void AddSource(MappedFile *source)        { m_Sources.push_back(source); }
+  void SetBaseAddress(sU64 base)            { BaseAddress = base; }
+
+  // appends symbols, object files and namespaces that were read into a
+  // separate DebugInfo (e.g. on another thread). Names are re-interned in
+  // the order they first appear in, so merging parts in a fixed order gives
+  // the same result as reading everything into one DebugInfo.
+  void MergePart(DebugInfo &part);
 
   void FinishedReading();
 
   sInt GetFile( sInt fileName );
-  sInt GetFileByName( sChar *objName );
+  sInt GetFileByName( const sChar *objName );
 
   sInt GetNameSpace(sInt name);
-  sInt GetNameSpaceByName(sChar *name);
+  sInt GetNameSpaceByName(const sChar *name);
+  sInt GetNameSpaceOf(sInt symbolName);
+
+  // "functions", "templates", "data", "bss", "namespaces", "files"; 0 = all
+  sBool SetReportMaxCount(const sChar *section,sInt maxCount);
 
   void StartAnalyze();
   void FinishAnalyze();
-  sBool FindSymbol(sU32 VA,DISymbol **sym);
 
-  std::string WriteReport();
+  // symbol containing VA; on a miss, *index is the first symbol after VA
+  // (or -1). Symbols are ordered by VA once reading is finished.
+  sBool FindSymbol(sU64 VA,sInt *index) const;
+  // indices[i] = symbol containing VAs[i] or -1; fastest with ascending VAs
+  void FindSymbols(const sU64 *VAs,sInt count,sInt *indices) const;
 
-	void addFunctionReport(const char *function,const char *objectFile,size_t functionSize);
+  // attributes profile samples to the symbols containing them; only after
+  // FinishedReading. Reorders samples. Totals show up after FinishAnalyze.
+  void AddSamples(DISample *samples,sInt count);
+  sBool HasProfile() const                  { return !m_SymbolHits.empty(); }
+  sU64 GetSampleCount() const               { return m_TotalHits; }
+  sU64 GetUnattributedSampleCount() const   { return m_UnattributedHits; }
+
+  void WriteReport(ReportWriter &out);
+
+	void addFunctionReport(const char *function,const char *objectFile,sU64 functionSize);
+	void WriteProfileReport(ReportWriter &out);
 
 	FunctionReportMap	mFunctions;
 	ObjectReportMap		mObjects;
@@ -227,6 +407,26 @@ public:
 
 };
 
+// undecorated symbol name, valid until the next call
+const char *GetUndecorate(const char *str);
+
+// Brings C++ names into the form PDBs have them in: qualified name without
+// return type and parameters. "_Z" names are demangled first, except on
+// Windows. Buffers are kept between calls, so use one of these per thread.
+class NameDemangler
+{
+  sChar *Buffer;                    // malloc'ed, grown by the demangler
+  size_t BufferSize;
+  std::string Result;
+
+public:
+  NameDemangler();
+  ~NameDemangler();
+
+  // the cleaned up name (valid until the next call), or 0 if it's fine as is
+  const sChar *Clean(const sChar *name);
+};
+
 class DebugInfoReader
 {
 public:
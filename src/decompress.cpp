@@ -0,0 +1,402 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#include "types.hpp"
+#include "decompress.hpp"
+
+#if defined(SIZER_ZSTD)
+#include <zstd.h>
+#endif
+
+/****************************************************************************/
+
+// Huffman codes are decoded with one lookup of the next FastBits bits;
+// only codes longer than that take the bit-by-bit canonical decode.
+
+static const sInt FastBits = 10;
+static const sInt MaxCodeLen = 15;
+
+struct HuffmanTable
+{
+  sU16 Fast[1 << FastBits];         // symbol << 4 | length, 0 if longer
+  sU16 Count[MaxCodeLen + 1];       // codes of each length
+  sU16 Symbols[288];                // sorted by code
+
+  sBool Build(const sU8 *lengths,sInt count);
+};
+
+sBool HuffmanTable::Build(const sU8 *lengths,sInt count)
+{
+  sU16 offsets[MaxCodeLen + 2];
+  sInt next[MaxCodeLen + 1];
+
+  memset(Count,0,sizeof(Count));
+  memset(Fast,0,sizeof(Fast));
+  for(sInt i=0;i<count;i++)
+    Count[lengths[i]]++;
+  Count[0] = 0;
+
+  // no over-subscribed code sets (incomplete ones are legal)
+  sInt left = 1;
+  for(sInt len=1;len<=MaxCodeLen;len++)
+  {
+    left = 2*left - Count[len];
+    if(left < 0)
+      return false;
+  }
+
+  offsets[1] = 0;
+  for(sInt len=1;len<=MaxCodeLen;len++)
+    offsets[len+1] = offsets[len] + Count[len];
+
+  // first canonical code of each length
+  sInt code = 0;
+  for(sInt len=1;len<=MaxCodeLen;len++)
+  {
+    code = (code + Count[len-1]) << 1;
+    next[len] = code;
+  }
+
+  for(sInt sym=0;sym<count;sym++)
+  {
+    sInt len = lengths[sym];
+    if(!len)
+      continue;
+
+    Symbols[offsets[len]++] = (sU16) sym;
+
+    sInt c = next[len]++;
+    if(len > FastBits)
+      continue;
+
+    // codes go into the stream starting with their top bit
+    sInt reversed = 0;
+    for(sInt i=0;i<len;i++)
+      reversed |= ((c >> i) & 1) << (len - 1 - i);
+
+    for(sInt i=reversed;i<(1 << FastBits);i+=1 << len)
+      Fast[i] = (sU16) ((sym << 4) | len);
+  }
+
+  return true;
+}
+
+class Inflater
+{
+  const sU8 *In;
+  const sU8 *InEnd;
+  sU64 Bits;
+  sInt BitCount;
+  sInt Overrun;                     // zero bytes fed in past the end
+
+  sU8 *OutStart;
+  sU8 *Out;
+  sU8 *OutEnd;
+
+  HuffmanTable LitLen;
+  HuffmanTable Dist;
+
+  void Refill()
+  {
+    while(BitCount <= 56)
+    {
+      if(In < InEnd)
+        Bits |= (sU64) *In++ << BitCount;
+      else
+        Overrun++;
+      BitCount += 8;
+    }
+  }
+
+  sU32 GetBits(sInt count)
+  {
+    if(BitCount < count)
+      Refill();
+
+    sU32 value = (sU32) (Bits & ((1ull << count) - 1));
+    Bits >>= count;
+    BitCount -= count;
+    return value;
+  }
+
+  sInt Decode(const HuffmanTable &table); // needs 15 bits in the buffer
+  sBool ReadDynamicTables();
+  sBool ReadStoredBlock();
+  sBool InflateBlock();
+
+public:
+  Inflater(const sU8 *src,sU64 srcSize,sU8 *dest,sU64 destSize);
+
+  sBool Run();
+};
+
+Inflater::Inflater(const sU8 *src,sU64 srcSize,sU8 *dest,sU64 destSize)
+{
+  In = src;
+  InEnd = src + srcSize;
+  Bits = 0;
+  BitCount = 0;
+  Overrun = 0;
+  OutStart = Out = dest;
+  OutEnd = dest + destSize;
+}
+
+sInt Inflater::Decode(const HuffmanTable &table)
+{
+  sU32 entry = table.Fast[Bits & ((1 << FastBits) - 1)];
+  if(entry)
+  {
+    Bits >>= entry & 15;
+    BitCount -= entry & 15;
+    return entry >> 4;
+  }
+
+  // long code: canonical decode, one bit at a time
+  sInt code = 0, first = 0, index = 0;
+  for(sInt len=1;len<=MaxCodeLen;len++)
+  {
+    code |= (Bits >> (len - 1)) & 1;
+    sInt count = table.Count[len];
+    if(code - first < count)
+    {
+      Bits >>= len;
+      BitCount -= len;
+      return table.Symbols[index + code - first];
+    }
+
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+
+  return -1;
+}
+
+sBool Inflater::ReadDynamicTables()
+{
+  static const sU8 order[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+  sU8 lengths[288 + 32];
+
+  sInt nLitLen = GetBits(5) + 257;
+  sInt nDist = GetBits(5) + 1;
+  sInt nCodeLen = GetBits(4) + 4;
+  if(nLitLen > 286 || nDist > 30)
+    return false;
+
+  memset(lengths,0,19);
+  for(sInt i=0;i<nCodeLen;i++)
+    lengths[order[i]] = (sU8) GetBits(3);
+
+  HuffmanTable codeLen;
+  if(!codeLen.Build(lengths,19))
+    return false;
+
+  for(sInt i=0;i<nLitLen + nDist;)
+  {
+    Refill();
+    sInt sym = Decode(codeLen);
+    if(sym < 0)
+      return false;
+
+    if(sym < 16)
+    {
+      lengths[i++] = (sU8) sym;
+      continue;
+    }
+
+    sU8 value = 0;
+    sInt repeat;
+    if(sym == 16)
+    {
+      if(i == 0)
+        return false;
+      value = lengths[i-1];
+      repeat = 3 + GetBits(2);
+    }
+    else if(sym == 17)
+      repeat = 3 + GetBits(3);
+    else
+      repeat = 11 + GetBits(7);
+
+    if(i + repeat > nLitLen + nDist)
+      return false;
+
+    while(repeat--)
+      lengths[i++] = value;
+  }
+
+  if(!lengths[256]) // no end of block code
+    return false;
+
+  return LitLen.Build(lengths,nLitLen) && Dist.Build(lengths + nLitLen,nDist);
+}
+
+sBool Inflater::ReadStoredBlock()
+{
+  // skip to a byte boundary; whole bytes still buffered are used first
+  GetBits(BitCount & 7);
+  sU32 len = GetBits(16);
+  sU32 nlen = GetBits(16);
+  if((len ^ 0xffff) != nlen || len > sU64(OutEnd - Out))
+    return false;
+
+  while(len && BitCount >= 8)
+  {
+    *Out++ = (sU8) GetBits(8);
+    len--;
+  }
+
+  if(len > sU64(InEnd - In))
+    return false;
+
+  sCopyMem(Out,In,len);
+  Out += len;
+  In += len;
+  return true;
+}
+
+sBool Inflater::InflateBlock()
+{
+  static const sU16 lengthBase[29] =
+  {
+    3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258
+  };
+  static const sU8 lengthExtra[29] =
+  {
+    0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0
+  };
+  static const sU16 distBase[30] =
+  {
+    1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,
+    4097,6145,8193,12289,16385,24577
+  };
+  static const sU8 distExtra[30] =
+  {
+    0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13
+  };
+
+  for(;;)
+  {
+    // enough bits for a length, a distance and their extra bits
+    Refill();
+    if(Overrun > 8)
+      return false;
+
+    sInt sym = Decode(LitLen);
+    if(sym < 256)
+    {
+      if(sym < 0 || Out == OutEnd)
+        return false;
+
+      *Out++ = (sU8) sym;
+      continue;
+    }
+
+    if(sym == 256)
+      return true;
+
+    sym -= 257;
+    if(sym >= 29)
+      return false;
+
+    sU32 len = lengthBase[sym] + GetBits(lengthExtra[sym]);
+    sInt distSym = Decode(Dist);
+    if(distSym < 0 || distSym >= 30)
+      return false;
+
+    sU32 dist = distBase[distSym] + GetBits(distExtra[distSym]);
+    if(dist > sU64(Out - OutStart) || len > sU64(OutEnd - Out))
+      return false;
+
+    const sU8 *from = Out - dist;
+    if(dist >= len)
+    {
+      sCopyMem(Out,from,len);
+      Out += len;
+    }
+    else
+    {
+      while(len--)
+        *Out++ = *from++;
+    }
+  }
+}
+
+sBool Inflater::Run()
+{
+  sBool last;
+  do
+  {
+    last = GetBits(1) != 0;
+    sU32 type = GetBits(2);
+
+    if(type == 0)
+    {
+      if(!ReadStoredBlock())
+        return false;
+      continue;
+    }
+
+    if(type == 1)
+    {
+      sU8 lengths[288 + 32];
+      sInt i = 0;
+      for(;i<144;i++) lengths[i] = 8;
+      for(;i<256;i++) lengths[i] = 9;
+      for(;i<280;i++) lengths[i] = 7;
+      for(;i<288;i++) lengths[i] = 8;
+      for(;i<288+32;i++) lengths[i] = 5;
+
+      if(!LitLen.Build(lengths,288) || !Dist.Build(lengths + 288,30))
+        return false;
+    }
+    else if(type != 2 || !ReadDynamicTables())
+      return false;
+
+    if(!InflateBlock())
+      return false;
+  }
+  while(!last);
+
+  // mustn't have used the padding, and must have filled the output
+  return BitCount / 8 >= Overrun && Out == OutEnd;
+}
+
+sBool DecompressZlib(const sU8 *src,sU64 srcSize,sU8 *dest,sU64 destSize)
+{
+  // header: deflate, no preset dictionary
+  if(srcSize < 2 || (src[0] & 0x0f) != 8 || (src[0] >> 4) > 7 || (src[1] & 0x20) || ((src[0] << 8) | src[1]) % 31)
+    return false;
+
+  Inflater inflater(src + 2,srcSize - 2,dest,destSize);
+  return inflater.Run();
+}
+
+/****************************************************************************/
+
+#if defined(SIZER_ZSTD)
+
+sBool DecompressZstd(const sU8 *src,sU64 srcSize,sU8 *dest,sU64 destSize)
+{
+  size_t size = ZSTD_decompress(dest,destSize,src,srcSize);
+  return !ZSTD_isError(size) && size == destSize;
+}
+
+sBool CanDecompressZstd()
+{
+  return true;
+}
+
+#else
+
+sBool DecompressZstd(const sU8 *src,sU64 srcSize,sU8 *dest,sU64 destSize)
+{
+  return false;
+}
+
+sBool CanDecompressZstd()
+{
+  return false;
+}
+
+#endif
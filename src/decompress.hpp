@@ -0,0 +1,27 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __DECOMPRESS_HPP__
+#define __DECOMPRESS_HPP__
+
+#include "types.hpp"
+
+/****************************************************************************/
+
+// Decompression of whole buffers whose uncompressed size is known up front,
+// as for compressed ELF sections. Both fail unless the data decodes to
+// exactly destSize bytes.
+
+// zlib streams (RFC 1950/1951), with our own inflater so there's nothing
+// to link against.
+sBool DecompressZlib(const sU8 *src,sU64 srcSize,sU8 *dest,sU64 destSize);
+
+// zstd frames; only available in builds with SIZER_ZSTD defined, which
+// need zstd.h and libzstd.
+sBool DecompressZstd(const sU8 *src,sU64 srcSize,sU8 *dest,sU64 destSize);
+sBool CanDecompressZstd();
+
+/****************************************************************************/
+
+#endif
@@ -0,0 +1,1783 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#pragma warning(disable:4996)
+#include "types.hpp"
+#include "debuginfo.hpp"
+#include "elffile.hpp"
+#include "mappedfile.hpp"
+#include "decompress.hpp"
+
+#include <cstdio>
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
+
+/****************************************************************************/
+
+// Only the bits of elf.h and dwarf.h that are needed here.
+
+enum
+{
+  ET_REL = 1,
+  ET_EXEC = 2,
+  ET_DYN = 3,
+
+  SHN_UNDEF = 0,
+  SHN_LORESERVE = 0xff00,
+  SHN_XINDEX = 0xffff,
+
+  SHT_SYMTAB = 2,
+  SHT_NOBITS = 8,
+  SHT_DYNSYM = 11,
+  SHT_SYMTAB_SHNDX = 18,
+
+  SHF_WRITE = 0x1,
+  SHF_ALLOC = 0x2,
+  SHF_EXECINSTR = 0x4,
+  SHF_TLS = 0x400,
+  SHF_COMPRESSED = 0x800,
+
+  ELFCOMPRESS_ZLIB = 1,
+  ELFCOMPRESS_ZSTD = 2,
+
+  STB_LOCAL = 0,
+
+  STT_OBJECT = 1,
+  STT_FUNC = 2,
+  STT_FILE = 4,
+  STT_GNU_IFUNC = 10,
+};
+
+enum
+{
+  DW_UT_compile = 1,
+  DW_UT_partial = 3,
+  DW_UT_skeleton = 4,
+  DW_UT_split_compile = 5,
+
+  DW_TAG_compile_unit = 0x11,
+  DW_TAG_variable = 0x34,
+  DW_TAG_partial_unit = 0x3c,
+  DW_TAG_skeleton_unit = 0x4a,
+
+  DW_AT_location = 0x02,
+  DW_AT_name = 0x03,
+  DW_AT_low_pc = 0x11,
+  DW_AT_high_pc = 0x12,
+  DW_AT_comp_dir = 0x1b,
+  DW_AT_ranges = 0x55,
+  DW_AT_str_offsets_base = 0x72,
+  DW_AT_addr_base = 0x73,
+  DW_AT_rnglists_base = 0x74,
+  DW_AT_dwo_name = 0x76,
+  DW_AT_GNU_dwo_name = 0x2130,
+  DW_AT_GNU_dwo_id = 0x2131,
+  DW_AT_GNU_addr_base = 0x2133,
+
+  DW_FORM_addr = 0x01,
+  DW_FORM_block2 = 0x03,
+  DW_FORM_block4 = 0x04,
+  DW_FORM_data2 = 0x05,
+  DW_FORM_data4 = 0x06,
+  DW_FORM_data8 = 0x07,
+  DW_FORM_string = 0x08,
+  DW_FORM_block = 0x09,
+  DW_FORM_block1 = 0x0a,
+  DW_FORM_data1 = 0x0b,
+  DW_FORM_flag = 0x0c,
+  DW_FORM_sdata = 0x0d,
+  DW_FORM_strp = 0x0e,
+  DW_FORM_udata = 0x0f,
+  DW_FORM_ref_addr = 0x10,
+  DW_FORM_ref1 = 0x11,
+  DW_FORM_ref2 = 0x12,
+  DW_FORM_ref4 = 0x13,
+  DW_FORM_ref8 = 0x14,
+  DW_FORM_ref_udata = 0x15,
+  DW_FORM_indirect = 0x16,
+  DW_FORM_sec_offset = 0x17,
+  DW_FORM_exprloc = 0x18,
+  DW_FORM_flag_present = 0x19,
+  DW_FORM_strx = 0x1a,
+  DW_FORM_addrx = 0x1b,
+  DW_FORM_ref_sup4 = 0x1c,
+  DW_FORM_strp_sup = 0x1d,
+  DW_FORM_data16 = 0x1e,
+  DW_FORM_line_strp = 0x1f,
+  DW_FORM_ref_sig8 = 0x20,
+  DW_FORM_implicit_const = 0x21,
+  DW_FORM_loclistx = 0x22,
+  DW_FORM_rnglistx = 0x23,
+  DW_FORM_ref_sup8 = 0x24,
+  DW_FORM_strx1 = 0x25,
+  DW_FORM_strx2 = 0x26,
+  DW_FORM_strx3 = 0x27,
+  DW_FORM_strx4 = 0x28,
+  DW_FORM_addrx1 = 0x29,
+  DW_FORM_addrx2 = 0x2a,
+  DW_FORM_addrx3 = 0x2b,
+  DW_FORM_addrx4 = 0x2c,
+  DW_FORM_GNU_addr_index = 0x1f01,
+  DW_FORM_GNU_str_index = 0x1f02,
+  DW_FORM_GNU_ref_alt = 0x1f20,
+  DW_FORM_GNU_strp_alt = 0x1f21,
+
+  DW_RLE_end_of_list = 0,
+  DW_RLE_base_addressx = 1,
+  DW_RLE_startx_endx = 2,
+  DW_RLE_startx_length = 3,
+  DW_RLE_offset_pair = 4,
+  DW_RLE_base_address = 5,
+  DW_RLE_start_end = 6,
+  DW_RLE_start_length = 7,
+
+  DW_OP_addr = 0x03,
+  DW_OP_addrx = 0xa1,
+  DW_OP_GNU_addr_index = 0xfb,
+
+  DW_SECT_INFO = 1,                 // package index columns
+  DW_SECT_ABBREV = 3,
+  DW_SECT_STR_OFFSETS = 6,
+};
+
+static const sChar *DwarfSectionNames[] =
+{
+  ".debug_info", ".debug_abbrev", ".debug_aranges", ".debug_str", ".debug_line_str",
+  ".debug_str_offsets", ".debug_addr", ".debug_ranges", ".debug_rnglists", 0
+};
+
+// the same in .dwo and .dwp files, 0 where those don't have it
+static const sChar *DwoSectionNames[] =
+{
+  ".debug_info.dwo", ".debug_abbrev.dwo", 0, ".debug_str.dwo", 0,
+  ".debug_str_offsets.dwo", 0, 0, 0, ".debug_cu_index"
+};
+
+static const sChar *GetDwarfSectionName(sBool split,sInt id)
+{
+  return split ? DwoSectionNames[id] : DwarfSectionNames[id];
+}
+
+/****************************************************************************/
+
+struct ElfFileReader::Section
+{
+  sU32 Name;                        // offset in the section name table
+  sU32 Type;
+  sU64 Flags;
+  sU64 Addr;
+  sU64 Offset;
+  sU64 Size;
+  sU32 Link;
+  sU64 EntSize;
+};
+
+struct ElfFileReader::CompressedSection
+{
+  sInt DwarfId;
+  sU32 Type;                        // ELFCOMPRESS_*
+  const sU8 *Src;
+  sU64 SrcSize;
+  sU64 Size;                        // uncompressed
+  sU64 Offset;                      // in DecompressedData
+  sBool Ok;
+
+  // biggest first, so the long ones don't start last
+  bool operator <(const CompressedSection &b) const
+  {
+    return SrcSize > b.SrcSize;
+  }
+};
+
+struct ElfFileReader::CompUnit
+{
+  sU64 Offset;                      // of the unit header in .debug_info
+  sU64 End;
+  sU64 DieOffset;                   // root DIE
+  sU64 AbbrevOffset;
+  sU32 Version;
+  sU32 AddrSize;
+  sU32 OffsetSize;                  // 8 for 64 bit DWARF
+  sU64 StrOffsetsBase;
+  sU64 AddrBase;
+  sU64 RngListsBase;
+  sU64 DwoId;                       // split units only
+  sBool HasDwoId;
+  std::string Name;
+  std::string CompDir;
+  std::string DwoName;
+  sArray<sU64> Ranges;              // start, end pairs
+  sArray<sU64> Variables;           // addresses
+  sInt ObjFile;                     // in the target DebugInfo
+};
+
+// A range of the symbol table, decoded into a private DebugInfo that gets
+// merged into the real one after all chunks are done.
+struct ElfFileReader::SymbolChunk
+{
+  sU64 First,End;
+  const DebugInfo *Target;          // only read from while decoding
+  DebugInfo Part;
+  sArray<sInt> FileMap;             // object file in Target -> in Part
+  sInt NoObjFile;
+  sInt LocalFile;                   // of the STT_FILE run we're in, or -1
+  std::map<std::string,sInt> LocalFiles; // in Part, by STT_FILE name
+  NameDemangler Demangler;
+  sInt Counter;
+
+  SymbolChunk(sU64 first,sU64 end,const DebugInfo &target)
+  {
+    First = first;
+    End = end;
+    Target = &target;
+    Part.Init();
+    Part.Symbols.SetPacked(target.Symbols.IsPacked());
+    FileMap.assign(target.m_Files.size(),-1);
+    NoObjFile = -1;
+    LocalFile = -1;
+    Counter = 0;
+  }
+
+  ~SymbolChunk()
+  {
+    Part.Exit();
+  }
+
+  sInt GetFile(sInt targetFile)
+  {
+    sInt &file = FileMap[targetFile];
+    if(file < 0)
+    {
+      const sChar *name = Target->GetStringPrep(Target->m_Files[targetFile].fileName);
+      file = Part.GetFile(Part.MakeStringRef(name,sGetStringLen(name)));
+    }
+
+    return file;
+  }
+};
+
+// helpers
+static inline sU16 GetU16(const sU8 *p)
+{
+  sU16 v;
+  sCopyMem(&v,p,sizeof(v));
+  return v;
+}
+
+static inline sU32 GetU32(const sU8 *p)
+{
+  sU32 v;
+  sCopyMem(&v,p,sizeof(v));
+  return v;
+}
+
+static inline sU64 GetU64(const sU8 *p)
+{
+  sU64 v;
+  sCopyMem(&v,p,sizeof(v));
+  return v;
+}
+
+// Bounds checked reads from a DWARF section. Reading past the end gives
+// zeros and clears Ok.
+struct DwarfCursor
+{
+  const sU8 *Start;
+  const sU8 *P;
+  const sU8 *End;
+  sBool Ok;
+
+  DwarfCursor(const sU8 *start,sU64 size,sU64 offset)
+  {
+    Start = start;
+    End = start + size;
+    P = start + (offset < size ? offset : size);
+    Ok = offset <= size;
+  }
+
+  sU64 GetOffset() const            { return P - Start; }
+  sBool AtEnd() const               { return P >= End; }
+
+  sBool Need(sU64 size)
+  {
+    if(Ok && sU64(End - P) >= size)
+      return true;
+
+    Ok = false;
+    P = End;
+    return false;
+  }
+
+  void Skip(sU64 size)              { if(Need(size)) P += size; }
+  sU8 U8()                          { return Need(1) ? *P++ : 0; }
+  sU16 U16()                        { if(!Need(2)) return 0; P += 2; return GetU16(P - 2); }
+  sU32 U32()                        { if(!Need(4)) return 0; P += 4; return GetU32(P - 4); }
+  sU64 U64()                        { if(!Need(8)) return 0; P += 8; return GetU64(P - 8); }
+
+  sU64 Sized(sU32 size)
+  {
+    switch(size)
+    {
+    case 1: return U8();
+    case 2: return U16();
+    case 3: { sU64 lo = U16(); return lo | (sU64(U8()) << 16); }
+    case 4: return U32();
+    case 8: return U64();
+    default: Ok = false; P = End; return 0;
+    }
+  }
+
+  sU64 ULEB()
+  {
+    sU64 value = 0;
+    for(sU32 shift=0;;shift+=7)
+    {
+      if(!Need(1))
+        return 0;
+
+      sU8 byte = *P++;
+      if(shift < 64)
+        value |= sU64(byte & 0x7f) << shift;
+      if(!(byte & 0x80))
+        return value;
+    }
+  }
+
+  sU64 SLEB()
+  {
+    sU64 value = 0;
+    sU32 shift = 0;
+    sU8 byte;
+    do
+    {
+      if(!Need(1))
+        return 0;
+
+      byte = *P++;
+      if(shift < 64)
+        value |= sU64(byte & 0x7f) << shift;
+      shift += 7;
+    }
+    while(byte & 0x80);
+
+    if(shift < 64 && (byte & 0x40))
+      value |= ~0ull << shift;
+    return value;
+  }
+
+  // initial length field: 32 or 64 bit DWARF
+  sU64 UnitLength(sU32 &offsetSize)
+  {
+    sU64 length = U32();
+    offsetSize = 4;
+    if(length == 0xffffffff)
+    {
+      length = U64();
+      offsetSize = 8;
+    }
+
+    return length;
+  }
+};
+
+// value of one attribute, as far as it's needed
+struct DwarfValue
+{
+  sU32 Form;
+  sU64 Value;                       // size, for blocks
+  const sChar *Str;                 // DW_FORM_string
+  const sU8 *Block;                 // block and exprloc forms
+};
+
+// an abbreviation: its attributes are at Specs[Attrs...] in ReadVariables,
+// attribute, form and implicit constant each, up to a 0,0 pair
+struct DwarfAbbrev
+{
+  sU64 Tag;
+  sInt Attrs;                       // -1 = no such code
+};
+
+/****************************************************************************/
+
+ElfFileReader::ElfFileReader()
+{
+  File = 0;
+  Data = 0;
+  Size = 0;
+  Is64 = false;
+  SymData = 0;
+  SymCount = 0;
+  SymSize = 0;
+  StrData = 0;
+  StrSize = 0;
+  ShndxData = 0;
+  DecompressedData = 0;
+  Jobs = JOB_UNITS;
+  SplitDwarf = false;
+  Package = 0;
+}
+
+ElfFileReader::~ElfFileReader()
+{
+  Close();
+}
+
+sBool ElfFileReader::IsElf(const sChar *fileName)
+{
+  sU8 magic[4];
+  FILE *f = fopen(fileName,"rb");
+  if(!f)
+    return false;
+
+  sBool isElf = fread(magic,1,4,f) == 4 && !memcmp(magic,"\x7f" "ELF",4);
+  fclose(f);
+  return isElf;
+}
+
+sBool ElfFileReader::ReadSections()
+{
+  if(Size < 64 || Data[4] < 1 || Data[4] > 2)
+  {
+    fprintf(stderr,"  not a valid ELF file\n");
+    return false;
+  }
+
+  if(Data[5] != 1)
+  {
+    fprintf(stderr,"  big endian ELF files aren't supported\n");
+    return false;
+  }
+
+  Is64 = Data[4] == 2;
+  sU32 type = GetU16(Data + 16);
+  if(SplitDwarf ? type != ET_REL : type != ET_EXEC && type != ET_DYN)
+  {
+    fprintf(stderr,"  not an ELF executable or shared object\n");
+    return false;
+  }
+
+  sU64 shOff = Is64 ? GetU64(Data + 0x28) : GetU32(Data + 0x20);
+  sU32 shEntSize = GetU16(Data + (Is64 ? 0x3a : 0x2e));
+  sU64 shNum = GetU16(Data + (Is64 ? 0x3c : 0x30));
+  sU32 shStrNdx = GetU16(Data + (Is64 ? 0x3e : 0x32));
+
+  sU32 minEntSize = Is64 ? 64 : 40;
+  if(!shOff || shEntSize < minEntSize || shOff > Size || Size - shOff < shEntSize)
+  {
+    fprintf(stderr,"  ELF file has no section headers\n");
+    return false;
+  }
+
+  // extended numbering keeps the real values in section 0
+  const sU8 *sh0 = Data + shOff;
+  if(shNum == 0)
+    shNum = Is64 ? GetU64(sh0 + 32) : GetU32(sh0 + 20);
+  if(shStrNdx == SHN_XINDEX)
+    shStrNdx = GetU32(sh0 + (Is64 ? 40 : 24));
+
+  if(shNum > (Size - shOff) / shEntSize)
+  {
+    fprintf(stderr,"  ELF file has damaged section headers\n");
+    return false;
+  }
+
+  Sections.resize((sInt) shNum);
+  for(sInt i=0;i<Sections.size();i++)
+  {
+    const sU8 *sh = Data + shOff + sU64(i) * shEntSize;
+    Section &sec = Sections[i];
+
+    sec.Name = GetU32(sh);
+    sec.Type = GetU32(sh + 4);
+    if(Is64)
+    {
+      sec.Flags = GetU64(sh + 8);
+      sec.Addr = GetU64(sh + 16);
+      sec.Offset = GetU64(sh + 24);
+      sec.Size = GetU64(sh + 32);
+      sec.Link = GetU32(sh + 40);
+      sec.EntSize = GetU64(sh + 56);
+    }
+    else
+    {
+      sec.Flags = GetU32(sh + 8);
+      sec.Addr = GetU32(sh + 12);
+      sec.Offset = GetU32(sh + 16);
+      sec.Size = GetU32(sh + 20);
+      sec.Link = GetU32(sh + 24);
+      sec.EntSize = GetU32(sh + 36);
+    }
+  }
+
+  // section names, for the DWARF sections
+  SectionData names;
+  if(shStrNdx < Sections.size() && GetSectionData(shStrNdx,names))
+  {
+    for(sInt i=0;i<Sections.size();i++)
+    {
+      sU32 name = Sections[i].Name;
+      if(name >= names.Size || !memchr(names.Data + name,0,names.Size - name))
+        continue;
+
+      // .zdebug_info is the pre-SHF_COMPRESSED way of saying it
+      const sChar *secName = (const sChar *) names.Data + name;
+      sBool gnuStyle = !strncmp(secName,".zdebug_",8);
+      if(gnuStyle)
+        secName++;
+
+      for(sInt j=0;j<DW_SEC_COUNT;j++)
+      {
+        const sChar *dwarfName = GetDwarfSectionName(SplitDwarf,j);
+        if(!dwarfName || (gnuStyle ? strcmp(secName + 1,dwarfName + 1) : strcmp(secName,dwarfName)))
+          continue;
+
+        if(gnuStyle || (Sections[i].Flags & SHF_COMPRESSED))
+          AddCompressedSection(i,j,gnuStyle);
+        else
+          GetSectionData(i,Dwarf[j]);
+        break;
+      }
+    }
+  }
+
+  return true;
+}
+
+sBool ElfFileReader::FindSymbolTable()
+{
+  // symbol table, or the dynamic one of stripped files
+  sInt symTab = -1;
+  for(sInt i=0;i<Sections.size();i++)
+  {
+    if(Sections[i].Type == SHT_SYMTAB || Sections[i].Type == SHT_DYNSYM && symTab < 0)
+      symTab = i;
+  }
+
+  SectionData symbols, strings;
+  if(symTab < 0 || Sections[symTab].Link >= Sections.size()
+    || !GetSectionData(symTab,symbols) || !GetSectionData(Sections[symTab].Link,strings))
+  {
+    fprintf(stderr,"  ELF file has no symbol table\n");
+    return false;
+  }
+
+  SymSize = Is64 ? 24 : 16;
+  SymData = symbols.Data;
+  SymCount = symbols.Size / SymSize;
+  StrData = (const sChar *) strings.Data;
+  StrSize = strings.Size;
+
+  ShndxData = 0;
+  for(sInt i=0;i<Sections.size();i++)
+  {
+    SectionData shndx;
+    if(Sections[i].Type == SHT_SYMTAB_SHNDX && Sections[i].Link == symTab
+      && GetSectionData(i,shndx) && shndx.Size >= SymCount * 4)
+      ShndxData = shndx.Data;
+  }
+
+  return true;
+}
+
+// contents of a section in the file, false for NOBITS/broken ones. For
+// compressed sections, that's the compressed data.
+sBool ElfFileReader::GetSectionData(sInt index,SectionData &out)
+{
+  const Section &sec = Sections[index];
+  if(sec.Type == SHT_NOBITS || sec.Offset > Size || sec.Size > Size - sec.Offset)
+    return false;
+
+  out.Data = Data + sec.Offset;
+  out.Size = sec.Size;
+  return true;
+}
+
+void ElfFileReader::AddCompressedSection(sInt index,sInt dwarfId,sBool gnuStyle)
+{
+  SectionData data;
+  if(!GetSectionData(index,data))
+    return;
+
+  CompressedSection sec;
+  sec.DwarfId = dwarfId;
+  sec.Ok = false;
+
+  if(gnuStyle)
+  {
+    // "ZLIB", then the uncompressed size big endian
+    if(data.Size < 12 || memcmp(data.Data,"ZLIB",4))
+      return;
+
+    sec.Type = ELFCOMPRESS_ZLIB;
+    sec.Size = 0;
+    for(sInt i=4;i<12;i++)
+      sec.Size = (sec.Size << 8) | data.Data[i];
+    sec.Src = data.Data + 12;
+    sec.SrcSize = data.Size - 12;
+  }
+  else
+  {
+    // Elf32_Chdr/Elf64_Chdr: type, (reserved,) size, alignment
+    sU32 headerSize = Is64 ? 24 : 12;
+    if(data.Size < headerSize)
+      return;
+
+    sec.Type = GetU32(data.Data);
+    sec.Size = Is64 ? GetU64(data.Data + 8) : GetU32(data.Data + 4);
+    sec.Src = data.Data + headerSize;
+    sec.SrcSize = data.Size - headerSize;
+  }
+
+  Compressed.push_back(sec);
+}
+
+void ElfFileReader::DecompressSections()
+{
+  if(Compressed.empty())
+    return;
+
+  sU64 total = 0;
+  sBool zstdMissing = false;
+  for(sInt i=0;i<Compressed.size();i++)
+  {
+    CompressedSection &sec = Compressed[i];
+    if(sec.Type == ELFCOMPRESS_ZSTD && !CanDecompressZstd())
+    {
+      zstdMissing = true;
+      sec.Type = 0;
+    }
+
+    sec.Offset = total;
+    total += (sec.Size + 7) & ~7ull;
+  }
+
+  if(zstdMissing)
+    fprintf(stderr,"  zstd compressed debug sections need a build with SIZER_ZSTD, skipping them\n");
+
+  DecompressedData = (total == (size_t) total) ? (sU8 *) malloc((size_t) total + 1) : 0;
+  if(!DecompressedData)
+  {
+    fprintf(stderr,"  not enough memory to decompress debug sections\n");
+    return;
+  }
+
+  std::sort(Compressed.begin(),Compressed.end());
+  Jobs = JOB_DECOMPRESS;
+  ParallelJobs::Run(Compressed.size());
+
+  for(sInt i=0;i<Compressed.size();i++)
+  {
+    const CompressedSection &sec = Compressed[i];
+    if(sec.Ok)
+    {
+      Dwarf[sec.DwarfId].Data = DecompressedData + sec.Offset;
+      Dwarf[sec.DwarfId].Size = sec.Size;
+    }
+    else if(sec.Type)
+      fprintf(stderr,"  couldn't decompress %s, skipping it\n",GetDwarfSectionName(SplitDwarf,sec.DwarfId));
+  }
+}
+
+/****************************************************************************/
+
+// Reads the header of the unit at offset in .debug_info, up to its root
+// DIE. next gets the offset of the following unit, or 0 if the header is
+// broken; the result says whether this is a compilation unit we can read.
+sBool ElfFileReader::ReadUnitHeader(sU64 offset,CompUnit &unit,sU64 &next) const
+{
+  const SectionData &info = Dwarf[DW_SEC_INFO];
+  DwarfCursor c(info.Data,info.Size,offset);
+
+  next = 0;
+  sU32 offsetSize;
+  sU64 length = c.UnitLength(offsetSize);
+  sU64 headerEnd = c.GetOffset();
+  if(!c.Ok || length > info.Size - headerEnd)
+    return false;
+
+  sU64 end = headerEnd + length;
+  sU32 version = c.U16();
+  sU32 unitType = DW_UT_compile;
+  sU32 addrSize;
+  sU64 abbrevOffset;
+
+  unit.DwoId = 0;
+  unit.HasDwoId = false;
+  if(version >= 5)
+  {
+    unitType = c.U8();
+    addrSize = c.U8();
+    abbrevOffset = c.Sized(offsetSize);
+    if(unitType == DW_UT_skeleton || unitType == DW_UT_split_compile)
+    {
+      unit.DwoId = c.U64();
+      unit.HasDwoId = true;
+    }
+  }
+  else
+  {
+    abbrevOffset = c.Sized(offsetSize);
+    addrSize = c.U8();
+  }
+
+  next = end;
+  if(!c.Ok || version < 2 || version > 5 || addrSize != 4 && addrSize != 8)
+    return false;
+
+  if(unitType != DW_UT_compile && unitType != DW_UT_partial && unitType != DW_UT_skeleton && unitType != DW_UT_split_compile)
+    return false;
+
+  unit.Offset = offset;
+  unit.End = end;
+  unit.DieOffset = c.GetOffset();
+  unit.AbbrevOffset = abbrevOffset;
+  unit.Version = version;
+  unit.AddrSize = addrSize;
+  unit.OffsetSize = offsetSize;
+  unit.StrOffsetsBase = 2 * offsetSize; // past the table header, if not given
+  unit.AddrBase = 2 * offsetSize;
+  unit.RngListsBase = 0;
+  unit.ObjFile = -1;
+  return true;
+}
+
+// unit headers are read in order, their root DIEs are decoded in parallel
+void ElfFileReader::ReadUnits()
+{
+  const SectionData &info = Dwarf[DW_SEC_INFO];
+  sU64 offset = 0;
+
+  while(offset < info.Size)
+  {
+    CompUnit unit;
+    sU64 next;
+    if(ReadUnitHeader(offset,unit,next))
+      Units.push_back(new CompUnit(unit));
+
+    if(!next)
+      break;
+
+    offset = next;
+  }
+
+  // with split DWARF, the names are in a package next to the file
+  std::string packageName = FileName + ".dwp";
+  if(IsElf(packageName.c_str()))
+  {
+    Package = new ElfFileReader;
+    if(!Package->OpenSplitDwarf(packageName.c_str()))
+    {
+      fprintf(stderr,"  %s has no split DWARF, ignoring it\n",packageName.c_str());
+      delete Package;
+      Package = 0;
+    }
+  }
+
+  Jobs = JOB_UNITS;
+  ParallelJobs::Run(Units.size());
+}
+
+// reads one attribute value; block-like forms are skipped
+static sBool ReadValue(DwarfCursor &c,sU32 form,sU64 implicitConst,sU32 version,sU32 addrSize,sU32 offsetSize,DwarfValue &v)
+{
+  v.Form = form;
+  v.Value = 0;
+  v.Str = 0;
+  v.Block = 0;
+
+  switch(form)
+  {
+  case DW_FORM_addr:            v.Value = c.Sized(addrSize); break;
+  case DW_FORM_data1:
+  case DW_FORM_ref1:
+  case DW_FORM_flag:
+  case DW_FORM_strx1:
+  case DW_FORM_addrx1:          v.Value = c.U8(); break;
+  case DW_FORM_data2:
+  case DW_FORM_ref2:
+  case DW_FORM_strx2:
+  case DW_FORM_addrx2:          v.Value = c.U16(); break;
+  case DW_FORM_strx3:
+  case DW_FORM_addrx3:          v.Value = c.Sized(3); break;
+  case DW_FORM_data4:
+  case DW_FORM_ref4:
+  case DW_FORM_ref_sup4:
+  case DW_FORM_strx4:
+  case DW_FORM_addrx4:          v.Value = c.U32(); break;
+  case DW_FORM_data8:
+  case DW_FORM_ref8:
+  case DW_FORM_ref_sig8:
+  case DW_FORM_ref_sup8:        v.Value = c.U64(); break;
+  case DW_FORM_data16:          c.Skip(16); break;
+  case DW_FORM_sdata:           v.Value = c.SLEB(); break;
+  case DW_FORM_udata:
+  case DW_FORM_ref_udata:
+  case DW_FORM_strx:
+  case DW_FORM_addrx:
+  case DW_FORM_loclistx:
+  case DW_FORM_rnglistx:
+  case DW_FORM_GNU_addr_index:
+  case DW_FORM_GNU_str_index:   v.Value = c.ULEB(); break;
+  case DW_FORM_strp:
+  case DW_FORM_line_strp:
+  case DW_FORM_sec_offset:
+  case DW_FORM_strp_sup:
+  case DW_FORM_GNU_ref_alt:
+  case DW_FORM_GNU_strp_alt:    v.Value = c.Sized(offsetSize); break;
+  case DW_FORM_ref_addr:        v.Value = c.Sized(version <= 2 ? addrSize : offsetSize); break;
+  case DW_FORM_flag_present:    v.Value = 1; break;
+  case DW_FORM_implicit_const:  v.Value = implicitConst; break;
+  case DW_FORM_block1:          v.Value = c.U8(); v.Block = c.P; c.Skip(v.Value); break;
+  case DW_FORM_block2:          v.Value = c.U16(); v.Block = c.P; c.Skip(v.Value); break;
+  case DW_FORM_block4:          v.Value = c.U32(); v.Block = c.P; c.Skip(v.Value); break;
+  case DW_FORM_block:
+  case DW_FORM_exprloc:         v.Value = c.ULEB(); v.Block = c.P; c.Skip(v.Value); break;
+
+  case DW_FORM_string:
+    {
+      const sU8 *end = c.AtEnd() ? 0 : (const sU8 *) memchr(c.P,0,c.End - c.P);
+      if(!end)
+        return c.Ok = false;
+
+      v.Str = (const sChar *) c.P;
+      c.P = end + 1;
+    }
+    break;
+
+  case DW_FORM_indirect:
+    return ReadValue(c,(sU32) c.ULEB(),implicitConst,version,addrSize,offsetSize,v);
+
+  default:
+    return c.Ok = false;
+  }
+
+  return c.Ok;
+}
+
+static sBool IsConstantForm(sU32 form)
+{
+  switch(form)
+  {
+  case DW_FORM_data1: case DW_FORM_data2: case DW_FORM_data4: case DW_FORM_data8:
+  case DW_FORM_sdata: case DW_FORM_udata: case DW_FORM_implicit_const:
+    return true;
+  }
+
+  return false;
+}
+
+// 0 terminated string at offset in a string section, or 0
+static const sChar *GetString(const sU8 *data,sU64 size,sU64 offset)
+{
+  if(!data || offset >= size || !memchr(data + offset,0,size - offset))
+    return 0;
+
+  return (const sChar *) data + offset;
+}
+
+static std::string JoinPath(const std::string &dir,const sChar *name)
+{
+  if(dir.empty() || name[0] == '/' || name[0] == '\\' || name[0] && name[1] == ':')
+    return name;
+
+  return dir + "/" + name;
+}
+
+void ElfFileReader::DecodeUnit(CompUnit &unit)
+{
+  const SectionData &info = Dwarf[DW_SEC_INFO];
+  const SectionData &abbrevs = Dwarf[DW_SEC_ABBREV];
+  DwarfCursor die(info.Data,unit.End,unit.DieOffset);
+  sU64 code = die.ULEB();
+
+  // find the abbreviation of the root DIE
+  DwarfCursor abbrev(abbrevs.Data,abbrevs.Size,unit.AbbrevOffset);
+  sU64 tag = 0;
+  while(abbrev.Ok && !abbrev.AtEnd())
+  {
+    sU64 abbrevCode = abbrev.ULEB();
+    if(!abbrevCode)
+      return;
+
+    tag = abbrev.ULEB();
+    abbrev.U8(); // has children
+    if(abbrevCode == code)
+      break;
+
+    for(;;)
+    {
+      sU64 attr = abbrev.ULEB();
+      sU64 form = abbrev.ULEB();
+      if(form == DW_FORM_implicit_const)
+        abbrev.SLEB();
+      if(!abbrev.Ok || !attr && !form)
+        break;
+    }
+  }
+
+  if(!die.Ok || !abbrev.Ok || tag != DW_TAG_compile_unit && tag != DW_TAG_partial_unit && tag != DW_TAG_skeleton_unit)
+    return;
+
+  DwarfValue name = { 0,0,0 }, compDir = { 0,0,0 }, dwoName = { 0,0,0 };
+  DwarfValue lowPC = { 0,0,0 }, highPC = { 0,0,0 }, ranges = { 0,0,0 };
+  for(;;)
+  {
+    sU32 attr = (sU32) abbrev.ULEB();
+    sU32 form = (sU32) abbrev.ULEB();
+    sU64 implicitConst = (form == DW_FORM_implicit_const) ? abbrev.SLEB() : 0;
+    if(!abbrev.Ok || !attr && !form)
+      break;
+
+    DwarfValue v;
+    if(!ReadValue(die,form,implicitConst,unit.Version,unit.AddrSize,unit.OffsetSize,v))
+      return;
+
+    switch(attr)
+    {
+    case DW_AT_name:              name = v; break;
+    case DW_AT_comp_dir:          compDir = v; break;
+    case DW_AT_low_pc:            lowPC = v; break;
+    case DW_AT_high_pc:           highPC = v; break;
+    case DW_AT_ranges:            ranges = v; break;
+    case DW_AT_str_offsets_base:  unit.StrOffsetsBase = v.Value; break;
+    case DW_AT_addr_base:
+    case DW_AT_GNU_addr_base:     unit.AddrBase = v.Value; break;
+    case DW_AT_rnglists_base:     unit.RngListsBase = v.Value; break;
+    case DW_AT_dwo_name:
+    case DW_AT_GNU_dwo_name:      dwoName = v; break;
+    case DW_AT_GNU_dwo_id:        unit.DwoId = v.Value; unit.HasDwoId = true; break;
+    }
+  }
+
+  // now that all the bases are known, resolve strings and addresses
+  struct Resolve
+  {
+    const ElfFileReader &R;
+    const CompUnit &U;
+    Resolve(const ElfFileReader &r,const CompUnit &u) : R(r), U(u) {}
+
+    const sChar *String(const DwarfValue &v) const
+    {
+      switch(v.Form)
+      {
+      case DW_FORM_string:      return v.Str;
+      case DW_FORM_strp:        return GetString(R.Dwarf[DW_SEC_STR].Data,R.Dwarf[DW_SEC_STR].Size,v.Value);
+      case DW_FORM_line_strp:   return GetString(R.Dwarf[DW_SEC_LINE_STR].Data,R.Dwarf[DW_SEC_LINE_STR].Size,v.Value);
+      case DW_FORM_strx: case DW_FORM_strx1: case DW_FORM_strx2: case DW_FORM_strx3: case DW_FORM_strx4:
+      case DW_FORM_GNU_str_index:
+        {
+          const SectionData &offsets = R.Dwarf[DW_SEC_STR_OFFSETS];
+          DwarfCursor c(offsets.Data,offsets.Size,U.StrOffsetsBase + v.Value * U.OffsetSize);
+          sU64 offset = c.Sized(U.OffsetSize);
+          return c.Ok ? GetString(R.Dwarf[DW_SEC_STR].Data,R.Dwarf[DW_SEC_STR].Size,offset) : 0;
+        }
+      }
+
+      return 0;
+    }
+
+    sU64 Address(const DwarfValue &v) const
+    {
+      if(v.Form == DW_FORM_addr)
+        return v.Value;
+
+      return R.GetIndexedAddress(U,v.Value);
+    }
+  } resolve(*this,unit);
+
+  const sChar *unitName = resolve.String(name);
+  const sChar *dir = resolve.String(compDir);
+  const sChar *dwo = resolve.String(dwoName);
+  if(dir)
+    unit.CompDir = dir;
+  if(unitName)
+    unit.Name = JoinPath(unit.CompDir,unitName);
+  if(dwo)
+    unit.DwoName = JoinPath(unit.CompDir,dwo);
+
+  sU64 base = lowPC.Form ? resolve.Address(lowPC) : 0;
+  if(lowPC.Form && highPC.Form)
+  {
+    sU64 end = IsConstantForm(highPC.Form) ? base + highPC.Value : resolve.Address(highPC);
+    if(end > base)
+    {
+      unit.Ranges.push_back(base);
+      unit.Ranges.push_back(end);
+    }
+  }
+
+  if(ranges.Form)
+  {
+    if(unit.Version >= 5)
+    {
+      sU64 offset = ranges.Value;
+      if(ranges.Form == DW_FORM_rnglistx)
+      {
+        const SectionData &lists = Dwarf[DW_SEC_RNGLISTS];
+        DwarfCursor c(lists.Data,lists.Size,unit.RngListsBase + ranges.Value * unit.OffsetSize);
+        offset = unit.RngListsBase + c.Sized(unit.OffsetSize);
+        if(!c.Ok)
+          return;
+      }
+
+      ReadRangeList(unit,offset,base,true,unit.Ranges);
+    }
+    else
+      ReadRangeList(unit,ranges.Value,base,false,unit.Ranges);
+  }
+}
+
+// The addresses of the variables a unit defines: DW_TAG_variable DIEs
+// anywhere in it (function statics too) whose location is nothing but a
+// DW_OP_addr. With DW_OP_addrx, the address is in .debug_addr, which for
+// split units is in the skeleton's file; those indices are left to the
+// caller. Variables of discarded sections are at 0 or -1/-2, like ranges.
+void ElfFileReader::ReadVariables(const CompUnit &unit,sArray<sU64> &addrs,sArray<sU64> &indices) const
+{
+  const SectionData &info = Dwarf[DW_SEC_INFO];
+  const SectionData &abbrevs = Dwarf[DW_SEC_ABBREV];
+
+  // abbreviations, by code; codes are almost always 1,2,3...
+  sArray<DwarfAbbrev> table;
+  sArray<sU64> specs;
+  DwarfCursor abbrev(abbrevs.Data,abbrevs.Size,unit.AbbrevOffset);
+  while(abbrev.Ok && !abbrev.AtEnd())
+  {
+    sU64 code = abbrev.ULEB();
+    if(!code || code > abbrevs.Size)
+      break;
+
+    DwarfAbbrev entry;
+    entry.Tag = abbrev.ULEB();
+    entry.Attrs = specs.size();
+    abbrev.U8(); // has children
+
+    for(;;)
+    {
+      sU64 attr = abbrev.ULEB();
+      sU64 form = abbrev.ULEB();
+      specs.push_back(attr);
+      specs.push_back(form);
+      specs.push_back(form == DW_FORM_implicit_const ? abbrev.SLEB() : 0);
+      if(!abbrev.Ok || !attr && !form)
+        break;
+    }
+
+    if(code >= table.size())
+    {
+      DwarfAbbrev none = { 0,-1 };
+      table.resize(code + 1,none);
+    }
+    table[code] = entry;
+  }
+
+  if(!abbrev.Ok)
+    return;
+
+  sU64 tombstone = (unit.AddrSize == 4) ? 0xfffffffeull : ~1ull;
+  DwarfCursor die(info.Data,unit.End,unit.DieOffset);
+  while(die.Ok && !die.AtEnd())
+  {
+    sU64 code = die.ULEB();
+    if(!code)
+      continue; // end of a list of children
+
+    if(code >= table.size() || table[code].Attrs < 0)
+      return;
+
+    const DwarfAbbrev &entry = table[code];
+    for(sInt i=entry.Attrs;specs[i] || specs[i+1];i+=3)
+    {
+      DwarfValue v;
+      if(!ReadValue(die,(sU32) specs[i+1],specs[i+2],unit.Version,unit.AddrSize,unit.OffsetSize,v))
+        return;
+
+      if(entry.Tag != DW_TAG_variable || specs[i] != DW_AT_location || !v.Block)
+        continue;
+
+      DwarfCursor expr(v.Block,v.Value,0);
+      sU8 op = expr.U8();
+      if(op == DW_OP_addr)
+      {
+        sU64 addr = expr.Sized(unit.AddrSize);
+        if(expr.Ok && expr.AtEnd() && addr && addr < tombstone)
+          addrs.push_back(addr);
+      }
+      else if(op == DW_OP_addrx || op == DW_OP_GNU_addr_index)
+      {
+        sU64 index = expr.ULEB();
+        if(expr.Ok && expr.AtEnd())
+          indices.push_back(index);
+      }
+    }
+  }
+}
+
+// looks up the DW_OP_addrx variables of a unit in our .debug_addr
+void ElfFileReader::ResolveVariables(CompUnit &unit,const sArray<sU64> &indices)
+{
+  sU64 tombstone = (unit.AddrSize == 4) ? 0xfffffffeull : ~1ull;
+  for(sInt i=0;i<indices.size();i++)
+  {
+    sU64 addr = GetIndexedAddress(unit,indices[i]);
+    if(addr && addr < tombstone)
+      unit.Variables.push_back(addr);
+  }
+}
+
+// Skeleton units of split DWARF only have the ranges, the rest is in the
+// split unit in a .dwp package or in its own .dwo file.
+void ElfFileReader::ResolveSplitUnit(CompUnit &unit)
+{
+  CompUnit split;
+  sArray<sU64> indices;
+
+  if(Package)
+  {
+    if(Package->FindSplitUnit(unit.DwoId,split))
+    {
+      Package->DecodeUnit(split);
+      Package->ReadVariables(split,unit.Variables,indices);
+    }
+  }
+  else if(!unit.DwoName.empty())
+  {
+    ElfFileReader dwo;
+    if(dwo.OpenSplitDwarf(unit.DwoName.c_str()) && dwo.FindSplitUnit(unit.DwoId,split))
+    {
+      dwo.DecodeUnit(split);
+      dwo.ReadVariables(split,unit.Variables,indices);
+    }
+  }
+
+  ResolveVariables(unit,indices);
+
+  // without the split unit, the .dwo name still tells the object file
+  if(!split.Name.empty())
+    unit.Name = JoinPath(unit.CompDir,split.Name.c_str());
+  else
+    unit.Name = unit.DwoName;
+}
+
+// The split unit with the given id, using the package index if there is
+// one. A plain .dwo file just has the one unit.
+sBool ElfFileReader::FindSplitUnit(sU64 dwoId,CompUnit &unit) const
+{
+  const SectionData &index = Dwarf[DW_SEC_CU_INDEX];
+  sU64 next;
+
+  if(!index.Data)
+  {
+    for(sU64 offset=0;offset<Dwarf[DW_SEC_INFO].Size;offset=next)
+    {
+      if(ReadUnitHeader(offset,unit,next) && (!unit.HasDwoId || unit.DwoId == dwoId))
+      {
+        if(unit.Version < 5)
+          unit.StrOffsetsBase = 0; // GNU split DWARF has no table header
+        return true;
+      }
+      if(!next)
+        break;
+    }
+
+    return false;
+  }
+
+  // header: version, column count, unit count, slot count
+  DwarfCursor c(index.Data,index.Size,0);
+  sU32 version = c.U32() & 0xffff;
+  sU32 nColumns = c.U32();
+  sU32 nUnits = c.U32();
+  sU32 nSlots = c.U32();
+  if(!c.Ok || version != 2 && version != 5 || !nSlots || (nSlots & (nSlots - 1)))
+    return false;
+
+  sU64 tableSize = sU64(nSlots) * 12 + sU64(nColumns) * 4 + sU64(nUnits) * nColumns * 8;
+  if(tableSize > index.Size - 16)
+    return false;
+
+  const sU8 *signatures = index.Data + 16;
+  const sU8 *rows = signatures + sU64(nSlots) * 8;
+  const sU8 *columns = rows + sU64(nSlots) * 4;
+  const sU8 *offsets = columns + sU64(nColumns) * 4;
+  const sU8 *sizes = offsets + sU64(nUnits) * nColumns * 4;
+
+  // open addressing, the step comes from the upper half of the id
+  sU32 mask = nSlots - 1;
+  sU32 slot = (sU32) dwoId & mask;
+  sU32 step = ((sU32) (dwoId >> 32) & mask) | 1;
+  sU32 row = 0;
+
+  for(sU32 i=0;i<nSlots;i++)
+  {
+    sU32 r = GetU32(rows + slot * 4);
+    if(!r)
+      break;
+
+    if(GetU64(signatures + slot * 8) == dwoId)
+    {
+      row = r;
+      break;
+    }
+
+    slot = (slot + step) & mask;
+  }
+
+  if(!row || row > nUnits)
+    return false;
+
+  // where this unit's pieces are in the package sections
+  sU64 infoOffset = 0, infoSize = 0, abbrevOffset = 0, strOffsets = 0;
+  for(sU32 i=0;i<nColumns;i++)
+  {
+    sU64 cell = (sU64(row - 1) * nColumns + i) * 4;
+    switch(GetU32(columns + i * 4))
+    {
+    case DW_SECT_INFO:        infoOffset = GetU32(offsets + cell); infoSize = GetU32(sizes + cell); break;
+    case DW_SECT_ABBREV:      abbrevOffset = GetU32(offsets + cell); break;
+    case DW_SECT_STR_OFFSETS: strOffsets = GetU32(offsets + cell); break;
+    }
+  }
+
+  if(!infoSize || !ReadUnitHeader(infoOffset,unit,next) || next > infoOffset + infoSize)
+    return false;
+
+  // the bases are implicit in split units
+  unit.AbbrevOffset += abbrevOffset;
+  unit.StrOffsetsBase = strOffsets + (unit.Version >= 5 ? 2 * unit.OffsetSize : 0);
+  return true;
+}
+
+sU64 ElfFileReader::GetIndexedAddress(const CompUnit &unit,sU64 index) const
+{
+  const SectionData &addrs = Dwarf[DW_SEC_ADDR];
+  DwarfCursor c(addrs.Data,addrs.Size,unit.AddrBase + index * unit.AddrSize);
+  sU64 addr = c.Sized(unit.AddrSize);
+  return c.Ok ? addr : 0;
+}
+
+// ranges of discarded code are at 0, or at -1/-2 with newer linkers
+static void AddRange(sArray<sU64> &ranges,sU64 start,sU64 end,sU32 addrSize)
+{
+  sU64 tombstone = (addrSize == 4) ? 0xfffffffeull : ~1ull;
+  if(start && start < tombstone && end > start)
+  {
+    ranges.push_back(start);
+    ranges.push_back(end);
+  }
+}
+
+void ElfFileReader::ReadRangeList(const CompUnit &unit,sU64 offset,sU64 base,sBool rnglists,sArray<sU64> &ranges)
+{
+  sU32 addrSize = unit.AddrSize;
+  sU64 maxAddr = (addrSize == 4) ? 0xffffffffull : ~0ull;
+
+  if(!rnglists)
+  {
+    // .debug_ranges: start/end pairs, relative to the base address
+    const SectionData &sec = Dwarf[DW_SEC_RANGES];
+    DwarfCursor c(sec.Data,sec.Size,offset);
+
+    while(c.Ok && !c.AtEnd())
+    {
+      sU64 start = c.Sized(addrSize);
+      sU64 end = c.Sized(addrSize);
+      if(!c.Ok || !start && !end)
+        break;
+
+      if(start == maxAddr)
+        base = end;
+      else
+        AddRange(ranges,base + start,base + end,addrSize);
+    }
+
+    return;
+  }
+
+  const SectionData &sec = Dwarf[DW_SEC_RNGLISTS];
+  DwarfCursor c(sec.Data,sec.Size,offset);
+
+  while(c.Ok && !c.AtEnd())
+  {
+    sU64 start, end;
+
+    switch(c.U8())
+    {
+    case DW_RLE_end_of_list:
+      return;
+
+    case DW_RLE_base_addressx:
+      base = GetIndexedAddress(unit,c.ULEB());
+      continue;
+
+    case DW_RLE_startx_endx:
+      start = GetIndexedAddress(unit,c.ULEB());
+      end = GetIndexedAddress(unit,c.ULEB());
+      break;
+
+    case DW_RLE_startx_length:
+      start = GetIndexedAddress(unit,c.ULEB());
+      end = start + c.ULEB();
+      break;
+
+    case DW_RLE_offset_pair:
+      start = base + c.ULEB();
+      end = base + c.ULEB();
+      break;
+
+    case DW_RLE_base_address:
+      base = c.Sized(addrSize);
+      continue;
+
+    case DW_RLE_start_end:
+      start = c.Sized(addrSize);
+      end = c.Sized(addrSize);
+      break;
+
+    case DW_RLE_start_length:
+      start = c.Sized(addrSize);
+      end = start + c.ULEB();
+      break;
+
+    default:
+      return;
+    }
+
+    if(c.Ok)
+      AddRange(ranges,start,end,addrSize);
+  }
+}
+
+// .debug_aranges, for units that don't describe their ranges themselves
+void ElfFileReader::ReadAddressRanges()
+{
+  const SectionData &sec = Dwarf[DW_SEC_ARANGES];
+  DwarfCursor c(sec.Data,sec.Size,0);
+
+  while(sec.Data && !c.AtEnd())
+  {
+    sU64 start = c.GetOffset();
+    sU32 offsetSize;
+    sU64 length = c.UnitLength(offsetSize);
+    if(!c.Ok || length > sec.Size - c.GetOffset())
+      break;
+
+    sU64 end = c.GetOffset() + length;
+    c.U16(); // version
+    sU64 infoOffset = c.Sized(offsetSize);
+    sU32 addrSize = c.U8();
+    c.U8(); // segment selector size
+
+    // tuples are aligned to twice the address size
+    CompUnit *unit = 0;
+    if(c.Ok && (addrSize == 4 || addrSize == 8))
+    {
+      sInt lo = 0, hi = Units.size();
+      while(lo < hi)
+      {
+        sInt mid = (lo + hi) / 2;
+        if(Units[mid]->Offset < infoOffset)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+
+      if(lo < Units.size() && Units[lo]->Offset == infoOffset)
+        unit = Units[lo];
+    }
+
+    if(unit)
+    {
+      sU64 tupleSize = 2 * addrSize;
+      DwarfCursor t(sec.Data,end,start + ((c.GetOffset() - start + tupleSize - 1) / tupleSize) * tupleSize);
+      while(t.Ok && !t.AtEnd())
+      {
+        sU64 addr = t.Sized(addrSize);
+        sU64 size = t.Sized(addrSize);
+        if(!t.Ok || !addr && !size)
+          break;
+
+        AddRange(unit->Ranges,addr,addr + size,addrSize);
+      }
+    }
+
+    c = DwarfCursor(sec.Data,sec.Size,end);
+  }
+}
+
+struct UnitRange
+{
+  sU64 Start,End;
+  sInt Unit;
+
+  bool operator <(const UnitRange &b) const
+  {
+    if(Start != b.Start)
+      return Start < b.Start;
+    if(End != b.End)
+      return End > b.End;
+    return Unit < b.Unit;
+  }
+};
+
+void ElfFileReader::BuildUnitIndex(DebugInfo &to)
+{
+  sArray<UnitRange> ranges;
+  Variables.clear();
+  UnitFiles.clear();
+
+  for(sInt i=0;i<Units.size();i++)
+  {
+    CompUnit &unit = *Units[i];
+    if(unit.Name.empty() || unit.Ranges.empty() && unit.Variables.empty())
+      continue;
+
+    unit.ObjFile = to.GetFile(to.MakeString(unit.Name.c_str()));
+    for(sInt j=0;j+1<unit.Ranges.size();j+=2)
+    {
+      UnitRange range = { unit.Ranges[j],unit.Ranges[j+1],i };
+      ranges.push_back(range);
+    }
+
+    for(sInt j=0;j<unit.Variables.size();j++)
+    {
+      UnitVariable var = { unit.Variables[j],i };
+      Variables.push_back(var);
+    }
+
+    sArray<sU64>().swap(unit.Ranges);
+    sArray<sU64>().swap(unit.Variables);
+
+    // STT_FILE symbols only have the base name
+    std::string::size_type slash = unit.Name.find_last_of("/\\");
+    std::string baseName = unit.Name.substr(slash == std::string::npos ? 0 : slash + 1);
+    std::map<std::string,sInt>::iterator it = UnitFiles.find(baseName);
+    if(it == UnitFiles.end())
+      UnitFiles.insert(std::make_pair(baseName,unit.ObjFile));
+    else if(it->second != unit.ObjFile)
+      it->second = -1;
+  }
+
+  std::sort(Variables.begin(),Variables.end());
+
+  std::sort(ranges.begin(),ranges.end());
+
+  UnitIndex.Clear();
+  UnitOfRange.clear();
+  for(sInt i=0;i<ranges.size();i++)
+  {
+    // aranges usually repeat what the DIEs said
+    if(i && ranges[i].Start == ranges[i-1].Start && ranges[i].End == ranges[i-1].End)
+      continue;
+
+    UnitIndex.Add(ranges[i].Start,ranges[i].End - ranges[i].Start);
+    UnitOfRange.push_back(ranges[i].Unit);
+  }
+  UnitIndex.Build();
+}
+
+/****************************************************************************/
+
+// Object file (in the target) of the unit a symbol is in, or -1. Data is
+// looked up by variable first: unit ranges only cover code, but the odd
+// one covers everything from its first to its last address.
+sInt ElfFileReader::GetUnitFile(sU64 VA,sBool code) const
+{
+  if(!code)
+  {
+    UnitVariable key = { VA,-1 };
+    sArray<UnitVariable>::const_iterator it = std::lower_bound(Variables.begin(),Variables.end(),key);
+    if(it != Variables.end() && it->VA == VA)
+      return Units[it->Unit]->ObjFile;
+  }
+
+  sInt range = UnitIndex.Find(VA);
+  return (range >= 0) ? Units[UnitOfRange[range]]->ObjFile : -1;
+}
+
+// Object file (in the chunk) for the STT_FILE symbol with that name: the
+// unit with the same base name if there's just one, else the name itself.
+sInt ElfFileReader::GetLocalFile(const sChar *name,SymbolChunk &chunk) const
+{
+  std::map<std::string,sInt>::iterator it = chunk.LocalFiles.find(name);
+  if(it != chunk.LocalFiles.end())
+    return it->second;
+
+  std::map<std::string,sInt>::const_iterator unit = UnitFiles.find(name);
+  sInt file;
+  if(unit != UnitFiles.end() && unit->second >= 0)
+    file = chunk.GetFile(unit->second);
+  else
+    file = chunk.Part.GetFile(chunk.Part.MakeString(name));
+
+  chunk.LocalFiles.insert(std::make_pair(std::string(name),file));
+  return file;
+}
+
+void ElfFileReader::MakeChunks(const DebugInfo &to)
+{
+  sU64 nTarget = ParallelJobs::GetThreadCount() * 4;
+  sU64 chunkSize = SymCount / nTarget + 1;
+  if(chunkSize < 4096)
+    chunkSize = 4096;
+
+  for(sU64 first=0;first<SymCount;first+=chunkSize)
+    Chunks.push_back(new SymbolChunk(first,(SymCount - first > chunkSize) ? first + chunkSize : SymCount,to));
+}
+
+void ElfFileReader::DecodeSymbols(SymbolChunk &chunk)
+{
+  DebugInfo &to = chunk.Part;
+
+  // local symbols come in runs, each after the STT_FILE symbol of its
+  // source file; find the one this chunk starts in
+  sU64 runStart = chunk.First;
+  while(runStart > 0)
+  {
+    const sU8 *sym = SymData + --runStart * SymSize;
+    sU32 info = Is64 ? sym[4] : sym[12];
+    if((info & 0xf) == STT_FILE || (info >> 4) != STB_LOCAL)
+      break;
+  }
+
+  for(sU64 i=runStart;i<chunk.End;i++)
+  {
+    // print a dot for each 1000 symbols processed
+    if(i >= chunk.First && ++chunk.Counter == 1000)
+    {
+      fputc('.',stderr);
+      chunk.Counter = 0;
+    }
+
+    const sU8 *sym = SymData + i * SymSize;
+    sU32 nameOffset = GetU32(sym);
+    sU32 info, shndx;
+    sU64 value, size;
+
+    if(Is64)
+    {
+      info = sym[4];
+      shndx = GetU16(sym + 6);
+      value = GetU64(sym + 8);
+      size = GetU64(sym + 16);
+    }
+    else
+    {
+      value = GetU32(sym + 4);
+      size = GetU32(sym + 8);
+      info = sym[12];
+      shndx = GetU16(sym + 14);
+    }
+
+    sU32 type = info & 0xf;
+    sBool local = (info >> 4) == STB_LOCAL;
+    if(type == STT_FILE || !local)
+    {
+      chunk.LocalFile = -1;
+      if(type == STT_FILE && nameOffset && nameOffset < StrSize && memchr(StrData + nameOffset,0,StrSize - nameOffset))
+        chunk.LocalFile = GetLocalFile(StrData + nameOffset,chunk);
+    }
+
+    if(i < chunk.First)
+      continue; // just looking for the STT_FILE of the run
+
+    if(type != STT_FUNC && type != STT_GNU_IFUNC && type != STT_OBJECT || !size)
+      continue;
+
+    if(shndx == SHN_XINDEX && ShndxData)
+      shndx = GetU32(ShndxData + i * 4);
+    else if(shndx == SHN_UNDEF || shndx >= SHN_LORESERVE)
+      continue; // undefined, absolute or common
+
+    if(shndx >= (sU32) Sections.size())
+      continue;
+
+    const Section &sec = Sections[shndx];
+    if(!(sec.Flags & SHF_ALLOC) || (sec.Flags & SHF_TLS))
+      continue; // not in the image, or a template for each thread
+
+    if(nameOffset >= StrSize || !memchr(StrData + nameOffset,0,StrSize - nameOffset))
+      continue;
+
+    // object file is the compilation unit the address is in
+    sInt objFile = GetUnitFile(value,(sec.Flags & SHF_EXECINSTR) != 0);
+    if(objFile >= 0)
+      objFile = chunk.GetFile(objFile);
+    else if(local && chunk.LocalFile >= 0)
+      objFile = chunk.LocalFile;
+    else
+    {
+      if(chunk.NoObjFile < 0)
+        chunk.NoObjFile = to.GetFileByName("<noobjfile>");
+      objFile = chunk.NoObjFile;
+    }
+
+    const sChar *rawName = StrData + nameOffset;
+    sInt mangledName = to.MakeStringRef(rawName,sGetStringLen(rawName));
+    sInt name = mangledName;
+
+    const sChar *cleanName = chunk.Demangler.Clean(rawName);
+    if(cleanName)
+      name = to.MakeString(cleanName);
+
+    DISymbol outSym;
+    outSym.name = name;
+    outSym.mangledName = mangledName;
+    outSym.objFileNum = objFile;
+    outSym.VA = value;
+    outSym.Size = size;
+    if(sec.Flags & SHF_EXECINSTR)
+      outSym.Class = DIC_CODE;
+    else if(sec.Type == SHT_NOBITS)
+      outSym.Class = DIC_BSS;
+    else
+      outSym.Class = DIC_DATA;
+    outSym.NameSpNum = to.GetNameSpaceOf(name);
+    to.Symbols.push_back(outSym);
+  }
+}
+
+void ElfFileReader::RunJob(sInt index)
+{
+  switch(Jobs)
+  {
+  case JOB_DECOMPRESS:
+    {
+      CompressedSection &sec = Compressed[index];
+      sU8 *dest = DecompressedData + sec.Offset;
+
+      if(sec.Type == ELFCOMPRESS_ZLIB)
+        sec.Ok = DecompressZlib(sec.Src,sec.SrcSize,dest,sec.Size);
+      else if(sec.Type == ELFCOMPRESS_ZSTD)
+        sec.Ok = DecompressZstd(sec.Src,sec.SrcSize,dest,sec.Size);
+    }
+    break;
+
+  case JOB_UNITS:
+    {
+      CompUnit &unit = *Units[index];
+      DecodeUnit(unit);
+      if(unit.Name.empty() && (unit.HasDwoId || !unit.DwoName.empty()))
+        ResolveSplitUnit(unit);
+      else
+      {
+        sArray<sU64> indices;
+        ReadVariables(unit,unit.Variables,indices);
+        ResolveVariables(unit,indices);
+      }
+    }
+    break;
+
+  case JOB_SYMBOLS:
+    DecodeSymbols(*Chunks[index]);
+    break;
+  }
+}
+
+sBool ElfFileReader::ReadEverything(DebugInfo &to)
+{
+  if(!ReadSections() || !FindSymbolTable())
+    return false;
+
+  DecompressSections();
+
+  // compilation units give the object files
+  if(Dwarf[DW_SEC_INFO].Data && Dwarf[DW_SEC_ABBREV].Data)
+  {
+    ReadUnits();
+    ReadAddressRanges();
+  }
+  else
+    fprintf(stderr,"  no DWARF debug info, symbols won't have object files\n");
+
+  BuildUnitIndex(to);
+
+  // decode symbols in parallel, then merge in order
+  MakeChunks(to);
+  Jobs = JOB_SYMBOLS;
+  ParallelJobs::Run(Chunks.size());
+
+  for(sInt i=0;i<Chunks.size();i++)
+  {
+    to.MergePart(Chunks[i]->Part);
+    delete Chunks[i];
+  }
+
+  Chunks.clear();
+  return true;
+}
+
+sBool ElfFileReader::Open(const sChar *fileName)
+{
+  Close();
+
+  MappedFile *file = new MappedFile;
+  if(!file->Open(fileName))
+  {
+    delete file;
+    return false;
+  }
+
+  File = file;
+  FileName = fileName;
+  Data = file->GetData();
+  Size = file->GetSize();
+  memset(Dwarf,0,sizeof(Dwarf));
+  return true;
+}
+
+void ElfFileReader::Close()
+{
+  for(sInt i=0;i<Units.size();i++)
+    delete Units[i];
+
+  delete Package;
+  Package = 0;
+
+  Units.clear();
+  Sections.clear();
+  Compressed.clear();
+  free(DecompressedData);
+  DecompressedData = 0;
+  UnitIndex.Clear();
+  sArray<sInt>().swap(UnitOfRange);
+  sArray<UnitVariable>().swap(Variables);
+  UnitFiles.clear();
+  SymData = 0;
+  StrData = 0;
+  ShndxData = 0;
+  delete File;
+  File = 0;
+  Data = 0;
+  Size = 0;
+}
+
+// a .dwo file or .dwp package; just the sections needed for FindSplitUnit
+sBool ElfFileReader::OpenSplitDwarf(const sChar *fileName)
+{
+  SplitDwarf = true;
+  if(!Open(fileName) || !ReadSections())
+    return false;
+
+  DecompressSections();
+  return Dwarf[DW_SEC_INFO].Data && Dwarf[DW_SEC_ABBREV].Data;
+}
+
+sBool ElfFileReader::ReadDebugInfo(sChar *fileName,DebugInfo &to)
+{
+  if(!Open(fileName))
+  {
+    fprintf(stderr,"  failed to open %s\n",fileName);
+    return false;
+  }
+
+  sBool readOk = ReadEverything(to);
+
+  // names point into the mapping, so it has to live as long as "to"
+  to.AddSource(File);
+  File = 0;
+  Close();
+
+  return readOk;
+}
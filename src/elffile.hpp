@@ -0,0 +1,151 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __ELFFILE_HPP__
+#define __ELFFILE_HPP__
+
+#include "types.hpp"
+#include "debuginfo.hpp"
+#include "parallel.hpp"
+#include "addressindex.hpp"
+#include <map>
+#include <string>
+
+/****************************************************************************/
+
+class MappedFile;
+
+// Reads symbols of ELF executables and shared objects (32/64 bit, little
+// endian) from .symtab, or .dynsym if the file is stripped. Symbol classes
+// come from the flags of the section a symbol is in. Object files are the
+// DWARF compilation units: their address ranges come from .debug_aranges
+// and the ranges of each unit's root DIE, so a symbol belongs to the unit
+// whose code or data it is in, the same as a section contribution in a PDB.
+// With split DWARF, the skeleton units only have the ranges; their names
+// come from the .dwp package next to the file (found through its unit
+// index) or from the .dwo files themselves. Unit ranges only cover code;
+// data and BSS symbols go to the unit with a DW_TAG_variable at their
+// address. Local symbols that neither finds belong to the file named by
+// the STT_FILE symbol of their run in the symbol table.
+// Compilation units and symbols are both decoded on all cores.
+//
+// Compressed debug sections (SHF_COMPRESSED with zlib or zstd, and the
+// older .zdebug_* ones) are inflated first, each section on its own core,
+// into one block that's freed when reading is done. Only the sections
+// listed in DwarfSectionId are touched; line tables and such never are.
+
+class ElfFileReader : public DebugInfoReader, private ParallelJobs
+{
+  struct Section;
+  struct CompressedSection;
+  struct CompUnit;
+  struct SymbolChunk;
+
+  struct SectionData
+  {
+    const sU8 *Data;
+    sU64 Size;
+  };
+
+  struct UnitVariable
+  {
+    sU64 VA;
+    sInt Unit;
+
+    bool operator <(const UnitVariable &b) const  { return VA < b.VA || VA == b.VA && Unit < b.Unit; }
+  };
+
+  enum DwarfSectionId
+  {
+    DW_SEC_INFO,
+    DW_SEC_ABBREV,
+    DW_SEC_ARANGES,
+    DW_SEC_STR,
+    DW_SEC_LINE_STR,
+    DW_SEC_STR_OFFSETS,
+    DW_SEC_ADDR,
+    DW_SEC_RANGES,
+    DW_SEC_RNGLISTS,
+    DW_SEC_CU_INDEX,                // .dwp packages only
+    DW_SEC_COUNT
+  };
+
+  enum JobType
+  {
+    JOB_DECOMPRESS,
+    JOB_UNITS,
+    JOB_SYMBOLS
+  };
+
+  MappedFile *File;
+  std::string FileName;
+  const sU8 *Data;
+  sU64 Size;
+  sBool Is64;
+
+  sArray<Section> Sections;
+  SectionData Dwarf[DW_SEC_COUNT];
+  sArray<CompressedSection> Compressed;
+  sU8 *DecompressedData;            // all compressed sections, one block
+
+  sArray<CompUnit *> Units;         // by offset in .debug_info
+  AddressIndex UnitIndex;           // address ranges of the units
+  sArray<sInt> UnitOfRange;         // UnitIndex id -> unit
+  sArray<UnitVariable> Variables;   // by address
+  std::map<std::string,sInt> UnitFiles; // object file by unit base name, -1 if not unique
+
+  // symbol table
+  const sU8 *SymData;
+  sU64 SymCount;
+  sU32 SymSize;
+  const sChar *StrData;
+  sU64 StrSize;
+  const sU8 *ShndxData;             // SHT_SYMTAB_SHNDX, if any
+  sArray<SymbolChunk *> Chunks;
+
+  JobType Jobs;                     // what RunJob does
+
+  sBool SplitDwarf;                 // reading a .dwo or .dwp file
+  ElfFileReader *Package;           // the .dwp next to the file, if any
+
+  sBool Open(const sChar *fileName);
+  void Close();
+  sBool OpenSplitDwarf(const sChar *fileName);
+
+  sBool ReadSections();
+  sBool FindSymbolTable();
+  sBool GetSectionData(sInt index,SectionData &out);
+  void AddCompressedSection(sInt index,sInt dwarfId,sBool gnuStyle);
+  void DecompressSections();
+
+  sBool ReadUnitHeader(sU64 offset,CompUnit &unit,sU64 &next) const;
+  void ReadUnits();
+  void DecodeUnit(CompUnit &unit);
+  void ReadVariables(const CompUnit &unit,sArray<sU64> &addrs,sArray<sU64> &indices) const;
+  void ResolveVariables(CompUnit &unit,const sArray<sU64> &indices);
+  void ResolveSplitUnit(CompUnit &unit);
+  sBool FindSplitUnit(sU64 dwoId,CompUnit &unit) const;
+  void ReadAddressRanges();
+  sU64 GetIndexedAddress(const CompUnit &unit,sU64 index) const;
+  void ReadRangeList(const CompUnit &unit,sU64 offset,sU64 base,sBool rnglists,sArray<sU64> &ranges);
+  void BuildUnitIndex(DebugInfo &to);
+
+  sInt GetUnitFile(sU64 VA,sBool code) const;
+  sInt GetLocalFile(const sChar *name,SymbolChunk &chunk) const;
+  void MakeChunks(const DebugInfo &to);
+  void DecodeSymbols(SymbolChunk &chunk);
+  void RunJob(sInt index);
+  sBool ReadEverything(DebugInfo &to);
+
+public:
+  ElfFileReader();
+  ~ElfFileReader();
+
+  static sBool IsElf(const sChar *fileName);
+  sBool ReadDebugInfo(sChar *fileName,DebugInfo &to);
+};
+
+/****************************************************************************/
+
+#endif
@@ -4,7 +4,10 @@
 #include <assert.h>
 #include <math.h>
 #include <stdarg.h>
+#include <time.h>
 #include <vector>
+#include <string>
+#include <algorithm>
 
 #if defined(WIN32)
 #include <direct.h>
@@ -18,6 +21,7 @@
 #pragma warning(disable:4996 4702) // Disable Microsof'ts freaking idiotic 'warnings' not to use standard ANSI C stdlib and string functions!
 
 #include "htmltable.h"
+#include "sutil.h"
 
 #if defined(LINUX)
 #define stricmp(a,b) strcasecmp(a,b)
@@ -618,7 +622,10 @@ size_t        fi_fprintf(FILE_INTERFACE *fph,const char *fmt,...)
 
 	char buffer[2048];
   buffer[2047] = 0;
-	_vsnprintf(buffer,2047, fmt, (char *)(&fmt+1));
+  va_list arg;
+  va_start(arg,fmt);
+	_vsnprintf(buffer,2047, fmt, arg);
+  va_end(arg);
 
 	if ( fph )
 	{
@@ -1231,17 +1238,17 @@ static bool numeric(char c)
   return ret;
 }
 
-static bool isNumeric(const std::string &str)
+static bool isNumeric(const char *str)
 {
   bool ret = true;
 
-  if ( str.size() == 0 )
+  if ( *str == 0 )
   {
     ret = false;
   }
   else
   {
-    const char *scan = str.c_str();
+    const char *scan = str;
 	if ( *scan == '-' ) scan++;
     while ( *scan )
     {
@@ -1256,46 +1263,6 @@ static bool isNumeric(const std::string &str)
   return ret;
 }
 
-#define MAXNUMERIC 32  // JWR  support up to 16 32 character long numeric formated strings
-#define MAXFNUM    16
-
-static	char  gFormat[MAXNUMERIC*MAXFNUM];
-static int    gIndex=0;
-
-const char * formatNumber(int number) // JWR  format this integer into a fancy comma delimited string
-{
-	char * dest = &gFormat[gIndex*MAXNUMERIC];
-	gIndex++;
-	if ( gIndex == MAXFNUM ) gIndex = 0;
-
-	char scratch[512];
-
-#if defined (LINUX_GENERIC) || defined(LINUX) || defined (__CELLOS_LV2__)
-	snprintf(scratch, 10, "%d", number);
-#else
-	itoa(number,scratch,10);
-#endif
-
-	char *source = scratch;
-	char *str = dest;
-	unsigned int len = (unsigned int)strlen(scratch);
-	if ( scratch[0] == '-' )
-	{
-		*str++ = '-';
-		source++;
-		len--;
-	}
-	for (unsigned int i=0; i<len; i++)
-	{
-		int place = (len-1)-i;
-		*str++ = source[i];
-		if ( place && (place%3) == 0 ) *str++ = ',';
-	}
-	*str = 0;
-
-	return dest;
-}
-
 void stripFraction(char *fraction)
 {
   size_t len = strlen(fraction);
@@ -1337,7 +1304,7 @@ float getFloatValue(const char *data)
 
 void getFloat(float v,std::string &ret)
 {
-  int ivalue = (int)v;
+  long long ivalue = (long long)v;
 
   if ( v == 0 )
   {
@@ -1366,7 +1333,7 @@ void getFloat(float v,std::string &ret)
       v = 0;
 
 
-    const char *temp = formatNumber(ivalue);
+    const char *temp = NVSHARE::formatNumber(ivalue);
     if ( v != 0 )
     {
       char fraction[512];
@@ -1414,9 +1381,178 @@ public:
 
 typedef std::vector< SortRequest > SortRequestVector;
 
-typedef std::vector< std::string >  StringVector;
 typedef std::vector< size_t > SizetVector;
 
+// All cell strings of a table live in one arena; a cell refers to its text by offset.
+class HtmlStringTable
+{
+public:
+  unsigned int add(const char *str)
+  {
+    size_t len = strlen(str);
+    unsigned int ret = (unsigned int)mData.size();
+    mData.insert(mData.end(),str,str+len+1);
+    return ret;
+  }
+
+  const char * get(unsigned int offset) const
+  {
+    return &mData[offset];
+  }
+
+  void clear(void)
+  {
+    mData.clear();
+  }
+
+private:
+  std::vector< char > mData;
+};
+
+enum HtmlCellType
+{
+  HCT_STRING,
+  HCT_INTEGER,
+  HCT_FLOAT
+};
+
+// A cell is parsed once when it is added; the display text of numeric cells is only produced when saving.
+class HtmlCell
+{
+public:
+  void setString(const char *data,HtmlStringTable &strings)
+  {
+    mType = HCT_STRING;
+    mString = strings.add(data);
+  }
+
+  void setInteger(long long v)
+  {
+    mType = HCT_INTEGER;
+    mInteger = v;
+  }
+
+  void setFloat(float v)
+  {
+    mType = HCT_FLOAT;
+    mFloat = v;
+  }
+
+  void parse(const char *data,HtmlStringTable &strings)
+  {
+    if ( isNumeric(data) )
+    {
+      const char *scan = data;
+      bool negative = false;
+      if ( *scan == '-' )
+      {
+        negative = true;
+        scan++;
+      }
+
+      long long v = 0;
+      int digits = 0;
+      while ( *scan && digits < 18 )
+      {
+        char c = *scan;
+        if ( c >= '0' && c <= '9' )
+        {
+          v = v*10 + (c-'0');
+          digits++;
+        }
+        else if ( c != ',' )
+        {
+          break;
+        }
+        scan++;
+      }
+
+      if ( *scan == 0 )
+        setInteger(negative ? -v : v);
+      else
+        setFloat(getFloatValue(data));
+    }
+    else
+    {
+      setString(data,strings);
+    }
+  }
+
+  HtmlCellType getType(void) const { return mType; };
+  bool isNumber(void) const { return mType != HCT_STRING; };
+  long long getInteger(void) const { return mInteger; };
+
+  double getValue(void) const
+  {
+    return mType == HCT_INTEGER ? (double)mInteger : (double)mFloat;
+  }
+
+  void getText(const HtmlStringTable &strings,std::string &str) const
+  {
+    switch ( mType )
+    {
+      case HCT_STRING:
+        str = strings.get(mString);
+        break;
+      case HCT_INTEGER:
+        str = NVSHARE::formatNumber(mInteger);
+        break;
+      case HCT_FLOAT:
+        getFloat(mFloat,str);
+        break;
+    }
+  }
+
+  static int compare(const HtmlCell *c1,const HtmlCell *c2,const HtmlStringTable &strings)
+  {
+    int ret;
+
+    if ( c1 && c2 && c1->isNumber() && c2->isNumber() )
+    {
+      if ( c1->mType == HCT_INTEGER && c2->mType == HCT_INTEGER )
+      {
+        ret = c1->mInteger < c2->mInteger ? -1 : c1->mInteger > c2->mInteger ? 1 : 0;
+      }
+      else
+      {
+        double v1 = c1->getValue();
+        double v2 = c2->getValue();
+        ret = v1 < v2 ? -1 : v1 > v2 ? 1 : 0;
+      }
+    }
+    else if ( c1 && c2 && c1->mType == HCT_STRING && c2->mType == HCT_STRING )
+    {
+      ret = stricmp(strings.get(c1->mString),strings.get(c2->mString));
+    }
+    else // a missing cell or a number against a string; compare the display text
+    {
+      std::string p1;
+      std::string p2;
+      if ( c1 ) c1->getText(strings,p1);
+      if ( c2 ) c2->getText(strings,p2);
+      ret = stricmp(p1.c_str(),p2.c_str());
+    }
+
+    if ( ret < 0 )
+      ret = -1;
+    else if ( ret > 0 )
+      ret = 1;
+
+    return ret;
+  }
+
+private:
+  HtmlCellType  mType;
+  union
+  {
+    long long     mInteger;
+    float         mFloat;
+    unsigned int  mString;
+  };
+};
+
+typedef std::vector< HtmlCell > HtmlCellVector;
+
 class HtmlRow
 {
 public:
@@ -1448,7 +1584,7 @@ public:
     mRow.clear();
   }
 
-  void addCSV(const char *data,InPlaceParser &parser)
+  void addCSV(const char *data,InPlaceParser &parser,HtmlStringTable &strings)
   {
     if ( data )
     {
@@ -1466,7 +1602,7 @@ public:
             const char *arg = args[i];
             if ( arg[0] != ',' )
             {
-              addColumn(arg);
+              addColumn(arg,strings);
             }
           }
         }
@@ -1475,21 +1611,44 @@ public:
     }
   }
 
-  void addColumn(const char *data)
+  void addColumn(const char *data,HtmlStringTable &strings)
   {
     if ( data )
     {
-		std::string str = data;
-      if ( isNumeric(data) )
-      {
-        float v = getFloatValue(data);
-        getFloat(v,str);
-      }
-      mRow.push_back(str);
+      HtmlCell cell;
+      cell.parse(data,strings);
+      mRow.push_back(cell);
     }
   }
 
-  void columnSizes(SizetVector &csizes)
+  void addInteger(long long v)
+  {
+    HtmlCell cell;
+    cell.setInteger(v);
+    mRow.push_back(cell);
+  }
+
+  void addFloat(float v)
+  {
+    HtmlCell cell;
+    cell.setFloat(v);
+    mRow.push_back(cell);
+  }
+
+  size_t getColumnCount(void) const { return mRow.size(); };
+
+  const HtmlCell * getCell(size_t index) const
+  {
+    return index < mRow.size() ? &mRow[index] : 0;
+  }
+
+  bool isNumeric(size_t index) const
+  {
+    const HtmlCell *cell = getCell(index);
+    return cell && cell->isNumber();
+  }
+
+  void columnSizes(SizetVector &csizes,const HtmlStringTable &strings)
   {
     size_t ccount = csizes.size();
     size_t count  = mRow.size();
@@ -1497,20 +1656,22 @@ public:
     {
       csizes.push_back(0);
     }
+    std::string str;
     for (size_t i=0; i<count; i++)
     {
-      if ( mRow[i].size() > csizes[i] )
+      mRow[i].getText(strings,str);
+      if ( str.size() > csizes[i] )
       {
-        csizes[i] = mRow[i].size();
+        csizes[i] = str.size();
       }
     }
   }
 
-  void getString(size_t index,std::string &str) const
+  void getString(size_t index,std::string &str,const HtmlStringTable &strings) const
   {
-    if ( index >= 0 && index < mRow.size() )
+    if ( index < mRow.size() )
     {
-      str = mRow[index];
+      mRow[index].getText(strings,str);
     }
     else
     {
@@ -1518,20 +1679,22 @@ public:
     }
   }
 
-  void htmlRow(FILE_INTERFACE *fph,HtmlTable *table)
+  void htmlRow(FILE_INTERFACE *fph,HtmlTable *table,const HtmlStringTable &strings)
   {
     {
       fi_fprintf(fph,"<TR>");
 
       unsigned int column = 1;
 
-      StringVector::iterator i;
+      std::string text;
+      HtmlCellVector::iterator i;
       for (i=mRow.begin(); i!=mRow.end(); ++i)
       {
 
         unsigned int color = table->getColor(column,mHeader,mFooter);
 
-        const char *str = (*i).c_str();
+        (*i).getText(strings,text);
+        const char *str = text.c_str();
 
         if ( mHeader )
         {
@@ -1539,7 +1702,7 @@ public:
         }
         else if ( mFooter )
         {
-          if ( isNumeric(str))
+          if ( (*i).isNumber() )
           {
             fi_fprintf(fph,"<TH bgcolor=\"#%06X\" align=\"right\"> %s</TH>", color, str );
           }
@@ -1550,7 +1713,7 @@ public:
         }
         else
         {
-          if ( isNumeric(str))
+          if ( (*i).isNumber() )
           {
             fi_fprintf(fph,"<TD bgcolor=\"#%06X\" align=\"right\"> %s</TD>", color, str );
           }
@@ -1567,20 +1730,22 @@ public:
     }
   }
 
-  void saveExcel(FILE *fph,HtmlTable *table)
+  void saveExcel(FILE *fph,HtmlTable *table,const HtmlStringTable &strings)
   {
     {
       fprintf(fph,"<TR>");
 
       unsigned int column = 1;
 
-      StringVector::iterator i;
+      std::string text;
+      HtmlCellVector::iterator i;
       for (i=mRow.begin(); i!=mRow.end(); ++i)
       {
 
         unsigned int color = table->getColor(column,mHeader,mFooter);
 
-        const char *str = (*i).c_str();
+        (*i).getText(strings,text);
+        const char *str = text.c_str();
 
         if ( mHeader )
         {
@@ -1588,7 +1753,7 @@ public:
         }
         else if ( mFooter )
         {
-          if ( isNumeric(str))
+          if ( (*i).isNumber() )
           {
             fprintf(fph,"<TH bgcolor=\"#%06X\" align=\"right\"> %s</TH>", color, str );
           }
@@ -1599,7 +1764,7 @@ public:
         }
         else
         {
-          if ( isNumeric(str))
+          if ( (*i).isNumber() )
           {
             fprintf(fph,"<TD bgcolor=\"#%06X\" align=\"right\"> %s</TD>", color, str );
           }
@@ -1616,13 +1781,14 @@ public:
     }
   }
 
-  void saveCSV(FILE_INTERFACE *fph)
+  void saveCSV(FILE_INTERFACE *fph,const HtmlStringTable &strings)
   {
+    std::string text;
     size_t count = mRow.size();
     for (size_t i=0; i<count; i++)
     {
-      const char *data = mRow[i].c_str();
-      fi_fprintf(fph,"\"%s\"", data );
+      mRow[i].getText(strings,text);
+      fi_fprintf(fph,"\"%s\"", text.c_str() );
       if ( (i+1) < count )
       {
         fi_fprintf(fph,",");
@@ -1631,7 +1797,7 @@ public:
     fi_fprintf(fph,"\r\n");
   }
 
-  void saveCPP(FILE_INTERFACE *fph)
+  void saveCPP(FILE_INTERFACE *fph,const HtmlStringTable &strings)
   {
     if ( mHeader )
     {
@@ -1642,10 +1808,12 @@ public:
       fi_fprintf(fph,"    table->addCSV(%c%c%c%c,%c", 34, '%', 's', 34, 34, 34 );
     }
 
+    std::string text;
     size_t count = mRow.size();
     for (size_t i=0; i<count; i++)
     {
-      const char *data = mRow[i].c_str();
+      mRow[i].getText(strings,text);
+      const char *data = text.c_str();
 
       bool needQuote = false;
       bool isNumeric = true;
@@ -1681,7 +1849,7 @@ public:
 
       if ( isNumeric )
       {
-        const char *data = mRow[i].c_str();
+        const char *data = text.c_str();
         str.clear();
         while ( *data )
         {
@@ -1708,91 +1876,292 @@ public:
     fi_fprintf(fph,"%c);\r\n",34);
   }
 
-  int compare(const HtmlRow &r,const SortRequest &s)
+private:
+  bool            mHeader:1;
+  bool            mFooter:1;
+  HtmlCellVector  mRow;
+};
+
+typedef std::vector< HtmlRow * > HtmlRowVector;
+
+// Orders the body rows of a table for one SortRequest.  Both sort keys are pulled out of the rows
+// once into a contiguous array.  A column that holds only numbers is encoded as an order preserving
+// unsigned 64 bit key (descending columns are inverted), so the common case of sorting by sizes and
+// counts is an LSD radix sort.  Any other column falls back to a comparison sort on the extracted
+// cells.  Ties keep the original row order either way.
+class HtmlRowSorter
+{
+public:
+  void sort(HtmlRow **rows,size_t count,const SortRequest &sr,const HtmlStringTable &strings)
   {
-    int ret = 0;
+    mKeys.resize(count);
+    for (size_t i=0; i<count; i++)
+    {
+      HtmlSortKey &key = mKeys[i];
+      key.mPrimaryCell   = rows[i]->getCell(sr.mPrimaryKey-1);
+      key.mSecondaryCell = rows[i]->getCell(sr.mSecondaryKey-1);
+      key.mRow           = (unsigned int)i;
+    }
 
-	std::string p1;  // primary 1
-	std::string p2;  // primary 2
+    bool primaryNumeric   = encode(&HtmlSortKey::mPrimaryCell,&HtmlSortKey::mPrimary,sr.mPrimaryAscending);
+    bool secondaryNumeric = encode(&HtmlSortKey::mSecondaryCell,&HtmlSortKey::mSecondary,sr.mSecondaryAscending);
 
+    if ( primaryNumeric && secondaryNumeric )
+    {
+      radixSort(&HtmlSortKey::mSecondary);
+      radixSort(&HtmlSortKey::mPrimary);
+    }
+    else
+    {
+      KeyLess less(sr,primaryNumeric,secondaryNumeric,strings);
+      std::sort(mKeys.begin(),mKeys.end(),less);
+    }
 
-    getString(s.mPrimaryKey-1,p1);
+    mRows.resize(count);
+    for (size_t i=0; i<count; i++)
+    {
+      mRows[i] = rows[mKeys[i].mRow];
+    }
+    for (size_t i=0; i<count; i++)
+    {
+      rows[i] = mRows[i];
+    }
+  }
 
-    r.getString(s.mPrimaryKey-1,p2);
+private:
+  struct HtmlSortKey
+  {
+    unsigned long long  mPrimary;
+    unsigned long long  mSecondary;
+    const HtmlCell     *mPrimaryCell;
+    const HtmlCell     *mSecondaryCell;
+    unsigned int        mRow;
+  };
 
-    if (isNumeric(p1) && isNumeric(p2) )
+  typedef std::vector< HtmlSortKey > HtmlSortKeyVector;
+
+  class KeyLess
+  {
+  public:
+    KeyLess(const SortRequest &sr,bool primaryNumeric,bool secondaryNumeric,const HtmlStringTable &strings) : mStrings(strings)
     {
-      float v1 = getFloatValue(p1.c_str());
-      float v2 = getFloatValue(p2.c_str());
-      if ( v1 < v2 )
-        ret = -1;
-      else if ( v1 > v2 )
-        ret = 1;
+      mPrimaryNumeric     = primaryNumeric;
+      mSecondaryNumeric   = secondaryNumeric;
+      mPrimaryAscending   = sr.mPrimaryAscending;
+      mSecondaryAscending = sr.mSecondaryAscending;
     }
-    else
+
+    bool operator()(const HtmlSortKey &a,const HtmlSortKey &b) const
     {
-      ret = stricmp(p1.c_str(),p2.c_str());
+      int ret;
+      if ( mPrimaryNumeric )
+        ret = a.mPrimary < b.mPrimary ? -1 : a.mPrimary > b.mPrimary ? 1 : 0;
+      else
+        ret = HtmlCell::compare(a.mPrimaryCell,b.mPrimaryCell,mStrings) * (mPrimaryAscending ? 1 : -1);
+
+      if ( ret == 0 )
+      {
+        if ( mSecondaryNumeric )
+          ret = a.mSecondary < b.mSecondary ? -1 : a.mSecondary > b.mSecondary ? 1 : 0;
+        else
+          ret = HtmlCell::compare(a.mSecondaryCell,b.mSecondaryCell,mStrings) * (mSecondaryAscending ? 1 : -1);
+      }
 
-      if ( ret < 0 )
-        ret = -1;
-      else if ( ret > 0 )
-        ret = 1;
+      if ( ret == 0 )
+        return a.mRow < b.mRow;
 
+      return ret < 0;
     }
 
-    if ( !s.mPrimaryAscending )
+  private:
+    const HtmlStringTable &mStrings;
+    bool                   mPrimaryNumeric:1;
+    bool                   mSecondaryNumeric:1;
+    bool                   mPrimaryAscending:1;
+    bool                   mSecondaryAscending:1;
+  };
+
+  // Fills in the numeric key for one column; returns false if any row has a non numeric (or no) cell there.
+  bool encode(const HtmlCell *HtmlSortKey::*cell,unsigned long long HtmlSortKey::*key,bool ascending)
+  {
+    bool integers = true;
+    HtmlSortKeyVector::iterator i;
+    for (i=mKeys.begin(); i!=mKeys.end(); ++i)
     {
-      ret*=-1;
+      const HtmlCell *c = (*i).*cell;
+      if ( c == 0 || !c->isNumber() )
+        return false;
+      if ( c->getType() != HCT_INTEGER )
+        integers = false;
     }
 
-    if ( ret == 0 )
+    for (i=mKeys.begin(); i!=mKeys.end(); ++i)
     {
-		std::string p1;  // secondary 1
-		std::string p2;  // secondary 2
-      getString(s.mSecondaryKey-1,p1);
-      r.getString(s.mSecondaryKey-1,p2);
-      if (isNumeric(p1) && isNumeric(p2) )
+      const HtmlCell *c = (*i).*cell;
+      unsigned long long v;
+      if ( integers )
       {
-        float v1 = getFloatValue(p1.c_str());
-        float v2 = getFloatValue(p2.c_str());
-        if ( v1 < v2 )
-          ret = -1;
-        else if ( v1 > v2 )
-          ret = 1;
+        v = (unsigned long long)c->getInteger() ^ 0x8000000000000000ULL;
       }
       else
       {
-        ret = stricmp(p1.c_str(),p2.c_str());
+        double d = c->getValue();
+        if ( d == 0 )
+          d = 0; // fold -0 into +0
+        memcpy(&v,&d,sizeof(v));
+        v = (v & 0x8000000000000000ULL) ? ~v : (v | 0x8000000000000000ULL);
+      }
+      (*i).*key = ascending ? v : ~v;
+    }
+    return true;
+  }
 
-        if ( ret < 0 )
-          ret = -1;
-        else if ( ret > 0 )
-          ret = 1;
+  // Stable LSD radix sort on one key, a byte per pass; passes where every key has the same byte are skipped.
+  void radixSort(unsigned long long HtmlSortKey::*key)
+  {
+    size_t count = mKeys.size();
+    if ( count < 2 )
+      return;
 
+    size_t histogram[8][256];
+    memset(histogram,0,sizeof(histogram));
+    for (size_t i=0; i<count; i++)
+    {
+      unsigned long long v = mKeys[i].*key;
+      for (int b=0; b<8; b++)
+      {
+        histogram[b][(v >> (b*8)) & 255]++;
       }
+    }
 
-      if ( !s.mSecondaryAscending )
+    mScratch.resize(count);
+    for (int b=0; b<8; b++)
+    {
+      size_t *h = histogram[b];
+      if ( h[(mKeys[0].*key >> (b*8)) & 255] == count )
+        continue;
+
+      size_t offset = 0;
+      for (int d=0; d<256; d++)
       {
-        ret*=-1;
+        size_t n = h[d];
+        h[d] = offset;
+        offset+=n;
       }
-
+      for (size_t i=0; i<count; i++)
+      {
+        const HtmlSortKey &k = mKeys[i];
+        mScratch[h[(k.*key >> (b*8)) & 255]++] = k;
+      }
+      mKeys.swap(mScratch);
     }
+  }
 
+  HtmlSortKeyVector        mKeys;
+  HtmlSortKeyVector        mScratch;
+  std::vector< HtmlRow * > mRows;
+};
+
+// How rows were sorted before HtmlRowSorter, a virtual compare() through both row pointers per
+// comparison.  Only kept to measure against, see sortBenchmark.
+class QuickSortRows : public QuickSortPointers
+{
+public:
+  QuickSortRows(const SortRequest &sr,const HtmlStringTable &strings) : mSortRequest(sr), mStrings(strings)
+  {
+  }
+
+  void sort(HtmlRow **rows,size_t count)
+  {
+    qsort((void **)rows,(int)count);
+  }
+
+protected:
+  int compare(void **p1,void **p2)
+  {
+    const HtmlRow *row1 = *(HtmlRow **)p1;
+    const HtmlRow *row2 = *(HtmlRow **)p2;
+    const SortRequest &s = mSortRequest;
+
+    int ret = HtmlCell::compare(row1->getCell(s.mPrimaryKey-1),row2->getCell(s.mPrimaryKey-1),mStrings);
+    if ( !s.mPrimaryAscending )
+      ret*=-1;
+    if ( ret == 0 )
+    {
+      ret = HtmlCell::compare(row1->getCell(s.mSecondaryKey-1),row2->getCell(s.mSecondaryKey-1),mStrings);
+      if ( !s.mSecondaryAscending )
+        ret*=-1;
+    }
     return ret;
   }
 
 private:
-  bool          mHeader:1;
-  bool          mFooter:1;
-  StringVector  mRow;
+  const SortRequest     &mSortRequest;
+  const HtmlStringTable &mStrings;
 };
 
-typedef std::vector< HtmlRow * > HtmlRowVector;
 
+// The rows of a table in display order for one sort request, followed by its totals row if there is one.
+class HtmlSortedBody
+{
+public:
+  HtmlSortedBody(void)
+  {
+    mValid  = false;
+    mTotals = 0;
+  }
+
+  bool           mValid;
+  HtmlRowVector  mRows;
+  HtmlRow       *mTotals;
+};
+
+typedef std::vector< HtmlSortedBody > HtmlSortedBodyVector;
+
+// Running total of one column, updated as body rows are added.  Integers are summed exactly; the total
+// only becomes a float if the column holds a float cell.
+class HtmlColumnTotal
+{
+public:
+  HtmlColumnTotal(void)
+  {
+    mInteger  = 0;
+    mFloat    = 0;
+    mHasFloat = false;
+  }
+
+  void add(const HtmlCell &cell)
+  {
+    if ( cell.getType() == HCT_INTEGER )
+    {
+      mInteger+=cell.getInteger();
+    }
+    else if ( cell.getType() == HCT_FLOAT )
+    {
+      mFloat+=cell.getValue();
+      mHasFloat = true;
+    }
+  }
+
+  void addTo(HtmlRow &row) const
+  {
+    if ( mHasFloat )
+      row.addFloat((float)(mFloat+(double)mInteger));
+    else
+      row.addInteger(mInteger);
+  }
+
+private:
+  long long mInteger;
+  double    mFloat;
+  bool      mHasFloat;
+};
+
+typedef std::vector< HtmlColumnTotal > HtmlColumnTotalVector;
 
 static int gTableCount=0;
 
-class _HtmlTable : public HtmlTable, public QuickSortPointers
+class _HtmlTable : public HtmlTable
 {
 public:
   _HtmlTable(const char *heading,HtmlDocument *parent);
@@ -1808,23 +2177,6 @@ public:
   unsigned int getDisplayOrder(void) const { return mDisplayOrder; };
 
 
-	int compare(void **p1,void **p2)
-  {
-    HtmlRow **r1 = (HtmlRow **)p1;
-    HtmlRow **r2 = (HtmlRow **)p2;
-
-    HtmlRow *row1 = r1[0];
-    HtmlRow *row2 = r2[0];
-
-    assert( !row1->isHeader() );
-    assert( !row1->isFooter() );
-
-    assert( !row2->isHeader() );
-    assert( !row2->isFooter() );
-
-    return row1->compare(*row2,mSortRequest);
-  }
-
   void BorderASCII(void)
   {
     UPPER_LEFT_BORDER = '/';
@@ -1872,8 +2224,55 @@ public:
       HTML_DELETE(HtmlRow,row);
     }
     mBody.clear();
+    mStrings.clear();
+    mColumnTotals.clear();
     mExcludeTotals.clear();
     mCurrent = 0;
+    invalidateSorted();
+  }
+
+  // Drops the cached sort orders and totals; called whenever rows or the sort/totals settings change.
+  void invalidateSorted(void)
+  {
+    HtmlSortedBodyVector::iterator i;
+    for (i=mSorted.begin(); i!=mSorted.end(); ++i)
+    {
+      HtmlRow *totals = (*i).mTotals;
+      if ( totals )
+      {
+        HTML_DELETE(HtmlRow,totals);
+      }
+    }
+    mSorted.clear();
+  }
+
+  // Rows for sort request 'index' (mSortRequests.size() for insertion order), sorted and totalled on first use.
+  const HtmlRowVector & getSortedBody(size_t index)
+  {
+    if ( mSorted.empty() )
+    {
+      mSorted.resize(mSortRequests.size()+1);
+    }
+
+    HtmlSortedBody &sb = mSorted[index];
+    if ( !sb.mValid )
+    {
+      sb.mRows = mBody;
+      if ( index < mSortRequests.size() )
+      {
+        sortBody(sb.mRows,mSortRequests[index]);
+      }
+      if ( mComputeTotals )
+      {
+        sb.mTotals = createTotalsRow(sb.mRows);
+        if ( sb.mTotals )
+        {
+          sb.mRows.push_back(sb.mTotals);
+        }
+      }
+      sb.mValid = true;
+    }
+    return sb.mRows;
   }
 
   void addString(std::string &str,const char *data)
@@ -1891,7 +2290,10 @@ public:
   {
     char data[8192];
     data[8191] = 0;
-  	_vsnprintf(data,8191, fmt, (char *)(&fmt+1));
+    va_list arg;
+    va_start(arg,fmt);
+  	_vsnprintf(data,8191, fmt, arg);
+    va_end(arg);
 
     mParser.ClearHardSeparator(32);
     mParser.ClearHardSeparator(9);
@@ -1959,7 +2361,8 @@ public:
 
         getCurrent();
         mCurrent->setHeader(true);
-        mCurrent->addCSV(header1.c_str(),mParser);
+        mCurrent->addCSV(header1.c_str(),mParser,mStrings);
+        accumulate(0);
         nextRow();
 
         if ( strstr(header2.c_str(),"/") )
@@ -1970,7 +2373,8 @@ public:
         {
           getCurrent();
           mCurrent->setHeader(true);
-          mCurrent->addCSV(header2.c_str(),mParser);
+          mCurrent->addCSV(header2.c_str(),mParser,mStrings);
+          accumulate(0);
           nextRow();
           break;
         }
@@ -1981,7 +2385,8 @@ public:
     {
       getCurrent();
       mCurrent->setHeader(true);
-      mCurrent->addCSV(data,mParser);
+      mCurrent->addCSV(data,mParser,mStrings);
+      accumulate(0);
       nextRow();
     }
   }
@@ -1989,14 +2394,17 @@ public:
   void addColumn(const char *data)
   {
     getCurrent();
-    mCurrent->addColumn(data);
+    size_t first = mCurrent->getColumnCount();
+    mCurrent->addColumn(data,mStrings);
+    accumulate(first);
   }
 
   void addColumn(float v)
   {
-	  std::string str;
-    getFloat(v,str);
-    addColumn(str.c_str());
+    getCurrent();
+    size_t first = mCurrent->getColumnCount();
+    mCurrent->addFloat(v);
+    accumulate(first);
   }
 
   void addColumnHex(unsigned int v)
@@ -2009,14 +2417,34 @@ public:
 
   void addColumn(int v)
   {
-    const char *temp = formatNumber(v);
-    addColumn(temp);
+    getCurrent();
+    size_t first = mCurrent->getColumnCount();
+    mCurrent->addInteger(v);
+    accumulate(first);
   }
 
   void addColumn(unsigned int v)
   {
-    const char *temp = formatNumber(v);
-    addColumn(temp);
+    getCurrent();
+    size_t first = mCurrent->getColumnCount();
+    mCurrent->addInteger(v);
+    accumulate(first);
+  }
+
+  void addColumn(long long v)
+  {
+    getCurrent();
+    size_t first = mCurrent->getColumnCount();
+    mCurrent->addInteger(v);
+    accumulate(first);
+  }
+
+  void addColumn(unsigned long long v)
+  {
+    getCurrent();
+    size_t first = mCurrent->getColumnCount();
+    mCurrent->addInteger((long long)v);
+    accumulate(first);
   }
 
 
@@ -2024,28 +2452,51 @@ public:
   {
     char data[8192];
     data[8191] = 0;
-  	_vsnprintf(data,8191, fmt, (char *)(&fmt+1));
+    va_list arg;
+    va_start(arg,fmt);
+  	_vsnprintf(data,8191, fmt, arg);
+    va_end(arg);
 
     getCurrent();
-    mCurrent->addCSV(data,mParser);
+    size_t first = mCurrent->getColumnCount();
+    mCurrent->addCSV(data,mParser,mStrings);
+    accumulate(first);
     if ( newRow )
     {
       mCurrent = 0;
     }
   }
 
+  // Folds the cells added to the current row from column 'first' on into the column totals.
+  void accumulate(size_t first)
+  {
+    size_t count = mCurrent->getColumnCount();
+    if ( count > mColumnTotals.size() )
+    {
+      mColumnTotals.resize(count);
+    }
+    if ( !mCurrent->isHeader() )
+    {
+      for (size_t i=first; i<count; i++)
+      {
+        mColumnTotals[i].add(*mCurrent->getCell(i));
+      }
+    }
+  }
+
   void nextRow(void)
   {
     mCurrent = 0;
   }
 
-  void getCurrent(void)
+  void getCurrent(void) // every change to the rows goes through here
   {
     if ( mCurrent == 0 )
     {
       mCurrent = HTML_NEW(HtmlRow);
       mBody.push_back(mCurrent);
     }
+    invalidateSorted();
   }
 
 
@@ -2119,7 +2570,7 @@ public:
     for (i=mBody.begin(); i!=mBody.end(); i++)
     {
       HtmlRow *row = (*i);
-      row->saveExcel(fph,this);
+      row->saveExcel(fph,this,mStrings);
     }
 
     fprintf(fph,"</TABLE>\r\n");
@@ -2129,17 +2580,17 @@ public:
   }
 
 
-  void saveSimpleHTML(FILE_INTERFACE *fph)
+  void saveSimpleHTML(FILE_INTERFACE *fph,const HtmlRowVector &rows)
   {
     fi_fprintf(fph,"<TABLE BORDER=\"1\">\r\n");
     fi_fprintf(fph," <caption><EM>%s</EM></caption>\r\n", mHeading.c_str() );
 
 
-    HtmlRowVector::iterator i;
-    for (i=mBody.begin(); i!=mBody.end(); i++)
+    HtmlRowVector::const_iterator i;
+    for (i=rows.begin(); i!=rows.end(); i++)
     {
       HtmlRow *row = (*i);
-      row->htmlRow(fph,this);
+      row->htmlRow(fph,this,mStrings);
     }
 
     fi_fprintf(fph,"</TABLE>\r\n");
@@ -2148,28 +2599,28 @@ public:
     fi_fprintf(fph,"<p></p>\r\n");
   }
 
-  void saveCSV(FILE_INTERFACE *fph)
+  void saveCSV(FILE_INTERFACE *fph,const HtmlRowVector &rows)
   {
     fi_fprintf(fph,"%s\r\n", mHeading.c_str() );
-    HtmlRowVector::iterator i;
-    for (i=mBody.begin(); i!=mBody.end(); i++)
+    HtmlRowVector::const_iterator i;
+    for (i=rows.begin(); i!=rows.end(); i++)
     {
       HtmlRow *row = (*i);
-      row->saveCSV(fph);
+      row->saveCSV(fph,mStrings);
     }
     fi_fprintf(fph,"\r\n");
   }
 
-  void saveCPP(FILE_INTERFACE *fph)
+  void saveCPP(FILE_INTERFACE *fph,const HtmlRowVector &rows)
   {
     fi_fprintf(fph,"  if ( 1 )\r\n");
     fi_fprintf(fph,"  {\r\n");
     fi_fprintf(fph,"    NVSHARE::HtmlTable *table = document->createHtmlTable(\"%s\");\r\n", mHeading.c_str() );
-    HtmlRowVector::iterator i;
-    for (i=mBody.begin(); i!=mBody.end(); i++)
+    HtmlRowVector::const_iterator i;
+    for (i=rows.begin(); i!=rows.end(); i++)
     {
       HtmlRow *row = (*i);
-      row->saveCPP(fph);
+      row->saveCPP(fph,mStrings);
     }
 
     if ( mComputeTotals )
@@ -2196,12 +2647,10 @@ public:
     fi_fprintf(fph,"\r\n");
   }
 
-  void sortBody(const SortRequest &sr)
+  void sortBody(HtmlRowVector &body,const SortRequest &sr)
   {
-    mSortRequest = sr;
-
-    size_t rcount = mBody.size();
-    int index  = 0;
+    size_t rcount = body.size();
+    size_t index  = 0;
 
     HtmlRow **rows = (HtmlRow **) HTML_MALLOC(sizeof(HtmlRow *)*rcount);
     size_t   *indices = (size_t *) HTML_MALLOC(sizeof(size_t)*rcount);
@@ -2209,7 +2658,7 @@ public:
 
     for (size_t i=0; i<rcount; i++)
     {
-      HtmlRow *row = mBody[i];
+      HtmlRow *row = body[i];
       if ( !row->isHeader() )
       {
         rows[index]    = row;
@@ -2218,13 +2667,13 @@ public:
       }
     }
 
-    qsort( (void **)rows,index);
+    mSorter.sort(rows,index,sr,mStrings);
 
-    for (int i=0; i<index; i++)
+    for (size_t i=0; i<index; i++)
     {
       HtmlRow *row = rows[i];
       size_t   dest = indices[i];
-      mBody[dest] = row;
+      body[dest] = row;
     }
 
     HTML_FREE(rows);
@@ -2240,56 +2689,42 @@ public:
 
       if ( mSortRequests.size() && type != HST_CPP )
       {
-        SortRequestVector::iterator i;
-        for (i=mSortRequests.begin(); i!=mSortRequests.end(); i++)
+        for (size_t i=0; i<mSortRequests.size(); i++)
         {
-          sortBody( (*i) );
-          saveInternal(fph,type,(*i).mSortName.c_str());
+          saveInternal(fph,type,getSortedBody(i),mSortRequests[i].mSortName.c_str());
         }
       }
       else
       {
-        saveInternal(fph,type,"");
+        saveInternal(fph,type,getSortedBody(mSortRequests.size()),"");
       }
     }
   }
 
-  void saveInternal(FILE_INTERFACE *fph,HtmlSaveType type,const char *secondary_caption)
+  void saveInternal(FILE_INTERFACE *fph,HtmlSaveType type,const HtmlRowVector &rows,const char *secondary_caption)
   {
-    bool totals = false;
-
-    if ( mComputeTotals )
-    {
-      totals = addTotalsRow();
-    }
-
     switch ( type )
     {
       case HST_SIMPLE_HTML:
-        saveSimpleHTML(fph);
+        saveSimpleHTML(fph,rows);
         break;
       case HST_CSV:
-        saveCSV(fph);
+        saveCSV(fph,rows);
         break;
       case HST_TEXT:
         BorderASCII();
-        saveText(fph,secondary_caption);
+        saveText(fph,rows,secondary_caption);
         break;
       case HST_TEXT_EXTENDED:
         BorderDOS();
-        saveText(fph,secondary_caption);
+        saveText(fph,rows,secondary_caption);
         break;
       case HST_CPP:
-        saveCPP(fph);
+        saveCPP(fph,rows);
         break;
       case HST_XML:
         break;
     }
-
-    if ( totals )
-    {
-      removeTotalsRow();
-    }
   }
 
   bool excluded(size_t c)
@@ -2308,117 +2743,75 @@ public:
     return ret;
   }
 
-  float computeTotal(size_t column)
-  {
-    float ret = 0;
-    HtmlRowVector::iterator i;
-    for (i=mBody.begin(); i!=mBody.end(); i++)
-    {
-      HtmlRow *row = (*i);
-      if ( !row->isHeader() )
-      {
-		  std::string str;
-        row->getString(column,str);
-        if ( isNumeric(str) )
-        {
-          float v = getFloatValue(str.c_str());
-          ret+=v;
-        }
-      }
-    }
-    return ret;
-  }
-
-  bool addTotalsRow(void)
+  HtmlRow * createTotalsRow(const HtmlRowVector &rows)
   {
     bool ret = false;
+    HtmlRow *totals = 0;
 
-    if ( mBody.size() >= 2 )
+    if ( rows.size() >= 2 )
     {
       HtmlRow *first_row = 0;
 
-      SizetVector csize;
-      HtmlRowVector::iterator i;
-      for (i=mBody.begin(); i!=mBody.end(); i++)
+      HtmlRowVector::const_iterator i;
+      for (i=rows.begin(); i!=rows.end(); i++)
       {
         HtmlRow *row = (*i);
-        if ( !row->isHeader() && first_row == 0 )
+        if ( !row->isHeader() )
         {
           first_row = row;
+          break;
         }
-        row->columnSizes(csize);
       }
       if ( first_row )
       {
-        HtmlRow *totals = HTML_NEW(HtmlRow);
+        totals = HTML_NEW(HtmlRow);
         totals->setFooter(true);
-        size_t count = csize.size();
+        size_t count = mColumnTotals.size();
         for (size_t i=0; i<count; i++)
         {
           if ( !excluded(i+1) )
           {
-			  std::string str;
-            first_row->getString(i,str);
-            if ( isNumeric(str) )
+            if ( first_row->isNumeric(i) )
             {
-              float v = computeTotal(i);
-              std::string str;
-              getFloat(v,str);
-              totals->addColumn(str.c_str());
+              mColumnTotals[i].addTo(*totals);
             }
             else
             {
               if ( i == 0 )
               {
-                totals->addColumn("Totals");
+                totals->addColumn("Totals",mStrings);
               }
               else
               {
-                totals->addColumn("");
+                totals->addColumn("",mStrings);
               }
             }
             ret = true;
           }
           else
           {
-            totals->addColumn("");
+            totals->addColumn("",mStrings);
           }
         }
-        if ( ret )
-        {
-          mBody.push_back(totals);
-        }
-        else
+        if ( !ret )
         {
           HTML_DELETE(HtmlRow,totals);
+          totals = 0;
         }
       }
     }
 
-    return ret;
+    return totals;
   }
 
-  void removeTotalsRow(void)
-  {
-    if ( mBody.size() )
-    {
-      size_t index = mBody.size()-1;
-      HtmlRow *row = mBody[index];
-      HTML_DELETE(HtmlRow,row);
-      HtmlRowVector::iterator i = mBody.end();
-      i--;
-      mBody.erase(i);
-    }
-  }
-
-  void saveText(FILE_INTERFACE *fph,const char *secondary_caption)
+  void saveText(FILE_INTERFACE *fph,const HtmlRowVector &rows,const char *secondary_caption)
   {
     SizetVector csize;
-    HtmlRowVector::iterator i;
-    for (i=mBody.begin(); i!=mBody.end(); i++)
+    HtmlRowVector::const_iterator i;
+    for (i=rows.begin(); i!=rows.end(); i++)
     {
       HtmlRow *row = (*i);
-      row->columnSizes(csize);
+      row->columnSizes(csize,mStrings);
     }
 
     size_t column_count = csize.size();
@@ -2472,8 +2865,8 @@ public:
     //*****************************************
     // Print the body data
     //*****************************************
-    HtmlRowVector::iterator j;
-    for (j=mBody.begin(); j!=mBody.end(); j++)
+    HtmlRowVector::const_iterator j;
+    for (j=rows.begin(); j!=rows.end(); j++)
     {
       HtmlRow &row = *(*j);
 
@@ -2513,7 +2906,7 @@ public:
 
 
         std::string str;
-        row.getString(i,str);
+        row.getString(i,str,mStrings);
 
         assert( str.size() < csize[i] );
 
@@ -2521,7 +2914,7 @@ public:
         {
           printCenter(fph,str,c);
         }
-        else if ( isNumeric(str) )
+        else if ( row.isNumeric(i) )
         {
           printRight(fph,str,c);
         }
@@ -2586,17 +2979,20 @@ public:
   void computeTotals(void) // compute and display totals of numeric columns when displaying this table.
   {
     mComputeTotals = true;
+    invalidateSorted();
   }
 
   void excludeTotals(unsigned int column)
   {
     mExcludeTotals.push_back(column);
+    invalidateSorted();
   }
 
   void addSort(const char *sort_name,unsigned int primary_key,bool primary_ascending,unsigned int secondary_key,bool secondary_ascending) // adds a sorted result.  You can set up mulitple sort requests for a single table.
   {
     SortRequest sr(sort_name,primary_key,primary_ascending,secondary_key,secondary_ascending);
     mSortRequests.push_back(sr);
+    invalidateSorted();
   }
 
   void  setColumnColor(unsigned int column,unsigned int color) // set a color for a specific column.
@@ -2635,11 +3031,11 @@ public:
     }
     else
     {
-      unsigned int count = unsigned int(mColumnColors.size())/2;
+      unsigned int count = (unsigned int)(mColumnColors.size())/2;
       for (unsigned int i=0; i<count; i++)
       {
-        unsigned int c = unsigned int(mColumnColors[i*2+0]);
-        unsigned int color = unsigned int(mColumnColors[i*2+1]);
+        unsigned int c = (unsigned int)(mColumnColors[i*2+0]);
+        unsigned int color = (unsigned int)(mColumnColors[i*2+1]);
         if ( column == c )
         {
           ret = color;
@@ -2668,8 +3064,11 @@ private:
   std::string          mHeading;
   HtmlRow             *mCurrent;
   HtmlRowVector        mBody;
+  HtmlStringTable      mStrings;
+  HtmlColumnTotalVector mColumnTotals;    // running totals of the body rows, per column
   InPlaceParser        mParser;
-  SortRequest          mSortRequest;      // the current sort request...
+  HtmlRowSorter        mSorter;
+  HtmlSortedBodyVector mSorted;           // cached display order and totals per sort request
   SortRequestVector    mSortRequests;
 
   bool                        mComputeTotals;
@@ -2953,7 +3352,7 @@ public:
     char scratch[512];
     sprintf(scratch,"%s%s", root_dir.c_str(), dest_name.c_str() );
 
-    unsigned int tableCount = unsigned int(mTables.size());
+    unsigned int tableCount = (unsigned int)(mTables.size());
 
     FILE *fph = fopen(scratch,"wb");
 
@@ -3643,4 +4042,75 @@ int                 getHtmlMemoryUsage(void)
   return gMemTracker.getMemoryUsage();
 }
 
+// Tables of 100k, 1M and 5M rows with a size and a count column, like the report's, sorted by size
+// descending and then count descending.  Sizes spread over a few orders of magnitude with plenty of
+// ties, as symbol sizes do.  Each table is sorted three times both ways, from the same order.
+int                 sortBenchmark(void)
+{
+  static const size_t counts[3] = { 100000, 1000000, 5000000 };
+
+  SortRequest sr("Sorted by size",1,false,2,false);
+  HtmlStringTable strings;
+  unsigned int seed = 12345;
+
+  for (int c=0; c<3; c++)
+  {
+    size_t count = counts[c];
+    std::vector< HtmlRow > table(count);
+    for (size_t i=0; i<count; i++)
+    {
+      unsigned int r[2];
+      for (int j=0; j<2; j++)
+      {
+        seed = seed*1103515245 + 12345;
+        r[j] = seed >> 8;
+      }
+      table[i].addInteger(16 + r[0] % (64u << r[1] % 14));
+      table[i].addInteger(1 + (r[1] >> 8) % 4);
+    }
+
+    std::vector< HtmlRow * > original(count);
+    for (size_t i=0; i<count; i++)
+      original[i] = &table[i];
+
+    std::vector< HtmlRow * > quick;
+    std::vector< HtmlRow * > radix;
+    double secs[2];
+    for (int radixSort=0; radixSort<2; radixSort++)
+    {
+      std::vector< HtmlRow * > &rows = radixSort ? radix : quick;
+      HtmlRowSorter sorter;
+      QuickSortRows quickSort(sr,strings);
+      clock_t best = 0;
+      for (int pass=0; pass<3; pass++)
+      {
+        rows = original;
+        clock_t start = clock();
+        if ( radixSort )
+          sorter.sort(&rows[0],count,sr,strings);
+        else
+          quickSort.sort(&rows[0],count);
+        clock_t elapsed = clock() - start;
+        if ( !pass || elapsed < best )
+          best = elapsed;
+      }
+      secs[radixSort] = double(best > 0 ? best : 1) / CLOCKS_PER_SEC;
+    }
+
+    // ties may end up in a different order, the keys may not
+    bool same = true;
+    for (size_t i=0; i<count && same; i++)
+    {
+      same = quick[i]->getCell(0)->getInteger() == radix[i]->getCell(0)->getInteger()
+        && quick[i]->getCell(1)->getInteger() == radix[i]->getCell(1)->getInteger();
+    }
+
+    printf("%7u rows: QuickSortPointers %.3fs, HtmlRowSorter %.3fs, speedup: %.2fx%s\n",(unsigned int)count,
+      secs[0],secs[1],secs[0] / secs[1],same ? "" : " (DIFFERENT ORDER)");
+    fflush(stdout);
+  }
+
+  return 0;
+}
+
 }; // end of namespace
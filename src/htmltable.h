@@ -33,6 +33,8 @@ public:
   virtual void                addColumn(float v) = 0 ;               // will add this floating point number, nicely formatted
   virtual void                addColumn(int v) = 0;                 // will add this integer number nicely formatted.
   virtual void                addColumn(unsigned int v) = 0;                 // will add this integer number nicely formatted.
+  virtual void                addColumn(long long v) = 0;                 // will add this 64 bit integer number nicely formatted.
+  virtual void                addColumn(unsigned long long v) = 0;        // values above 2^63 are not supported.
   virtual void                addColumnHex(unsigned int v) = 0;                 // will add this as a hex string.
   virtual void                addCSV(bool newRow,const char *fmt,...) = 0;       // add this line of data as a set of columns, using the comma character as a seperator.
   virtual void                nextRow(void) = 0;                         // advance to the next row.
@@ -65,6 +67,7 @@ public:
 
 HtmlTableInterface *getHtmlTableInterface(void);
 int                 getHtmlMemoryUsage(void);
+int                 sortBenchmark(void); // times sorting synthetic tables, radix vs. QuickSortPointers, and prints the speedups.
 
 
 }; // end of namespace
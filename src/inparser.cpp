@@ -57,6 +57,45 @@
 
 #include "inparser.h"
 
+// vectorized scans, if the compiler targets SSE2 or AVX2
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define INPARSER_SIMD 32
+typedef __m256i ScanVector;
+#define SCAN_LOAD(p)   _mm256_load_si256((const __m256i *)(p))
+#define SCAN_SPLAT(c)  _mm256_set1_epi8(c)
+#define SCAN_EQ(a,b)   _mm256_cmpeq_epi8(a,b)
+#define SCAN_OR(a,b)   _mm256_or_si256(a,b)
+#define SCAN_MASK(v)   ((unsigned int)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define INPARSER_SIMD 16
+typedef __m128i ScanVector;
+#define SCAN_LOAD(p)   _mm_load_si128((const __m128i *)(p))
+#define SCAN_SPLAT(c)  _mm_set1_epi8(c)
+#define SCAN_EQ(a,b)   _mm_cmpeq_epi8(a,b)
+#define SCAN_OR(a,b)   _mm_or_si128(a,b)
+#define SCAN_MASK(v)   ((unsigned int)_mm_movemask_epi8(v))
+#endif
+
+#if defined(INPARSER_SIMD) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// the vector scans load whole aligned blocks: the first one can start before the data and the
+// last one goes up to INPARSER_SIMD-1 bytes past the zero byte that ends it. buffers the parser
+// allocates itself start on a block boundary and get SCAN_PADDING zeroed bytes on the end; data
+// it doesn't own (SetSourceData, GetArglist) is scanned a byte at a time.
+#if defined(INPARSER_SIMD)
+#define SCAN_PADDING INPARSER_SIMD
+#else
+#define SCAN_PADDING 0
+#endif
+
+#if defined(INPARSER_SIMD) && defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
 
 /** @file inparser.cpp
  * @brief        Parse ASCII text, in place, very quickly.
@@ -108,11 +147,89 @@
 namespace NVSHARE
 {
 
+#if defined(INPARSER_SIMD)
+
+static inline int LowestBit(unsigned int mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index,mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+//==================================================================================
+// returns the first byte from p on that is in the set (not in it, if skip is set).  Either way
+// the zero byte that ends the data has to stop the scan.  Only aligned blocks are loaded, so the
+// data needs SCAN_PADDING bytes after that zero byte.
+//==================================================================================
+static const char * FindAny(const char *p,const ScanSet &set,bool skip)
+{
+	// sets are padded to 4 or 8 bytes by repeating one, so the compares unroll
+	ScanVector n0 = SCAN_SPLAT((char)set.mBytes[0]);
+	ScanVector n1 = SCAN_SPLAT((char)set.mBytes[1]);
+	ScanVector n2 = SCAN_SPLAT((char)set.mBytes[2]);
+	ScanVector n3 = SCAN_SPLAT((char)set.mBytes[3]);
+	bool wide = set.mCount > 4;
+	const unsigned int all = (INPARSER_SIMD == 32) ? ~0u : (1u << INPARSER_SIMD) - 1; // one bit per byte
+	unsigned int flip = skip ? all : 0;
+
+	size_t misalign = (size_t)p & (INPARSER_SIMD-1);
+	const char *block = p - misalign;
+	unsigned int mask = all << misalign; // ignore the bytes before p in the first block
+
+	for (;;)
+	{
+		ScanVector data = SCAN_LOAD(block);
+		ScanVector hits = SCAN_OR(SCAN_OR(SCAN_EQ(data,n0),SCAN_EQ(data,n1)),SCAN_OR(SCAN_EQ(data,n2),SCAN_EQ(data,n3)));
+		if ( wide )
+		{
+			for (int i=4; i<MAXSCANBYTES; i++)
+				hits = SCAN_OR(hits,SCAN_EQ(data,SCAN_SPLAT((char)set.mBytes[i])));
+		}
+
+		mask &= SCAN_MASK(hits) ^ flip;
+		if ( mask )
+			return block + LowestBit(mask);
+
+		block += INPARSER_SIMD;
+		mask = all;
+	}
+}
+
+#endif
+
+//==================================================================================
+// room for size bytes plus the padding, aligned for the vector scans
+//==================================================================================
+static char * AllocScanBuffer(size_t size)
+{
+#if !defined(INPARSER_SIMD)
+	return (char *)::malloc(size);
+#elif defined(_MSC_VER)
+	return (char *)_aligned_malloc(size+SCAN_PADDING,INPARSER_SIMD);
+#else
+	void *mem = 0;
+	return posix_memalign(&mem,INPARSER_SIMD,size+SCAN_PADDING) == 0 ? (char *)mem : 0;
+#endif
+}
+
+static void FreeScanBuffer(char *mem)
+{
+#if defined(INPARSER_SIMD) && defined(_MSC_VER)
+	_aligned_free(mem);
+#else
+	::free(mem);
+#endif
+}
+
 	void InPlaceParser::SetFile(const char *fname)
 {
 	if ( mMyAlloc )
 	{
-		::free(mData);
+		FreeScanBuffer(mData);
 	}
 	mData = 0;
 	mLen  = 0;
@@ -127,16 +244,16 @@ namespace NVSHARE
 
 		if ( mLen )
 		{
-			mData = (char *) ::malloc(sizeof(char)*(mLen+1));
+			mData = AllocScanBuffer(sizeof(char)*(mLen+1));
 			int read = (int)fread(mData,mLen,1,fph);
 			if ( !read )
 			{
-				::free(mData);
+				FreeScanBuffer(mData);
 				mData = 0;
 			}
 			else
 			{
-				mData[mLen] = 0; // zero byte terminate end of file marker.
+				memset(mData+mLen,0,1+SCAN_PADDING); // zero byte terminate end of file marker.
 				mMyAlloc = true;
 			}
 		}
@@ -149,14 +266,115 @@ InPlaceParser::~InPlaceParser(void)
 {
 	if ( mMyAlloc )
 	{
-		::free(mData);
+		FreeScanBuffer(mData);
+	}
+	FreeScanBuffer(mChunk);
+}
+
+//==================================================================================
+// collects the bytes the scans stop at from the separator table
+//==================================================================================
+static void AddScanByte(ScanSet &set,int c)
+{
+	if ( set.mCount < 0 )
+		return;
+	if ( set.mCount < MAXSCANBYTES )
+		set.mBytes[set.mCount++] = (unsigned char)c;
+	else
+		set.mCount = -1; // too many
+}
+
+void InPlaceParser::UpdateScanSets(void)
+{
+	mLineScan.mCount = 0;
+	mArgScan.mCount = 0;
+	mSpaceScan.mCount = 0;
+	mQuoteScan.mCount = 0;
+	AddScanByte(mLineScan,0);
+	AddScanByte(mArgScan,0);
+	AddScanByte(mQuoteScan,0);
+	if ( (unsigned char)mQuoteChar && mHard[(unsigned char)mQuoteChar] != ST_EOS )
+		AddScanByte(mQuoteScan,(unsigned char)mQuoteChar);
+
+	for (int i=1; i<256; i++)
+	{
+		switch ( mHard[i] )
+		{
+			case ST_LINE_FEED:
+				AddScanByte(mLineScan,i);
+				break;
+			case ST_SOFT:
+				AddScanByte(mArgScan,i);
+				AddScanByte(mSpaceScan,i);
+				break;
+			case ST_HARD:
+				AddScanByte(mArgScan,i);
+				break;
+			case ST_EOS:
+				AddScanByte(mArgScan,i);
+				AddScanByte(mQuoteScan,i);
+				break;
+			default:
+				break;
+		}
+	}
+
+	// a zero byte that's a space wouldn't stop skipping spaces
+	if ( mHard[0] == ST_SOFT )
+		mSpaceScan.mCount = -1;
+
+	ScanSet *sets[4] = { &mLineScan, &mArgScan, &mSpaceScan, &mQuoteScan };
+	for (int i=0; i<4; i++)
+	{
+		ScanSet &set = *sets[i];
+		if ( set.mCount <= 0 )
+			set.mCount = 0; // scan one byte at a time
+		for (int j=set.mCount; j<MAXSCANBYTES; j++)
+			set.mBytes[j] = set.mBytes[0]; // padding, repeats don't change what's found
 	}
+	mScanDirty = false;
+}
+
+//==================================================================================
+char * InPlaceParser::ScanLine(char *foo)
+{
+#if defined(INPARSER_SIMD)
+	if ( mVectorScan && mPadded && mLineScan.mCount )
+		return (char *)FindAny(foo,mLineScan,false);
+#endif
+	while ( *foo && !isLineFeed(*foo) )
+		++foo;
+	return foo;
+}
+
+//==================================================================================
+char * InPlaceParser::ScanArg(char *foo)
+{
+#if defined(INPARSER_SIMD)
+	if ( mVectorScan && mPadded && mArgScan.mCount )
+		return (char *)FindAny(foo,mArgScan,false);
+#endif
+	while ( !EOS(*foo) && !IsWhiteSpace(*foo) && !IsHard(*foo) )
+		++foo;
+	return foo;
+}
+
+//==================================================================================
+char * InPlaceParser::ScanQuote(char *foo)
+{
+#if defined(INPARSER_SIMD)
+	if ( mVectorScan && mPadded && mQuoteScan.mCount )
+		return (char *)FindAny(foo,mQuoteScan,false);
+#endif
+	while ( !EOS(*foo) && *foo != mQuoteChar )
+		++foo;
+	return foo;
 }
 
 //==================================================================================
 bool InPlaceParser::IsHard(char c)
 {
-	return mHard[c] == ST_HARD;
+	return mHard[(unsigned char)c] == ST_HARD;
 }
 
 //==================================================================================
@@ -164,7 +382,7 @@ char * InPlaceParser::AddHard(int &argc,const char **argv,char *foo)
 {
 	while ( IsHard(*foo) )
 	{
-		const char *hard = &mHardString[*foo*2];
+		const char *hard = &mHardString[(unsigned char)*foo*2];
 		if ( argc < MAXARGS )
 		{
 			argv[argc++] = hard;
@@ -177,12 +395,17 @@ char * InPlaceParser::AddHard(int &argc,const char **argv,char *foo)
 //==================================================================================
 bool   InPlaceParser::IsWhiteSpace(char c)
 {
-	return mHard[c] == ST_SOFT;
+	return mHard[(unsigned char)c] == ST_SOFT;
 }
 
 //==================================================================================
 char * InPlaceParser::SkipSpaces(char *foo)
 {
+#if defined(INPARSER_SIMD)
+	// a single space between arguments isn't worth setting up a vector scan
+	if ( mVectorScan && mPadded && mSpaceScan.mCount && IsWhiteSpace(foo[0]) && IsWhiteSpace(foo[1]) )
+		return (char *)FindAny(foo,mSpaceScan,true);
+#endif
 	while ( !EOS(*foo) && IsWhiteSpace(*foo) ) 
 		++foo;
 	return foo;
@@ -204,6 +427,9 @@ int InPlaceParser::ProcessLine(int lineno,char *line,InPlaceParserInterface *cal
 
 	char *foo = line;
 
+	if ( mScanDirty )
+		UpdateScanSets();
+
 	while ( !EOS(*foo) && argc < MAXARGS )
 	{
 		foo = SkipSpaces(foo); // skip any leading spaces
@@ -218,8 +444,7 @@ int InPlaceParser::ProcessLine(int lineno,char *line,InPlaceParserInterface *cal
 			{
 				argv[argc++] = foo;
 			}
-			while ( !EOS(*foo) && *foo != mQuoteChar ) 
-				++foo;
+			foo = ScanQuote(foo);
 			if ( !EOS(*foo) )
 			{
 				*foo = 0; // replace close quote with zero byte EOS
@@ -252,28 +477,23 @@ int InPlaceParser::ProcessLine(int lineno,char *line,InPlaceParserInterface *cal
 						*foo = 32;
 				}
 
-				// continue..until we hit an eos ..
-				while ( !EOS(*foo) ) // until we hit EOS
+				// continue..until we hit an eos, a space or a hard separator
+				foo = ScanArg(foo);
+				if ( IsWhiteSpace(*foo) ) // if we hit a space, stomp a zero byte, and exit
+				{
+					*foo = 0;
+					++foo;
+				}
+				else if ( IsHard(*foo) ) // if we hit a hard separator, stomp a zero byte and store the hard separator argument
 				{
-					if ( IsWhiteSpace(*foo) ) // if we hit a space, stomp a zero byte, and exit
+					const char *hard = &mHardString[(unsigned char)*foo*2];
+					*foo = 0;
+					if ( argc < MAXARGS )
 					{
-						*foo = 0;
-						++foo;
-						break;
-					}
-					else if ( IsHard(*foo) ) // if we hit a hard separator, stomp a zero byte and store the hard separator argument
-					{
-						const char *hard = &mHardString[*foo*2];
-						*foo = 0;
-						if ( argc < MAXARGS )
-						{
-							argv[argc++] = hard;
-						}
-						++foo;
-						break;
+						argv[argc++] = hard;
 					}
 					++foo;
-				} // end of while loop...
+				}
 			}
 		}
 	}
@@ -294,8 +514,9 @@ int  InPlaceParser::Parse(const char *str,InPlaceParserInterface *callback) // r
   mLen = (int)strlen(str);
   if ( mLen )
   {
-	  mData = (char *)::malloc(mLen+1);
+	  mData = AllocScanBuffer(mLen+1);
     strcpy(mData,str);
+    memset(mData+mLen,0,1+SCAN_PADDING);
     mMyAlloc = true;
     ret = Parse(callback);
   }
@@ -312,44 +533,181 @@ int  InPlaceParser::Parse(InPlaceParserInterface *callback)
 	if ( mData )
 	{
 		int lineno = 0;
+		mPadded = mMyAlloc;
+		ret = ParseLines(mData,lineno,callback);
+		mPadded = false;
+	}
+	return ret;
+}
+
+//==================================================================================
+// parses the lines of a zero byte terminated buffer, lineno carries on from the previous buffer
+//==================================================================================
+int InPlaceParser::ParseLines(char *data,int &lineno,InPlaceParserInterface *callback)
+{
+	int ret = 0;
 
-		char *foo   = mData;
-		char *begin = foo;
+	char *foo   = data;
+	char *begin = foo;
 
-		while ( *foo )
-		{
-			if ( isLineFeed(*foo) )
-			{
-				++lineno;
-				*foo = 0;
-				if ( *begin ) // if there is any data to parse at all...
-				{
-          bool snarfed = callback->preParseLine(lineno,begin);
-          if ( !snarfed )
-          {
-  					int v = ProcessLine(lineno,begin,callback);
-  					if ( v )
-  						ret = v;
-          }
-				}
+	if ( mScanDirty )
+		UpdateScanSets();
 
-				++foo;
-				if ( *foo == 10 )
-					++foo; // skip line feed, if it is in the carraige-return line-feed format...
-				begin = foo;
-			}
-			else
+	for (;;)
+	{
+		foo = ScanLine(foo);
+		if ( !*foo )
+			break;
+
+		char feed = *foo;
+		++lineno;
+		*foo = 0;
+		if ( *begin ) // if there is any data to parse at all...
+		{
+			bool snarfed = callback->preParseLine(lineno,begin);
+			if ( !snarfed )
 			{
-				++foo;
+				int v = ProcessLine(lineno,begin,callback);
+				if ( v )
+					ret = v;
 			}
 		}
 
-		lineno++; // lasst line.
+		++foo;
+		if ( feed == 13 && *foo == 10 )
+			++foo; // skip line feed, if it is in the carraige-return line-feed format...
+		begin = foo;
+	}
+
+	if ( *begin ) // last line, without a line feed
+	{
+		lineno++;
+		bool snarfed = callback->preParseLine(lineno,begin);
+		if ( !snarfed )
+		{
+			int v = ProcessLine(lineno,begin,callback);
+			if ( v )
+				ret = v;
+		}
+	}
+
+	return ret;
+}
+
+//==================================================================================
+// returns the length of the whole lines at the start of data, 0 if there is no line feed.
+// if more data follows, a trailing carriage return might be half of a CR/LF pair, so that line
+// is left for the next chunk.
+//==================================================================================
+size_t InPlaceParser::CompleteLines(const char *data,size_t len,bool more)
+{
+	size_t i = len;
+	while ( i )
+	{
+		--i;
+		if ( isLineFeed(data[i]) && !(more && i+1 == len && data[i] == 13) )
+			return i+1;
+	}
+	return 0;
+}
+
+//==================================================================================
+char * InPlaceParser::ChunkBuffer(size_t len)
+{
+	if ( len+1 > mChunkSize )
+	{
+		char *chunk = AllocScanBuffer(len+1);
+		if ( mChunk )
+		{
+			memcpy(chunk,mChunk,mChunkSize);
+			FreeScanBuffer(mChunk);
+		}
+		mChunk = chunk;
+		mChunkSize = len+1;
+	}
+	return mChunk;
+}
+
+//==================================================================================
+// parses a copy of len bytes of data, at most chunkSize bytes (or one line if that's longer) at a time.
+// the source isn't modified and doesn't need a zero byte, so it can be a read-only file mapping.
+//==================================================================================
+int InPlaceParser::ParseChunked(const char *data,size_t len,InPlaceParserInterface *callback,int chunkSize)
+{
+	int ret = 0;
+	int lineno = 0;
+	size_t pos = 0;
+	assert( callback && chunkSize > 0 );
+
+	while ( pos < len )
+	{
+		size_t size = len - pos;
+		size_t lines = 0;
+		for ( size_t window = chunkSize; !lines; window += chunkSize ) // widen for lines longer than a chunk
+		{
+			bool more = window < size;
+			lines = CompleteLines(data+pos,more ? window : size,more);
+			if ( !more && !lines )
+				lines = size;
+		}
+
+		char *chunk = ChunkBuffer(lines);
+		memcpy(chunk,data+pos,lines);
+		memset(chunk+lines,0,1+SCAN_PADDING);
+		pos += lines;
+
+		mPadded = true;
+		int v = ParseLines(chunk,lineno,callback);
+		mPadded = false;
+		if ( v )
+			ret = v;
+	}
+
+	return ret;
+}
+
+//==================================================================================
+// reads the file from its current position in chunkSize pieces and parses them, carrying
+// a partial last line over to the next piece. the file is left open.
+//==================================================================================
+int InPlaceParser::ParseChunked(FILE *fph,InPlaceParserInterface *callback,int chunkSize)
+{
+	int ret = 0;
+	int lineno = 0;
+	size_t have = 0;
+	bool eof = false;
+	assert( fph && callback && chunkSize > 0 );
+
+	while ( !eof || have )
+	{
+		if ( !eof )
+		{
+			char *chunk = ChunkBuffer(have+chunkSize);
+			size_t read = fread(chunk+have,1,chunkSize,fph);
+			have += read;
+			eof = read < (size_t)chunkSize;
+			memset(chunk+have,0,1+SCAN_PADDING);
+		}
 
-		int v = ProcessLine(lineno,begin,callback);
+		size_t lines = CompleteLines(mChunk,have,!eof);
+		if ( eof && !lines )
+			lines = have;
+		if ( !lines )
+			continue; // line longer than what we have, read more
+
+		char keep = mChunk[lines];
+		mChunk[lines] = 0;
+		mPadded = true;
+		int v = ParseLines(mChunk,lineno,callback);
+		mPadded = false;
 		if ( v )
 			ret = v;
+		mChunk[lines] = keep;
+
+		have -= lines;
+		memmove(mChunk,mChunk+lines,have);
 	}
+
 	return ret;
 }
 
@@ -378,6 +736,9 @@ const char ** InPlaceParser::GetArglist(char *line,int &count)
 
 	char *foo = line;
 
+	if ( mScanDirty )
+		UpdateScanSets();
+
 	while ( !EOS(*foo) && argc < MAXARGS )
 	{
 		foo = SkipSpaces(foo); // skip any leading spaces
@@ -392,8 +753,7 @@ const char ** InPlaceParser::GetArglist(char *line,int &count)
 			{
 				argv[argc++] = foo;
 			}
-			while ( !EOS(*foo) && *foo != mQuoteChar ) 
-				++foo;
+			foo = ScanQuote(foo);
 			if ( !EOS(*foo) )
 			{
 				*foo = 0; // replace close quote with zero byte EOS
@@ -426,28 +786,23 @@ const char ** InPlaceParser::GetArglist(char *line,int &count)
 						*foo = 32;
 				}
 
-				// continue..until we hit an eos ..
-				while ( !EOS(*foo) ) // until we hit EOS
+				// continue..until we hit an eos, a space or a hard separator
+				foo = ScanArg(foo);
+				if ( IsWhiteSpace(*foo) ) // if we hit a space, stomp a zero byte, and exit
 				{
-					if ( IsWhiteSpace(*foo) ) // if we hit a space, stomp a zero byte, and exit
-					{
-						*foo = 0;
-						++foo;
-						break;
-					}
-					else if ( IsHard(*foo) ) // if we hit a hard separator, stomp a zero byte and store the hard separator argument
+					*foo = 0;
+					++foo;
+				}
+				else if ( IsHard(*foo) ) // if we hit a hard separator, stomp a zero byte and store the hard separator argument
+				{
+					const char *hard = &mHardString[(unsigned char)*foo*2];
+					*foo = 0;
+					if ( argc < MAXARGS )
 					{
-						const char *hard = &mHardString[*foo*2];
-						*foo = 0;
-						if ( argc < MAXARGS )
-						{
-							argv[argc++] = hard;
-						}
-						++foo;
-						break;
+						argv[argc++] = hard;
 					}
 					++foo;
-				} // end of while loop...
+				}
 			}
 		}
 	}
@@ -3,8 +3,11 @@
 #define INPARSER_H
 
 #include <assert.h>
+#include <stdio.h>
+#include <stddef.h>
 
 #define MAXARGS 512
+#define MAXSCANBYTES 8 // most bytes a vectorized scan looks for at once
 
 /*!  
 ** 
@@ -100,6 +103,12 @@
  *
  *  You can also construct the InPlaceParser without passing any data, so you can simply pass it a line of data at a time yourself.  The
  *  line of data should be zero-byte terminated.
+ *
+ *  For large inputs use ParseChunked instead.  It parses a copy of the data (or of an open file) a chunk of whole lines at a time,
+ *  so the source stays untouched, needs no terminating zero byte, and only one chunk sized buffer is allocated.
+ *
+ *  Line feeds and the ends of arguments are found 16 (SSE2) or 32 (AVX2) bytes at a time when the compiler targets those, as long as
+ *  no more than MAXSCANBYTES different bytes are line feeds, or separators and comment symbols; otherwise one byte at a time.
 */
 
 namespace NVSHARE
@@ -112,6 +121,13 @@ public:
   virtual bool preParseLine(int /* lineno */,const char * /* line */)  { return false; }; // optional chance to pre-parse the line as raw data.  If you return 'true' the line will be skipped assuming you snarfed it.
 };
 
+// bytes a vectorized scan stops at (or, skipping spaces, goes past); the zero byte always stops it
+struct ScanSet
+{
+	int           mCount; // 0 if there are too many, so scan one byte at a time
+	unsigned char mBytes[MAXSCANBYTES];
+};
+
 enum SeparatorType
 {
 	ST_DATA,        // is data
@@ -149,6 +165,11 @@ public:
 		mData = 0;
 		mLen  = 0;
 		mMyAlloc = false;
+		mChunk = 0;
+		mChunkSize = 0;
+		mVectorScan = true;
+		mPadded = false;
+		mScanDirty = true;
 		for (int i=0; i<256; i++)
 		{
 			mHard[i] = ST_DATA;
@@ -174,34 +195,42 @@ public:
 	int  Parse(const char *str,InPlaceParserInterface *callback); // returns true if entire file was parsed, false if it aborted for some reason
 	int  Parse(InPlaceParserInterface *callback); // returns true if entire file was parsed, false if it aborted for some reason
 
+	int  ParseChunked(const char *data,size_t len,InPlaceParserInterface *callback,int chunkSize=1024*1024); // parses a copy of the data, whole lines at a time
+	int  ParseChunked(FILE *fph,InPlaceParserInterface *callback,int chunkSize=1024*1024); // streams the rest of the file through a chunk sized buffer
+
 	int ProcessLine(int lineno,char *line,InPlaceParserInterface *callback);
 
 	const char ** GetArglist(char *source,int &count); // convert source string into an arg list, this is a destructive parse.
 
 	void SetHardSeparator(char c) // add a hard separator
 	{
-		mHard[c] = ST_HARD;
+		mHard[(unsigned char)c] = ST_HARD;
+		mScanDirty = true;
 	}
 
 	void SetHard(char c) // add a hard separator
 	{
-		mHard[c] = ST_HARD;
+		mHard[(unsigned char)c] = ST_HARD;
+		mScanDirty = true;
 	}
 
 	void SetSoft(char c) // add a hard separator
 	{
-		mHard[c] = ST_SOFT;
+		mHard[(unsigned char)c] = ST_SOFT;
+		mScanDirty = true;
 	}
 
 
 	void SetCommentSymbol(char c) // comment character, treated as 'end of string'
 	{
-		mHard[c] = ST_EOS;
+		mHard[(unsigned char)c] = ST_EOS;
+		mScanDirty = true;
 	}
 
 	void ClearHardSeparator(char c)
 	{
-		mHard[c] = ST_DATA;
+		mHard[(unsigned char)c] = ST_DATA;
+		mScanDirty = true;
 	}
 
 
@@ -209,16 +238,22 @@ public:
 
 	bool EOS(char c)
 	{
-		if ( mHard[c] == ST_EOS )
+		if ( mHard[(unsigned char)c] == ST_EOS )
 		{
 			return true;
 		}
 		return false;
 	}
 
+	void SetVectorScan(bool enable) // false scans one byte at a time, to compare against
+	{
+		mVectorScan = enable;
+	}
+
 	void SetQuoteChar(char c)
 	{
 		mQuoteChar = c;
+		mScanDirty = true;
 	}
 
 	bool HasData( void ) const
@@ -228,12 +263,13 @@ public:
 
   void setLineFeed(char c)
   {
-    mHard[c] = ST_LINE_FEED;
+    mHard[(unsigned char)c] = ST_LINE_FEED;
+    mScanDirty = true;
   }
 
   bool isLineFeed(char c)
   {
-    if ( mHard[c] == ST_LINE_FEED ) return true;
+    if ( mHard[(unsigned char)c] == ST_LINE_FEED ) return true;
     return false;
   }
 
@@ -245,12 +281,30 @@ private:
 	inline bool   IsWhiteSpace(char c);
 	inline bool   IsNonSeparator(char c); // non seperator,neither hard nor soft
 
+	int    ParseLines(char *data,int &lineno,InPlaceParserInterface *callback); // parses zero byte terminated text, counting lines from lineno
+	size_t CompleteLines(const char *data,size_t len,bool more); // length of the whole lines at the start of data
+	char * ChunkBuffer(size_t len); // grows the buffer ParseChunked copies lines into, plus padding for the vector scans
+
+	void   UpdateScanSets(void); // after the separator table changed
+	char * ScanLine(char *foo); // next line feed or zero byte
+	char * ScanArg(char *foo); // next zero byte, space, hard separator or comment symbol
+	char * ScanQuote(char *foo); // next quote, zero byte or comment symbol
+
 	bool   mMyAlloc; // whether or not *I* allocated the buffer and am responsible for deleting it.
 	char  *mData;  // ascii data to parse.
 	int    mLen;   // length of data
 	SeparatorType  mHard[256];
 	char   mHardString[256*2];
 	char           mQuoteChar;
+	char  *mChunk;     // ParseChunked line buffer
+	size_t mChunkSize; // size of that buffer
+	bool   mVectorScan;
+	bool   mPadded;    // the data being parsed is a buffer of ours, aligned and padded for the vector loads
+	bool   mScanDirty; // scan sets need updating
+	ScanSet mLineScan;
+	ScanSet mArgScan;
+	ScanSet mSpaceScan; // spaces, without the zero byte
+	ScanSet mQuoteScan;
 	const char *argv[MAXARGS];
 };
 
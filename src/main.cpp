@@ -3,43 +3,490 @@
 // Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
 
 #include "pdbfile.hpp"
+#include "elffile.hpp"
+#include "mapfile.hpp"
+#include "profile.hpp"
+#include "sizediff.hpp"
+#include "snapshot.hpp"
+#include "cache.hpp"
+#include "parallel.hpp"
+#include "reportwriter.hpp"
+#include "htmltable.h"
+#include "mappedfile.hpp"
+#include "inparser.h"
 #include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <climits>
 #include <ctime>
+#include <map>
 
-int main( int argc, char** argv )
+static int PrintUsage()
+{
+	fprintf( stderr, "Usage: Sizer [options] <exefile|pdbfile|elffile|mapfile>\n" );
+	fprintf( stderr, "  -o <file>            write the report to <file> instead of stdout\n" );
+	fprintf( stderr, "  -save <file>         also save the debug info as a snapshot, which can be\n" );
+	fprintf( stderr, "                       given instead of the input file (or <oldfile>) later\n" );
+	fprintf( stderr, "  -cache <dir>         look up inputs in a cache of snapshots, add them if missing\n" );
+	fprintf( stderr, "  -cachesize <MB>      delete least recently used cache entries above that (1024)\n" );
+	fprintf( stderr, "  -diff <oldfile>      report size changes from <oldfile> to the input file\n" );
+	fprintf( stderr, "  -profile <file>      attribute profile samples (RVA [count] per line)\n" );
+	fprintf( stderr, "  -packed              keep symbol addresses/sizes in 32 bits while they fit\n" );
+	fprintf( stderr, "  -top N               list at most N entries per report section\n" );
+	fprintf( stderr, "  -top <section>=N     same, for one of functions, templates, data, bss,\n" );
+	fprintf( stderr, "                       namespaces, files\n" );
+	fprintf( stderr, "  -parsebench <file>   time the text parser on <file> (map files etc.), one byte\n" );
+	fprintf( stderr, "                       at a time vs. vectorized, and exit\n" );
+	fprintf( stderr, "  -internbench <file>  time interning the symbol names of <file>, string pool\n" );
+	fprintf( stderr, "                       vs. std::map, and exit\n" );
+	fprintf( stderr, "  -sortbench           time sorting report tables of 100k to 5M rows, radix sort\n" );
+	fprintf( stderr, "                       vs. quicksort, and exit\n" );
+	return 1;
+}
+
+// a PDB, an ELF file, a linker map or a snapshot saved earlier; reading is finished either way. With
+// a cache, PDBs are only read if the cache doesn't have them yet; key gets the cache key of the input,
+// for DebugInfoCache::Trim.
+static bool ReadInput( char *fileName, DebugInfo &info, DebugInfoCache *cache, std::string &key )
+{
+	if( DebugInfoSnapshot::IsSnapshot( fileName ) )
+		return DebugInfoSnapshot::Load( fileName, info );
+
+	bool cached = cache && DebugInfoCache::GetKey( fileName, key );
+	if( cached && cache->Load( key, info ) ) {
+		fprintf( stderr, "  %s: using cached %s\n", fileName, key.c_str() );
+		return true;
+	}
+
+	PDBFileReader pdb;
+	ElfFileReader elf;
+	MapFileReader map;
+	DebugInfoReader *reader = &pdb;
+	if( ElfFileReader::IsElf( fileName ) )
+		reader = &elf;
+	else if( MapFileReader::IsMapFile( fileName ) )
+		reader = &map;
+	if( !reader->ReadDebugInfo( fileName, info ) )
+		return false;
+
+	info.FinishedReading();
+
+	if( cached && !cache->Store( key, info ) )
+		fprintf( stderr, "  %s: couldn't add to the cache\n", fileName );
+	return true;
+}
+
+// counts what the parser hands out, so the benchmark has something to do
+class ParseCounter : public NVSHARE::InPlaceParserInterface
 {
-	if( argc < 2 ) {
-		fprintf( stderr, "Usage: Sizer <exefile>\n" );
+public:
+	unsigned long long Lines;
+	unsigned long long Args;
+
+	ParseCounter() { Lines = 0; Args = 0; }
+
+	int ParseLine( int lineno, int argc, const char **argv )
+	{
+		Lines++;
+		Args += argc;
+		return 0;
+	}
+};
+
+// parses a text file with the scans done a byte at a time and vectorized, for at least
+// a second each, and prints the throughput of the fastest pass
+static int ParseBenchmark( const char *fileName )
+{
+	MappedFile file;
+	if( !file.Open( fileName ) ) {
+		fprintf( stderr, "ERROR opening file %s\n", fileName );
 		return 1;
 	}
 
+	double rate[2];
+	for( int vector=0;vector<2;vector++ ) {
+		NVSHARE::InPlaceParser parser;
+		parser.SetVectorScan( vector != 0 );
+
+		ParseCounter counter;
+		int passes = 0;
+		clock_t total = 0;
+		clock_t best = 0;
+		do {
+			counter = ParseCounter();
+			clock_t start = clock();
+			parser.ParseChunked( (const char *) file.GetData(), (size_t) file.GetSize(), &counter );
+			clock_t elapsed = clock() - start;
+
+			if( !passes || elapsed < best )
+				best = elapsed;
+			total += elapsed;
+			passes++;
+		} while( total < CLOCKS_PER_SEC || passes < 3 );
+
+		double secs = double(best > 0 ? best : 1) / CLOCKS_PER_SEC;
+		rate[vector] = double(file.GetSize()) / secs / 1e9;
+		printf( "%s: %llu lines, %llu args, %d passes, %.3f GB/s\n", vector ? "vectorized" : "bytewise  ",
+			counter.Lines, counter.Args, passes, rate[vector] );
+	}
+
+	printf( "speedup: %.2fx\n", rate[1] / rate[0] );
+	return 0;
+}
+
+// std::allocator that adds up what it hands out, for the memory use of std::map
+template<class T> class CountingAllocator : public std::allocator<T>
+{
+public:
+	template<class U> struct rebind { typedef CountingAllocator<U> other; };
+
+	unsigned long long *Bytes;
+
+	CountingAllocator( unsigned long long *bytes ) : Bytes( bytes ) {}
+	template<class U> CountingAllocator( const CountingAllocator<U> &other ) : Bytes( other.Bytes ) {}
+
+	T *allocate( size_t n, const void *hint = 0 )
+	{
+		*Bytes += n * sizeof(T);
+		return std::allocator<T>().allocate( n );
+	}
+
+	void deallocate( T *p, size_t n )
+	{
+		*Bytes -= n * sizeof(T);
+		std::allocator<T>().deallocate( p, n );
+	}
+};
+
+// how names were interned before StringPool: a map from the string to its id, the strings by
+// id, and a heap copy of each
+class MapStrings
+{
+	typedef std::map<sStringRef, sInt, std::less<sStringRef>, CountingAllocator<std::pair<const sStringRef, sInt> > > IndexMap;
+
+	IndexMap Index;
+	sArray<sStringRef> Strings;
+	unsigned long long CopyBytes;
+
+public:
+	unsigned long long MapBytes;
+
+	MapStrings() : Index( std::less<sStringRef>(), IndexMap::allocator_type( &MapBytes ) ) { MapBytes = 0; CopyBytes = 0; }
+	~MapStrings()
+	{
+		for( sInt i=0;i<Strings.size();i++ )
+			delete[] Strings[i].Str;
+	}
+
+	sInt Intern( const sChar *s, sInt len )
+	{
+		IndexMap::iterator it = Index.find( sStringRef( s, len ) );
+		if( it != Index.end() )
+			return it->second;
+
+		sChar *copy = new sChar[len+1];
+		sCopyMem( copy, s, len );
+		copy[len] = 0;
+		CopyBytes += len + 1;
+
+		sInt index = Strings.size();
+		Index.insert( std::make_pair( sStringRef( copy, len ), index ) );
+		Strings.push_back( sStringRef( copy, len ) );
+		return index;
+	}
+
+	sInt GetCount() const { return Strings.size(); }
+	unsigned long long GetBytes() const { return MapBytes + CopyBytes + Strings.capacity() * sizeof(sStringRef); }
+};
+
+// interns the names of all symbols of an input file, as the readers do, into a StringPool
+// and into a std::map for at least a second each, and prints the throughput of the fastest
+// pass and the memory it took
+static int InternBenchmark( char *fileName )
+{
 	DebugInfo info;
+	std::string key;
+	info.Init();
+	if( !ReadInput( fileName, info, 0, key ) ) {
+		fprintf( stderr, "ERROR reading file %s\n", fileName );
+		return 1;
+	}
 
-	clock_t time1 = clock();
+	const StringPool &strings = info.GetStrings();
+	sArray<sStringRef> names;
+	names.reserve( info.Symbols.size() * 2 );
+	for( sInt i=0;i<info.Symbols.size();i++ ) {
+		names.push_back( strings.Get( info.Symbols.name[i] ) );
+		names.push_back( strings.Get( info.Symbols.mangledName[i] ) );
+	}
+
+	double rate[2];
+	for( int pool=0;pool<2;pool++ ) {
+		int passes = 0;
+		int unique = 0;
+		unsigned long long bytes = 0;
+		clock_t total = 0;
+		clock_t best = 0;
+		do {
+			StringPool *poolStrings = pool ? new StringPool : 0;
+			MapStrings *mapStrings = pool ? 0 : new MapStrings;
+
+			clock_t start = clock();
+			for( sInt i=0;i<names.size();i++ ) {
+				if( pool )
+					poolStrings->Intern( names[i].Str, names[i].Len );
+				else
+					mapStrings->Intern( names[i].Str, names[i].Len );
+			}
+			clock_t elapsed = clock() - start;
+
+			unique = pool ? poolStrings->GetCount() : mapStrings->GetCount();
+			bytes = pool ? poolStrings->GetArenaBytes() + poolStrings->GetTableBytes() : mapStrings->GetBytes();
+			delete poolStrings;
+			delete mapStrings;
+
+			if( !passes || elapsed < best )
+				best = elapsed;
+			total += elapsed;
+			passes++;
+		} while( total < CLOCKS_PER_SEC || passes < 3 );
+
+		double secs = double(best > 0 ? best : 1) / CLOCKS_PER_SEC;
+		rate[pool] = double(names.size()) / secs / 1e6;
+		printf( "%s: %d names, %d unique, %d passes, %.2f M names/s, %.1f bytes per unique name\n",
+			pool ? "string pool" : "std::map   ", (int) names.size(), unique, passes, rate[pool], unique ? double(bytes) / unique : 0.0 );
+	}
+
+	printf( "speedup: %.2fx\n", rate[1] / rate[0] );
+	info.Exit();
+	return 0;
+}
+
+// a decimal number from 1 to INT_MAX, and nothing else
+static bool ParsePositive( const char *str, int &value )
+{
+	char *end;
+	errno = 0;
+	long v = isdigit( (unsigned char) str[0] ) ? strtol( str, &end, 10 ) : 0;
+	if( v <= 0 || *end || errno || v > INT_MAX )
+		return false;
+
+	value = (int) v;
+	return true;
+}
+
+static bool SaveSnapshot( char *saveName, DebugInfo &info )
+{
+	fprintf( stderr, "Saving snapshot %s ...\n", saveName );
+	if( DebugInfoSnapshot::Save( saveName, info ) )
+		return true;
+
+	fprintf( stderr, "ERROR saving snapshot %s\n", saveName );
+	return false;
+}
+
+// reads and analyzes two debug info files at the same time
+class ReadJobs : public ParallelJobs
+{
+public:
+	char *FileNames[2];
+	DebugInfo *Infos[2];
+	bool Ok[2];
+	DebugInfoCache *Cache;
+	std::string Keys[2];
+
+protected:
+	void RunJob( sInt index )
+	{
+		Ok[index] = ReadInput( FileNames[index], *Infos[index], Cache, Keys[index] );
+		if( Ok[index] ) {
+			Infos[index]->StartAnalyze();
+			Infos[index]->FinishAnalyze();
+		}
+	}
+};
+
+static bool ReadDiff( DebugInfo &info, char *fileName, char *oldName, char *saveName, DebugInfoCache *cache, ReportWriter &report )
+{
+	DebugInfo oldInfo;
+	oldInfo.Init();
+	oldInfo.Symbols.SetPacked( info.Symbols.IsPacked() );
+
+	fprintf( stderr, "Reading debug info files %s and %s ...\n", oldName, fileName );
+	ReadJobs jobs;
+	jobs.FileNames[0] = oldName;
+	jobs.Infos[0] = &oldInfo;
+	jobs.FileNames[1] = fileName;
+	jobs.Infos[1] = &info;
+	jobs.Cache = cache;
+	jobs.Run( 2, 2 );
+
+	if( cache ) {
+		sArray<std::string> keep( jobs.Keys, jobs.Keys + 2 );
+		cache->Trim( keep );
+	}
+
+	bool ok = jobs.Ok[0] && jobs.Ok[1];
+	for( int i=0;i<2;i++ ) {
+		if( !jobs.Ok[i] )
+			fprintf( stderr, "ERROR reading file %s\n", jobs.FileNames[i] );
+	}
+
+	if( ok && saveName )
+		ok = SaveSnapshot( saveName, info );
+
+	if( ok ) {
+		fprintf( stderr, "\n%d -> %d symbols\n", (int) oldInfo.Symbols.size(), (int) info.Symbols.size() );
+		fprintf( stderr, "Comparing...\n" );
+		SizeDiff diff( oldInfo, info );
+		diff.Compare();
+
+		fprintf( stderr, "Generating report...\n" );
+		diff.WriteReport( report );
+		report.Close();
+	}
+
+	oldInfo.Exit();
+	return ok;
+}
+
+int main( int argc, char** argv )
+{
+	DebugInfo info;
+	char *fileName = 0;
+	char *outName = 0;
+	char *profileName = 0;
+	char *oldName = 0;
+	char *saveName = 0;
+	char *cacheDir = 0;
+	int cacheMB = 1024;
 
 	info.Init();
-	PDBFileReader pdb;
-	fprintf( stderr, "Reading debug info file %s ...\n", argv[1] );
-	bool pdbok = pdb.ReadDebugInfo( argv[1], info );
-	if( !pdbok ) {
-		fprintf( stderr, "ERROR reading file via PDB\n" );
+
+	for( int i=1;i<argc;i++ )
+	{
+		if( !strcmp( argv[i], "-top" ) && i+1 < argc )
+		{
+			char *count = argv[++i];
+			char *section = 0;
+			char *eq = strchr( count, '=' );
+			if( eq ) {
+				*eq = 0;
+				section = count;
+				count = eq + 1;
+			}
+
+			int maxCount;
+			if( !ParsePositive( count, maxCount ) ) {
+				fprintf( stderr, "Entry count '%s' is not a positive number\n", count );
+				return PrintUsage();
+			}
+			if( !info.SetReportMaxCount( section, maxCount ) ) {
+				fprintf( stderr, "Unknown report section '%s'\n", section );
+				return PrintUsage();
+			}
+		}
+		else if( !strcmp( argv[i], "-o" ) && i+1 < argc )
+			outName = argv[++i];
+		else if( !strcmp( argv[i], "-cache" ) && i+1 < argc )
+			cacheDir = argv[++i];
+		else if( !strcmp( argv[i], "-cachesize" ) && i+1 < argc ) {
+			if( !ParsePositive( argv[++i], cacheMB ) ) {
+				fprintf( stderr, "Cache size '%s' is not a positive number of MB\n", argv[i] );
+				return PrintUsage();
+			}
+		}
+		else if( !strcmp( argv[i], "-save" ) && i+1 < argc )
+			saveName = argv[++i];
+		else if( !strcmp( argv[i], "-diff" ) && i+1 < argc )
+			oldName = argv[++i];
+		else if( !strcmp( argv[i], "-profile" ) && i+1 < argc )
+			profileName = argv[++i];
+		else if( !strcmp( argv[i], "-packed" ) )
+			info.Symbols.SetPacked( true );
+		else if( !strcmp( argv[i], "-parsebench" ) && i+1 < argc )
+			return ParseBenchmark( argv[++i] );
+		else if( !strcmp( argv[i], "-internbench" ) && i+1 < argc )
+			return InternBenchmark( argv[++i] );
+		else if( !strcmp( argv[i], "-sortbench" ) )
+			return NVSHARE::sortBenchmark();
+		else if( argv[i][0] == '-' || fileName )
+			return PrintUsage();
+		else
+			fileName = argv[i];
+	}
+
+	if( !fileName || oldName && profileName )
+		return PrintUsage();
+
+	ReportWriter report;
+	if( !outName )
+		report.Open( stdout );
+	else if( !report.Open( outName ) ) {
+		fprintf( stderr, "ERROR opening output file %s\n", outName );
+		return 1;
+	}
+
+	DebugInfoCache *cache = 0;
+	if( cacheDir )
+		cache = new DebugInfoCache( cacheDir, (sU64) cacheMB << 20 );
+
+	clock_t time1 = clock();
+
+	if( oldName ) {
+		if( !ReadDiff( info, fileName, oldName, saveName, cache, report ) )
+			return 1;
+
+		fprintf( stderr, "Done in %.2f seconds!\n", float(clock()-time1) / CLOCKS_PER_SEC );
+		delete cache;
+		info.Exit();
+		return 0;
+	}
+
+	fprintf( stderr, "Reading debug info file %s ...\n", fileName );
+	std::string key;
+	if( !ReadInput( fileName, info, cache, key ) ) {
+		fprintf( stderr, "ERROR reading file %s\n", fileName );
 		return 1;
 	}
+	if( cache ) {
+		sArray<std::string> keep( 1, key );
+		cache->Trim( keep );
+	}
+
+	if( saveName && !SaveSnapshot( saveName, info ) )
+		return 1;
+
+	if( profileName ) {
+		ProfileReader profile;
+		fprintf( stderr, "Reading profile %s ...\n", profileName );
+		if( !profile.ReadProfile( profileName, info ) ) {
+			fprintf( stderr, "ERROR reading profile %s\n", profileName );
+			return 1;
+		}
+		fprintf( stderr, "%llu samples, %llu outside any symbol", (unsigned long long) info.GetSampleCount(),
+			(unsigned long long) info.GetUnattributedSampleCount() );
+		if( profile.GetBadLineCount() )
+			fprintf( stderr, ", %llu lines skipped", (unsigned long long) profile.GetBadLineCount() );
+		fprintf( stderr, "\n" );
+	}
+
 	fprintf( stderr, "\nProcessing info...\n" );
-	info.FinishedReading();
 	info.StartAnalyze();
 	info.FinishAnalyze();
 
 	fprintf( stderr, "Generating report...\n" );
-	std::string report = info.WriteReport();
+	info.WriteReport( report );
+	report.Close();
 
 	clock_t time2 = clock();
 	float secs = float(time2-time1) / CLOCKS_PER_SEC;
 
-	fprintf( stderr, "Printing...\n" );
-	puts( report.c_str() );
 	fprintf( stderr, "Done in %.2f seconds!\n", secs );
 
+	delete cache;
+	info.Exit();
 
 	return 0;
 }
@@ -0,0 +1,677 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#pragma warning(disable:4996)
+#include "types.hpp"
+#include "debuginfo.hpp"
+#include "mapfile.hpp"
+#include "mappedfile.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+/****************************************************************************/
+
+static const sInt SniffSize = 4096;
+
+// parses hex digits (after an optional "0x" if prefixed), returns the end
+// or 0 if there are none
+static const sChar *ParseHex(const sChar *p,sU64 &value,sBool prefixed)
+{
+  if(prefixed)
+  {
+    if(p[0] != '0' || (p[1] != 'x' && p[1] != 'X'))
+      return 0;
+    p += 2;
+  }
+
+  const sChar *start = p;
+  sU64 v = 0;
+  for(;;p++)
+  {
+    sChar c = *p;
+    if(c >= '0' && c <= '9')      v = (v << 4) | (c - '0');
+    else if(c >= 'a' && c <= 'f') v = (v << 4) | (c - 'a' + 10);
+    else if(c >= 'A' && c <= 'F') v = (v << 4) | (c - 'A' + 10);
+    else break;
+  }
+
+  value = v;
+  return (p != start) ? p : 0;
+}
+
+// a whole argument that's a "0x" hex number
+static sBool IsHexArg(const sChar *arg,sU64 &value)
+{
+  const sChar *end = ParseHex(arg,value,true);
+  return end && !*end;
+}
+
+static const sChar *SkipSpaces(const sChar *p)
+{
+  while(*p == ' ' || *p == '\t')
+    p++;
+  return p;
+}
+
+static sBool StartsWith(const sChar *str,const sChar *prefix)
+{
+  return !strncmp(str,prefix,sGetStringLen(prefix));
+}
+
+static sBool IsIdentifier(const sChar *str)
+{
+  if(!*str || (*str >= '0' && *str <= '9'))
+    return false;
+
+  for(;*str;str++)
+  {
+    if(!isalnum((sU8) *str) && *str != '_' && *str != '$')
+      return false;
+  }
+  return true;
+}
+
+/****************************************************************************/
+
+MapFileReader::MapFileReader()
+{
+  Reset();
+}
+
+void MapFileReader::Reset()
+{
+  To = 0;
+  Kind = MAP_UNKNOWN;
+  LastObjName.clear();
+  LastObjFile = -1;
+  NoObjFile = -1;
+
+  PreferredBase = 0;
+  Segments.clear();
+  Publics.clear();
+
+  InMemoryMap = false;
+  Indent = 0;
+  OutSection.clear();
+  OutSectionUsed = false;
+  PendingName.clear();
+  PendingIsOutput = false;
+  HaveCurrent = false;
+  CurrentSymbols.clear();
+  InColumn = -1;
+  SymbolColumn = -1;
+  HexColumns = 0;
+}
+
+// looks for the headers each linker starts its map with
+MapFileReader::Dialect MapFileReader::GetDialect(const sChar *fileName)
+{
+  FILE *f = fopen(fileName,"rb");
+  if(!f)
+    return MAP_UNKNOWN;
+
+  sChar text[SniffSize + 1];
+  sInt len = (sInt) fread(text,1,SniffSize,f);
+  fclose(f);
+
+  // text files only
+  if(len <= 0 || memchr(text,0,len))
+    return MAP_UNKNOWN;
+  text[len] = 0;
+
+  if(strstr(text,"Preferred load address is"))
+    return MAP_MSVC;
+
+  if(strstr(text,"Linker script and memory map") || strstr(text,"Memory Configuration")
+    || strstr(text,"Archive member included") || strstr(text,"Discarded input sections")
+    || strstr(text,"Allocating common symbols"))
+    return MAP_GNU;
+
+  const sChar *header = SkipSpaces(text);
+  if(StartsWith(header,"VMA ") || StartsWith(header,"Address "))
+  {
+    const sChar *eol = strchr(header,'\n');
+    const sChar *symbol = strstr(header," Symbol");
+    if(symbol && (!eol || symbol < eol) && strstr(header," Out ") && strstr(header," In "))
+      return MAP_LLD;
+  }
+
+  return MAP_UNKNOWN;
+}
+
+sBool MapFileReader::IsMapFile(const sChar *fileName)
+{
+  return GetDialect(fileName) != MAP_UNKNOWN;
+}
+
+sInt MapFileReader::GetSectionClass(const sChar *name)
+{
+  if(StartsWith(name,".text") || !strcmp(name,".init") || !strcmp(name,".fini")
+    || StartsWith(name,".plt") || !strcmp(name,".iplt"))
+    return DIC_CODE;
+
+  if(StartsWith(name,".bss") || StartsWith(name,".tbss") || StartsWith(name,".sbss")
+    || StartsWith(name,".lbss") || !strcmp(name,".dynbss") || !strcmp(name,"COMMON"))
+    return DIC_BSS;
+
+  return DIC_DATA;
+}
+
+// sections that aren't loaded, which take no room in the image
+sBool MapFileReader::IsDebugSection(const sChar *name)
+{
+  static const sChar *prefixes[] =
+  {
+    ".debug", ".zdebug", ".comment", ".stab", ".gnu_debuglink", ".gnu.attributes",
+    ".gnu.build.attributes", ".ARM.attributes", ".riscv.attributes", ".note.GNU-stack",
+    ".GCC.command.line", ".gnu.warning", "/DISCARD/"
+  };
+
+  for(sInt i=0;i<sizeof(prefixes)/sizeof(*prefixes);i++)
+  {
+    if(StartsWith(name,prefixes[i]))
+      return true;
+  }
+  return false;
+}
+
+sInt MapFileReader::GetObjFile(const sChar *name,sInt len)
+{
+  if(!len)
+  {
+    if(NoObjFile < 0)
+      NoObjFile = To->GetFileByName("<noobjfile>");
+    return NoObjFile;
+  }
+
+  if(LastObjFile < 0 || LastObjName.compare(0,std::string::npos,name,len) != 0)
+  {
+    LastObjName.assign(name,len);
+    LastObjFile = To->GetFile(To->MakeString(LastObjName.c_str()));
+  }
+  return LastObjFile;
+}
+
+void MapFileReader::AddSymbol(sU64 VA,sU64 size,const sChar *name,sInt len)
+{
+  if(!HaveCurrent || !len)
+    return;
+
+  NameScratch.assign(name,len);
+
+  MapSymbol sym;
+  sym.VA = VA;
+  sym.Size = size;
+  sym.Key = VA;
+  sym.MangledName = To->MakeString(NameScratch.c_str());
+  sym.Name = sym.MangledName;
+  sym.ObjFile = -1;
+
+  const sChar *cleanName = Demangler.Clean(NameScratch.c_str());
+  if(cleanName)
+    sym.Name = To->MakeString(cleanName);
+
+  CurrentSymbols.push_back(sym);
+}
+
+// Covers bytes of the current contribution that no listed symbol does. With
+// -ffunction-sections and -fdata-sections the section name ends in the
+// (mangled) name of its only function or variable, so that's what it's
+// called; otherwise it's the section name.
+void MapFileReader::AddSectionSymbol(sU64 VA,sU64 size)
+{
+  static const sChar *prefixes[] =
+  {
+    ".text.unlikely.", ".text.hot.", ".text.startup.", ".text.exit.", ".text.",
+    ".data.rel.ro.local.", ".data.rel.ro.", ".data.rel.local.", ".data.rel.", ".data.",
+    ".rodata.", ".bss.", ".tdata.", ".tbss.", ".sdata.", ".sbss.", ".ldata.", ".lbss.", ".lrodata."
+  };
+
+  const sChar *section = Current.Section.c_str();
+  const sChar *name = section;
+  const sChar *mangled = strstr(section,"._Z");
+
+  if(mangled)
+    name = mangled + 1;
+  else
+  {
+    for(sInt i=0;i<sizeof(prefixes)/sizeof(*prefixes);i++)
+    {
+      const sChar *rest = section + sGetStringLen(prefixes[i]);
+      if(StartsWith(section,prefixes[i]) && IsIdentifier(rest))
+      {
+        // merged constants (.rodata.cst8) are no variable's
+        if(!StartsWith(rest,"cst") || rest[3] < '0' || rest[3] > '9')
+          name = rest;
+        break;
+      }
+    }
+  }
+
+  DISymbol outSym;
+  outSym.mangledName = To->MakeString(name);
+  outSym.name = outSym.mangledName;
+
+  const sChar *cleanName = mangled ? Demangler.Clean(name) : 0;
+  if(cleanName)
+    outSym.name = To->MakeString(cleanName);
+
+  outSym.objFileNum = Current.ObjFile;
+  outSym.VA = VA;
+  outSym.Size = size;
+  outSym.Class = Current.Class;
+  outSym.NameSpNum = To->GetNameSpaceOf(outSym.name);
+  To->Symbols.push_back(outSym);
+}
+
+void MapFileReader::StartContribution(const sChar *section,sU64 start,sU64 size,const sChar *objFile,sInt objLen)
+{
+  EndContribution();
+  if(!OutSectionUsed || !size)
+    return;
+
+  HaveCurrent = true;
+  Current.Start = start;
+  Current.Size = size;
+  Current.Class = GetSectionClass(OutSection.empty() ? section : OutSection.c_str());
+  Current.ObjFile = GetObjFile(objFile,objLen);
+  Current.Section = section;
+}
+
+// Turns the symbols listed for the current contribution into DISymbols.
+// Symbols without a size end where the next one starts.
+void MapFileReader::EndContribution()
+{
+  if(!HaveCurrent)
+    return;
+
+  HaveCurrent = false;
+  std::stable_sort(CurrentSymbols.begin(),CurrentSymbols.end(),SymbolLess);
+
+  sU64 end = Current.Start + Current.Size;
+  sInt count = 0;
+  for(sInt i=0;i<CurrentSymbols.size();i++)
+  {
+    const MapSymbol &sym = CurrentSymbols[i];
+    if(sym.VA >= Current.Start && sym.VA < end && (!count || sym.VA != CurrentSymbols[count-1].VA))
+      CurrentSymbols[count++] = sym;
+  }
+  CurrentSymbols.resize(count);
+
+  if(!count)
+    AddSectionSymbol(Current.Start,Current.Size);
+  else if(CurrentSymbols[0].VA > Current.Start)
+    AddSectionSymbol(Current.Start,CurrentSymbols[0].VA - Current.Start);
+
+  for(sInt i=0;i<count;i++)
+  {
+    const MapSymbol &sym = CurrentSymbols[i];
+    sU64 next = (i + 1 < count) ? CurrentSymbols[i+1].VA : end;
+
+    DISymbol outSym;
+    outSym.name = sym.Name;
+    outSym.mangledName = sym.MangledName;
+    outSym.objFileNum = Current.ObjFile;
+    outSym.VA = sym.VA;
+    outSym.Size = (sym.Size && sym.Size < end - sym.VA) ? sym.Size : next - sym.VA;
+    outSym.Class = Current.Class;
+    outSym.NameSpNum = To->GetNameSpaceOf(sym.Name);
+    To->Symbols.push_back(outSym);
+  }
+
+  CurrentSymbols.clear();
+}
+
+void MapFileReader::StartOutSection(const sChar *name,sU64 start)
+{
+  EndContribution();
+  OutSection = name;
+  OutSectionUsed = !IsDebugSection(name);
+}
+
+/****************************************************************************/
+
+// "Preferred load address is <base>" up top, then the section entries
+//   0001:00000000 00012345H .text$mn                CODE
+// then publics and statics:
+//   0001:00000040       ?foo@@YAXXZ       0000000140001040 f i lib:foo.obj
+void MapFileReader::ParseMsvcLine(sInt argc,const sChar **argv)
+{
+  if(argc >= 5 && !strcmp(argv[0],"Preferred") && !strcmp(argv[3],"is"))
+  {
+    ParseHex(argv[4],PreferredBase,false);
+    return;
+  }
+
+  sU64 section,offset;
+  const sChar *colon = ParseHex(argv[0],section,false);
+  if(argc < 4 || !colon || *colon != ':' || colon - argv[0] != 4)
+    return;
+
+  const sChar *end = ParseHex(colon + 1,offset,false);
+  if(!end || *end || !section)
+    return;
+
+  sU64 key = (section << 32) | offset;
+  sU64 value;
+  end = ParseHex(argv[1],value,false);
+
+  if(argc == 4 && end && end[0] == 'H' && !end[1])
+  {
+    Contribution seg;
+    seg.Start = key;
+    seg.Size = value;
+    if(!strcmp(argv[3],"CODE"))
+      seg.Class = DIC_CODE;
+    else
+      seg.Class = StartsWith(argv[2],".bss") ? DIC_BSS : DIC_DATA;
+    seg.ObjFile = -1;
+    seg.Section = argv[2];
+    Segments.push_back(seg);
+    return;
+  }
+
+  end = ParseHex(argv[2],value,false);
+  if(!end || *end)
+    return;
+
+  // flags ("f" function, "i" inlined) come before the object, if any
+  const sChar *obj = argv[argc-1];
+  if(argc == 3 || !strcmp(obj,"f") || !strcmp(obj,"i"))
+    obj = "";
+
+  MapSymbol sym;
+  sym.Key = key;
+  sym.VA = (value >= PreferredBase) ? value - PreferredBase : value;
+  sym.Size = 0;
+  sym.MangledName = To->MakeString(argv[1]);
+  sym.Name = sym.MangledName;
+  sym.ObjFile = GetObjFile(obj,sGetStringLen(obj));
+  Publics.push_back(sym);
+}
+
+// Publics don't have sizes; each one ends at the next one or at the end of
+// the section entry it's in.
+void MapFileReader::FinishMsvc()
+{
+  std::sort(Segments.begin(),Segments.end(),ContributionLess);
+  std::stable_sort(Publics.begin(),Publics.end(),SymbolLess);
+
+  AddressIndex index;
+  for(sInt i=0;i<Segments.size();i++)
+    index.Add(Segments[i].Start,Segments[i].Size);
+  index.Build();
+
+  for(sInt i=0;i<Publics.size();i++)
+  {
+    const MapSymbol &sym = Publics[i];
+    sInt seg = index.Find(sym.Key);
+    if(seg < 0 || (i && Publics[i-1].Key == sym.Key))
+      continue;
+
+    sU64 end = Segments[seg].Start + Segments[seg].Size;
+    sInt next = i + 1;
+    while(next < Publics.size() && Publics[next].Key == sym.Key)
+      next++;
+    if(next < Publics.size() && Publics[next].Key < end)
+      end = Publics[next].Key;
+
+    DISymbol outSym;
+    outSym.name = sym.Name;
+    outSym.mangledName = sym.MangledName;
+    outSym.objFileNum = sym.ObjFile;
+    outSym.VA = sym.VA;
+    outSym.Size = end - sym.Key;
+    outSym.Class = Segments[seg].Class;
+    outSym.NameSpNum = To->GetNameSpaceOf(sym.Name);
+    To->Symbols.push_back(outSym);
+  }
+
+  Segments.clear();
+  Publics.clear();
+}
+
+/****************************************************************************/
+
+// Output sections start in the first column, input sections in the second:
+//   .text           0x0000000000001040      0x1b5
+//    .text          0x0000000000001040       0x26 main.o
+//    .text._ZL3foov
+//                   0x0000000000001066       0x12 main.o
+// Names that don't fit their column continue on the next line. Symbol
+// lines are handled by ParseGnuSymbol.
+void MapFileReader::ParseGnuLine(sInt argc,const sChar **argv)
+{
+  sU64 start,size;
+
+  if(!PendingName.empty())
+  {
+    sBool ok = argc >= 2 && IsHexArg(argv[0],start) && IsHexArg(argv[1],size);
+    if(ok && PendingIsOutput)
+      StartOutSection(PendingName.c_str(),start);
+    else if(ok)
+    {
+      NameScratch.clear();
+      for(sInt i=2;i<argc;i++)
+        NameScratch.append(i > 2 ? " " : "").append(argv[i]);
+      std::string objFile = NameScratch;
+      StartContribution(PendingName.c_str(),start,size,objFile.c_str(),objFile.size());
+    }
+
+    PendingName.clear();
+    if(ok)
+      return;
+  }
+
+  if(Indent == 0)
+  {
+    EndContribution();
+    OutSectionUsed = false;
+
+    if(argc == 1)
+    {
+      PendingName = argv[0];
+      PendingIsOutput = true;
+    }
+    else if(IsHexArg(argv[1],start))
+      StartOutSection(argv[0],start);
+    else if(argc >= 3 && !strcmp(argv[0],"Cross") && !strcmp(argv[1],"Reference"))
+      InMemoryMap = false;
+  }
+  else if(Indent == 1 && OutSectionUsed && argv[0][0] != '*')
+  {
+    if(argc == 1)
+    {
+      PendingName = argv[0];
+      PendingIsOutput = false;
+    }
+    else if(argc >= 3 && IsHexArg(argv[1],start) && IsHexArg(argv[2],size))
+    {
+      // object file names may contain spaces
+      NameScratch.clear();
+      for(sInt i=3;i<argc;i++)
+        NameScratch.append(i > 3 ? " " : "").append(argv[i]);
+      std::string objFile = NameScratch;
+      StartContribution(argv[0],start,size,objFile.c_str(),objFile.size());
+    }
+  }
+}
+
+// "                0x0000000000001040                main" - the name is
+// demangled and may contain spaces. Assignments to symbols look the same
+// but have a " = ".
+void MapFileReader::ParseGnuSymbol(const sChar *line)
+{
+  sU64 VA;
+  const sChar *p = ParseHex(SkipSpaces(line),VA,true);
+  if(!p || (*p != ' ' && *p != '\t'))
+    return;
+
+  const sChar *name = SkipSpaces(p);
+  if(StartsWith(name,"0x") || StartsWith(name,"PROVIDE") || StartsWith(name,"ASSERT") || strstr(name," = "))
+    return;
+
+  // cut the version off "memcpy@@GLIBC_2.14"
+  sInt len = sGetStringLen(name);
+  const sChar *version = strchr(name,'@');
+  if(version)
+    len = version - name;
+  while(len && (name[len-1] == ' ' || name[len-1] == '\t'))
+    len--;
+
+  AddSymbol(VA,0,name,len);
+}
+
+/****************************************************************************/
+
+// Everything is in columns under a header line:
+//      VMA      LMA     Size Align Out     In      Symbol
+//     1000     1000      1b5    16 .text
+//     1000     1000       26     4         main.o:(.text)
+//     1000     1000        0     1                 main
+// Older versions have "Address Size Align" instead.
+void MapFileReader::ParseLldLine(const sChar *line)
+{
+  if(InColumn < 0)
+  {
+    const sChar *in = strstr(line," In ");
+    const sChar *symbol = strstr(line," Symbol");
+    if(in && symbol && strstr(line," Out "))
+    {
+      InColumn = in + 1 - line;
+      SymbolColumn = symbol + 1 - line;
+      HexColumns = strstr(line,"LMA") ? 4 : 3;
+    }
+    return;
+  }
+
+  sU64 values[4];
+  const sChar *p = line;
+  for(sInt i=0;i<HexColumns;i++)
+  {
+    p = ParseHex(SkipSpaces(p),values[i],false);
+    if(!p || (*p != ' ' && *p != '\t'))
+      return;
+  }
+
+  p = SkipSpaces(p);
+  sInt column = p - line;
+  sU64 VA = values[0];
+  sU64 size = values[HexColumns-2];
+  if(!*p || strstr(p," = "))
+    return;
+
+  if(column >= SymbolColumn)
+    AddSymbol(VA,size,p,sGetStringLen(p));
+  else if(column >= InColumn)
+  {
+    // "file.o:(.text.foo)", "lib.a(file.o):(.text)", "<internal>:(.bss)"
+    const sChar *section = 0;
+    for(const sChar *s = strstr(p,":(");s;s = strstr(s + 1,":("))
+      section = s;
+
+    if(!section)
+    {
+      StartContribution(p,VA,size,"",0);
+      return;
+    }
+
+    NameScratch.assign(section + 2);
+    if(!NameScratch.empty() && NameScratch[NameScratch.size()-1] == ')')
+      NameScratch.resize(NameScratch.size()-1);
+    std::string sectionName = NameScratch;
+    StartContribution(sectionName.c_str(),VA,size,p,section - p);
+  }
+  else
+    StartOutSection(p,VA);
+}
+
+/****************************************************************************/
+
+int MapFileReader::ParseLine(int lineno,int argc,const char **argv)
+{
+  if(Kind == MAP_MSVC)
+    ParseMsvcLine(argc,argv);
+  else if(Kind == MAP_GNU)
+    ParseGnuLine(argc,argv);
+
+  return 1;
+}
+
+bool MapFileReader::preParseLine(int lineno,const char *line)
+{
+  switch(Kind)
+  {
+  case MAP_GNU:
+    if(!InMemoryMap)
+    {
+      // memory configuration, discarded sections etc. come first
+      InMemoryMap = StartsWith(line,"Linker script and memory map");
+      return true;
+    }
+
+    Indent = 0;
+    while(line[Indent] == ' ')
+      Indent++;
+
+    if(Indent > 1 && PendingName.empty())
+    {
+      ParseGnuSymbol(line);
+      return true;
+    }
+    return false;
+
+  case MAP_LLD:
+    ParseLldLine(line);
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+sBool MapFileReader::ReadDebugInfo(sChar *fileName,DebugInfo &to)
+{
+  Reset();
+  To = &to;
+  Kind = GetDialect(fileName);
+  if(Kind == MAP_UNKNOWN)
+  {
+    fprintf(stderr,"  %s is not a map file\n",fileName);
+    return false;
+  }
+
+  // straight from the mapping if we can; otherwise read it a chunk at a time
+  NVSHARE::InPlaceParser parser;
+  MappedFile file;
+  if(file.Open(fileName))
+    parser.ParseChunked((const char *) file.GetData(),file.GetSize(),this);
+  else
+  {
+    FILE *f = fopen(fileName,"rb");
+    if(!f)
+    {
+      fprintf(stderr,"  failed to open %s\n",fileName);
+      return false;
+    }
+
+    parser.ParseChunked(f,this);
+    fclose(f);
+  }
+
+  EndContribution();
+  if(Kind == MAP_MSVC)
+    FinishMsvc();
+
+  To = 0;
+  if(!to.Symbols.size())
+  {
+    fprintf(stderr,"  no symbols found in %s\n",fileName);
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,125 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __MAPFILE_HPP__
+#define __MAPFILE_HPP__
+
+#include "types.hpp"
+#include "debuginfo.hpp"
+#include "addressindex.hpp"
+#include "inparser.h"
+#include <string>
+
+/****************************************************************************/
+
+// Reads the map files linkers write next to executables: MSVC (/MAP), GNU
+// ld (-Map) and lld (--Map). They have no debug info, but they name every
+// input section with its object file, and the symbols in it.
+//
+// MSVC maps give symbol addresses only; sizes run up to the next symbol or
+// the end of the section entry it's in. Names stay decorated, like PDB
+// publics, and are undecorated in the report. GNU and lld maps list input
+// sections (a contribution of an object file) with the symbols defined in
+// them; sizes come from the next symbol in the same contribution or lld's
+// size column. Bytes of a contribution before its first symbol (all of it
+// if no symbols are listed, as for static functions and data) get a symbol
+// named after the section, which with -ffunction-sections/-fdata-sections
+// is the mangled name of what's in it.
+//
+// The file is parsed a chunk of lines at a time (see InPlaceParser::
+// ParseChunked), straight from a mapping, or read through a buffer if it
+// can't be mapped, so huge maps never need a copy of their own.
+
+class MapFileReader : public DebugInfoReader, private NVSHARE::InPlaceParserInterface
+{
+  enum Dialect
+  {
+    MAP_UNKNOWN,
+    MAP_MSVC,
+    MAP_GNU,
+    MAP_LLD
+  };
+
+  struct MapSymbol
+  {
+    sU64 VA;
+    sU64 Size;                      // 0 = up to the next symbol
+    sU64 Key;                       // MSVC: section << 32 | offset
+    sInt Name;
+    sInt MangledName;
+    sInt ObjFile;                   // MSVC only
+  };
+
+  // an input section of one object file (GNU, lld) or a section entry of
+  // the segment table (MSVC)
+  struct Contribution
+  {
+    sU64 Start;
+    sU64 Size;
+    sInt Class;
+    sInt ObjFile;
+    std::string Section;
+  };
+
+  DebugInfo *To;
+  Dialect Kind;
+  NameDemangler Demangler;
+  std::string NameScratch;
+  std::string LastObjName;          // object files come in runs
+  sInt LastObjFile;
+  sInt NoObjFile;
+
+  // MSVC
+  sU64 PreferredBase;
+  sArray<Contribution> Segments;
+  sArray<MapSymbol> Publics;
+
+  // GNU, lld
+  sBool InMemoryMap;                // GNU: past the header of the memory map
+  sInt Indent;                      // of the line ParseLine gets
+  std::string OutSection;           // current output section
+  sBool OutSectionUsed;             // loaded, not debug info and such
+  std::string PendingName;          // GNU: name wrapped onto its own line
+  sBool PendingIsOutput;
+  sBool HaveCurrent;
+  Contribution Current;
+  sArray<MapSymbol> CurrentSymbols;
+  sInt InColumn;                    // lld: column of "In" and "Symbol"
+  sInt SymbolColumn;
+  sInt HexColumns;                  // lld: 4 with LMA, 3 without
+
+  static Dialect GetDialect(const sChar *fileName);
+  static sInt GetSectionClass(const sChar *name);
+  static sBool IsDebugSection(const sChar *name);
+  static sBool SymbolLess(const MapSymbol &a,const MapSymbol &b)            { return a.Key < b.Key; }
+  static sBool ContributionLess(const Contribution &a,const Contribution &b) { return a.Start < b.Start; }
+
+  void Reset();
+  sInt GetObjFile(const sChar *name,sInt len);
+  void AddSymbol(sU64 VA,sU64 size,const sChar *name,sInt len);
+  void AddSectionSymbol(sU64 VA,sU64 size);
+  void StartContribution(const sChar *section,sU64 start,sU64 size,const sChar *objFile,sInt objLen);
+  void EndContribution();
+  void StartOutSection(const sChar *name,sU64 start);
+
+  void ParseMsvcLine(sInt argc,const sChar **argv);
+  void ParseGnuLine(sInt argc,const sChar **argv);
+  void ParseGnuSymbol(const sChar *line);
+  void ParseLldLine(const sChar *line);
+  void FinishMsvc();
+
+  // NVSHARE::InPlaceParserInterface
+  int ParseLine(int lineno,int argc,const char **argv);
+  bool preParseLine(int lineno,const char *line);
+
+public:
+  MapFileReader();
+
+  static sBool IsMapFile(const sChar *fileName);
+  sBool ReadDebugInfo(sChar *fileName,DebugInfo &to);
+};
+
+/****************************************************************************/
+
+#endif
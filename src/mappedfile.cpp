@@ -0,0 +1,125 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#include "types.hpp"
+#include "mappedfile.hpp"
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/****************************************************************************/
+
+MappedFile::MappedFile()
+{
+  Data = 0;
+  Size = 0;
+
+#if defined(WIN32)
+  FileHandle = INVALID_HANDLE_VALUE;
+  MappingHandle = 0;
+#else
+  FileHandle = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+#if defined(WIN32)
+
+sBool MappedFile::Open(const sChar *fileName)
+{
+  Close();
+
+  FileHandle = CreateFileA(fileName,GENERIC_READ,FILE_SHARE_READ,0,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,0);
+  if(FileHandle == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if(!GetFileSizeEx(FileHandle,&size) || size.QuadPart == 0 || sU64(size.QuadPart) != SIZE_T(size.QuadPart))
+  {
+    Close();
+    return false;
+  }
+
+  MappingHandle = CreateFileMappingA(FileHandle,0,PAGE_READONLY,0,0,0);
+  if(MappingHandle)
+    Data = (const sU8 *) MapViewOfFile(MappingHandle,FILE_MAP_READ,0,0,0);
+
+  if(!Data)
+  {
+    Close();
+    return false;
+  }
+
+  Size = size.QuadPart;
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if(Data)
+    UnmapViewOfFile(Data);
+  if(MappingHandle)
+    CloseHandle(MappingHandle);
+  if(FileHandle != INVALID_HANDLE_VALUE)
+    CloseHandle(FileHandle);
+
+  Data = 0;
+  Size = 0;
+  FileHandle = INVALID_HANDLE_VALUE;
+  MappingHandle = 0;
+}
+
+#else
+
+sBool MappedFile::Open(const sChar *fileName)
+{
+  Close();
+
+  FileHandle = open(fileName,O_RDONLY);
+  if(FileHandle < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(FileHandle,&st) != 0 || st.st_size == 0 || sU64(st.st_size) != size_t(st.st_size))
+  {
+    Close();
+    return false;
+  }
+
+  void *data = mmap(0,st.st_size,PROT_READ,MAP_PRIVATE,FileHandle,0);
+  if(data == MAP_FAILED)
+  {
+    Close();
+    return false;
+  }
+
+  Data = (const sU8 *) data;
+  Size = st.st_size;
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if(Data)
+    munmap((void *) Data,Size);
+  if(FileHandle >= 0)
+    close(FileHandle);
+
+  Data = 0;
+  Size = 0;
+  FileHandle = -1;
+}
+
+#endif
+
+/****************************************************************************/
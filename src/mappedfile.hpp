@@ -0,0 +1,41 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __MAPPEDFILE_HPP__
+#define __MAPPEDFILE_HPP__
+
+#include "types.hpp"
+
+/****************************************************************************/
+
+// Read-only memory mapping of a whole file. Opening fails if the file
+// doesn't fit into the address space (big PDBs in 32-bit builds), callers
+// are expected to fall back to plain reads then.
+
+class MappedFile
+{
+  const sU8 *Data;
+  sU64 Size;
+
+#if defined(WIN32)
+  void *FileHandle;
+  void *MappingHandle;
+#else
+  sInt FileHandle;
+#endif
+
+public:
+  MappedFile();
+  ~MappedFile();
+
+  sBool Open(const sChar *fileName);
+  void Close();
+
+  const sU8 *GetData() const                { return Data; }
+  sU64 GetSize() const                      { return Size; }
+};
+
+/****************************************************************************/
+
+#endif
@@ -0,0 +1,257 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#pragma warning(disable:4996)
+#include "types.hpp"
+#include "msffile.hpp"
+#include "mappedfile.hpp"
+
+#if !defined(WIN32)
+#include <sys/types.h>
+#endif
+
+/****************************************************************************/
+
+static const sChar MSFMagic[32] = "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0";
+static const sU32 NilStreamSize = 0xffffffff;
+
+static sU32 BlocksForSize(sU32 size,sU32 blockSize)
+{
+  return (size + blockSize - 1) / blockSize;
+}
+
+MSFFile::MSFFile()
+{
+  Mapping = 0;
+  File = 0;
+  BlockSize = 0;
+}
+
+MSFFile::~MSFFile()
+{
+  Close();
+}
+
+sBool MSFFile::IsMSF(const sChar *fileName)
+{
+  sChar magic[sizeof(MSFMagic)];
+  sBool result = false;
+
+  FILE *f = fopen(fileName,"rb");
+  if(f)
+  {
+    result = fread(magic,sizeof(magic),1,f) == 1 && !memcmp(magic,MSFMagic,sizeof(magic));
+    fclose(f);
+  }
+
+  return result;
+}
+
+sBool MSFFile::ReadAt(sU64 offset,void *buffer,sU32 size)
+{
+  if(Mapping)
+  {
+    if(offset > Mapping->GetSize() || size > Mapping->GetSize() - offset)
+      return false;
+
+    sCopyMem(buffer,Mapping->GetData() + offset,size);
+    return true;
+  }
+
+#if defined(WIN32)
+  if(_fseeki64(File,offset,SEEK_SET) != 0)
+    return false;
+#else
+  if(fseeko(File,(off_t) offset,SEEK_SET) != 0)
+    return false;
+#endif
+
+  return fread(buffer,1,size,File) == size;
+}
+
+sBool MSFFile::ReadBlocks(const sU32 *blocks,sU32 size,sU8 *out)
+{
+  sU32 done = 0;
+
+  while(done < size)
+  {
+    // coalesce runs of consecutive blocks into a single read
+    sU32 first = blocks[done / BlockSize];
+    sU32 count = 1;
+    while(done + count * BlockSize < size && blocks[done / BlockSize + count] == first + count)
+      count++;
+
+    sU32 chunk = count * BlockSize;
+    if(chunk > size - done)
+      chunk = size - done;
+
+    if(!ReadAt(sU64(first) * BlockSize,out + done,chunk))
+      return false;
+
+    done += chunk;
+  }
+
+  return true;
+}
+
+sBool MSFFile::Open(const sChar *fileName)
+{
+  Close();
+
+  // map the whole file if possible, else read streams the old way
+  Mapping = new MappedFile;
+  if(!Mapping->Open(fileName))
+  {
+    delete Mapping;
+    Mapping = 0;
+
+    File = fopen(fileName,"rb");
+    if(!File)
+      return false;
+  }
+
+  sU8 header[sizeof(MSFMagic) + 6*4];
+  if(!ReadAt(0,header,sizeof(header)) || memcmp(header,MSFMagic,sizeof(MSFMagic)))
+  {
+    Close();
+    return false;
+  }
+
+  sU32 fields[6]; // block size, free block map, #blocks, directory size, unknown, block map addr
+  sCopyMem(fields,header + sizeof(MSFMagic),sizeof(fields));
+  BlockSize = fields[0];
+
+  sU32 dirSize = fields[3];
+  sU32 blockMapAddr = fields[5];
+
+  if(BlockSize < 512 || (BlockSize & (BlockSize - 1)) || dirSize < 4)
+  {
+    Close();
+    return false;
+  }
+
+  // the block map lists the blocks the stream directory lives in
+  sU32 dirBlockCount = BlocksForSize(dirSize,BlockSize);
+  sArray<sU32> dirBlocks(dirBlockCount);
+  sArray<sU8> dir(dirSize);
+
+  if(dirBlockCount * 4 > BlockSize
+    || !ReadAt(sU64(blockMapAddr) * BlockSize,&dirBlocks[0],dirBlockCount * 4)
+    || !ReadBlocks(&dirBlocks[0],dirSize,&dir[0]))
+  {
+    Close();
+    return false;
+  }
+
+  // directory: stream count, stream sizes, then the block lists of all streams
+  const sU32 *words = (const sU32 *) &dir[0];
+  sU32 nWords = dirSize / 4;
+  sU32 nStreams = words[0];
+
+  if(nStreams >= nWords)
+  {
+    Close();
+    return false;
+  }
+
+  StreamSizes.assign(words + 1,words + 1 + nStreams);
+  StreamFirstBlock.resize(nStreams);
+
+  sU32 pos = 1 + nStreams;
+  for(sU32 i=0;i<nStreams;i++)
+  {
+    StreamFirstBlock[i] = StreamBlocks.size();
+
+    sU32 size = StreamSizes[i];
+    sU32 count = (size == NilStreamSize) ? 0 : BlocksForSize(size,BlockSize);
+    if(pos + count > nWords)
+    {
+      Close();
+      return false;
+    }
+
+    StreamBlocks.insert(StreamBlocks.end(),words + pos,words + pos + count);
+    pos += count;
+  }
+
+  return true;
+}
+
+void MSFFile::Close()
+{
+  if(File)
+    fclose(File);
+
+  delete Mapping;
+  Mapping = 0;
+  File = 0;
+  BlockSize = 0;
+  StreamSizes.clear();
+  StreamFirstBlock.clear();
+  StreamBlocks.clear();
+}
+
+sU32 MSFFile::GetStreamSize(sInt index) const
+{
+  if(index < 0 || index >= StreamSizes.size() || StreamSizes[index] == NilStreamSize)
+    return 0;
+
+  return StreamSizes[index];
+}
+
+sBool MSFFile::OpenStream(sInt index,MSFStream &stream)
+{
+  stream.Data = 0;
+  stream.Size = 0;
+  stream.Mapped = false;
+  stream.Copy.clear();
+
+  if(index < 0 || index >= StreamSizes.size() || StreamSizes[index] == NilStreamSize)
+    return false;
+
+  sU32 size = StreamSizes[index];
+  if(!size)
+    return true;
+
+  const sU32 *blocks = &StreamBlocks[StreamFirstBlock[index]];
+  sU32 count = BlocksForSize(size,BlockSize);
+
+  // consecutive blocks in a mapped file can be used in place
+  if(Mapping)
+  {
+    sU32 run = 1;
+    while(run < count && blocks[run] == blocks[0] + run)
+      run++;
+
+    sU64 start = sU64(blocks[0]) * BlockSize;
+    if(run == count && start <= Mapping->GetSize() && size <= Mapping->GetSize() - start)
+    {
+      stream.Data = Mapping->GetData() + start;
+      stream.Size = size;
+      stream.Mapped = true;
+      return true;
+    }
+  }
+
+  stream.Copy.resize(size);
+  if(!ReadBlocks(blocks,size,&stream.Copy[0]))
+  {
+    stream.Copy.clear();
+    return false;
+  }
+
+  stream.Data = &stream.Copy[0];
+  stream.Size = size;
+  return true;
+}
+
+MappedFile *MSFFile::DetachMapping()
+{
+  MappedFile *mapping = Mapping;
+  Mapping = 0;
+  Close();
+
+  return mapping;
+}
+
+/****************************************************************************/
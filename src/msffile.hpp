@@ -0,0 +1,78 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __MSFFILE_HPP__
+#define __MSFFILE_HPP__
+
+#include "types.hpp"
+#include <cstdio>
+
+class MappedFile;
+
+/****************************************************************************/
+
+// Contents of a single stream. If the stream's blocks are consecutive in a
+// memory mapped file, this points straight into the mapping (and stays valid
+// as long as the mapping does); otherwise the blocks are gathered into a
+// private copy.
+
+class MSFStream
+{
+  friend class MSFFile;
+
+  const sU8 *Data;
+  sU32 Size;
+  sBool Mapped;
+  sArray<sU8> Copy;
+
+public:
+  MSFStream()                               { Data = 0; Size = 0; Mapped = false; }
+
+  const sU8 *GetData() const                { return Data; }
+  sU32 GetSize() const                      { return Size; }
+  sBool IsMapped() const                    { return Mapped; }
+};
+
+// A PDB is stored in an MSF ("multi-stream file") container: a tiny file
+// system made of fixed size blocks, holding a directory of numbered streams.
+// This only handles the MSF 7.00 container (VC7 and later); the contents of
+// the streams are decoded by PDBFileReader.
+
+class MSFFile
+{
+  MappedFile *Mapping;
+  FILE *File;                     // only used if the file couldn't be mapped
+  sU32 BlockSize;
+
+  sArray<sU32> StreamSizes;
+  sArray<sU32> StreamFirstBlock;  // index into StreamBlocks
+  sArray<sU32> StreamBlocks;
+
+  sBool ReadAt(sU64 offset,void *buffer,sU32 size);
+  sBool ReadBlocks(const sU32 *blocks,sU32 size,sU8 *out);
+
+public:
+  MSFFile();
+  ~MSFFile();
+
+  static sBool IsMSF(const sChar *fileName);
+
+  sBool Open(const sChar *fileName);
+  void Close();
+
+  sInt GetStreamCount() const               { return StreamSizes.size(); }
+  sU32 GetStreamSize(sInt index) const;
+  sBool IsMapped() const                    { return Mapping != 0; }
+
+  // returns false for missing/nil streams
+  sBool OpenStream(sInt index,MSFStream &stream);
+
+  // hands the mapping (if any) over to the caller, e.g. to keep names that
+  // point into it alive. Mapped streams stay valid, the file is closed.
+  MappedFile *DetachMapping();
+};
+
+/****************************************************************************/
+
+#endif
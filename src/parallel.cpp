@@ -0,0 +1,116 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#include "types.hpp"
+#include "parallel.hpp"
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/****************************************************************************/
+
+static const sInt MaxThreads = 64;
+
+static sInt AtomicIncrement(volatile sInt *value)
+{
+#if defined(WIN32)
+  return InterlockedIncrement((volatile LONG *) value) - 1;
+#else
+  return __sync_fetch_and_add(value,1);
+#endif
+}
+
+void ParallelJobs::WorkerLoop(ParallelJobs *jobs)
+{
+  sInt index;
+  while((index = AtomicIncrement(&jobs->NextJob)) < jobs->JobCount)
+    jobs->RunJob(index);
+}
+
+#if defined(WIN32)
+
+unsigned long __stdcall ParallelJobs::ThreadProc(void *user)
+{
+  WorkerLoop((ParallelJobs *) user);
+  return 0;
+}
+
+sInt ParallelJobs::GetThreadCount()
+{
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+
+  sInt count = info.dwNumberOfProcessors;
+  return count < 1 ? 1 : count > MaxThreads ? MaxThreads : count;
+}
+
+void ParallelJobs::Run(sInt count,sInt maxThreads)
+{
+  NextJob = 0;
+  JobCount = count;
+
+  sInt nThreads = maxThreads ? maxThreads : GetThreadCount();
+  if(nThreads > count)
+    nThreads = count;
+
+  HANDLE threads[MaxThreads];
+  sInt nStarted = 0;
+  for(sInt i=1;i<nThreads && i<MaxThreads;i++)
+  {
+    threads[nStarted] = CreateThread(0,0,ThreadProc,this,0,0);
+    if(threads[nStarted])
+      nStarted++;
+  }
+
+  WorkerLoop(this);
+
+  if(nStarted)
+    WaitForMultipleObjects(nStarted,threads,TRUE,INFINITE);
+  for(sInt i=0;i<nStarted;i++)
+    CloseHandle(threads[i]);
+}
+
+#else
+
+void *ParallelJobs::ThreadProc(void *user)
+{
+  WorkerLoop((ParallelJobs *) user);
+  return 0;
+}
+
+sInt ParallelJobs::GetThreadCount()
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count < 1 ? 1 : count > MaxThreads ? MaxThreads : (sInt) count;
+}
+
+void ParallelJobs::Run(sInt count,sInt maxThreads)
+{
+  NextJob = 0;
+  JobCount = count;
+
+  sInt nThreads = maxThreads ? maxThreads : GetThreadCount();
+  if(nThreads > count)
+    nThreads = count;
+
+  pthread_t threads[MaxThreads];
+  sInt nStarted = 0;
+  for(sInt i=1;i<nThreads && i<MaxThreads;i++)
+  {
+    if(pthread_create(&threads[nStarted],0,ThreadProc,this) == 0)
+      nStarted++;
+  }
+
+  WorkerLoop(this);
+
+  for(sInt i=0;i<nStarted;i++)
+    pthread_join(threads[i],0);
+}
+
+#endif
+
+/****************************************************************************/
@@ -0,0 +1,44 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __PARALLEL_HPP__
+#define __PARALLEL_HPP__
+
+#include "types.hpp"
+
+/****************************************************************************/
+
+// A batch of independent jobs, run on as many worker threads as there are
+// cores (the calling thread helps out). Jobs are handed out in index order,
+// but may finish in any order; RunJob has to be thread safe.
+
+class ParallelJobs
+{
+  static void WorkerLoop(ParallelJobs *jobs);
+
+#if defined(WIN32)
+  static unsigned long __stdcall ThreadProc(void *user);
+#else
+  static void *ThreadProc(void *user);
+#endif
+
+  volatile sInt NextJob;
+  sInt JobCount;
+
+protected:
+  virtual void RunJob(sInt index) = 0;
+
+public:
+  virtual ~ParallelJobs() {}
+
+  // runs jobs 0..count-1 and waits for all of them. maxThreads=0 uses all
+  // cores, 1 runs everything on the calling thread.
+  void Run(sInt count,sInt maxThreads = 0);
+
+  static sInt GetThreadCount();
+};
+
+/****************************************************************************/
+
+#endif
@@ -1,657 +1,1147 @@
 // Executable size report utility.
 // Aras Pranckevicius, http://aras-p.info/projSizer.html
 // Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
-
+#pragma warning(disable:4996)
 #include "types.hpp"
 #include "debuginfo.hpp"
 #include "pdbfile.hpp"
+#include "msffile.hpp"
 
-#include <malloc.h>
-#include <windows.h>
-#include <ole2.h>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
 
 /****************************************************************************/
 
-// I don't want to use the complete huge dia2.h headers (>350k), so here
-// goes the minimal version...
-
-enum SymTagEnum
-{
-  SymTagNull,
-  SymTagExe,
-  SymTagCompiland,
-  SymTagCompilandDetails,
-  SymTagCompilandEnv,
-  SymTagFunction,
-  SymTagBlock,
-  SymTagData,
-  SymTagAnnotation,
-  SymTagLabel,
-  SymTagPublicSymbol,
-  SymTagUDT,
-  SymTagEnum,
-  SymTagFunctionType,
-  SymTagPointerType,
-  SymTagArrayType,
-  SymTagBaseType,
-  SymTagTypedef,
-  SymTagBaseClass,
-  SymTagFriend,
-  SymTagFunctionArgType,
-  SymTagFuncDebugStart,
-  SymTagFuncDebugEnd,
-  SymTagUsingNamespace,
-  SymTagVTableShape,
-  SymTagVTable,
-  SymTagCustom,
-  SymTagThunk,
-  SymTagCustomType,
-  SymTagManagedType,
-  SymTagDimension,
-  SymTagMax
-};
-
-class IDiaEnumSymbols;
-class IDiaEnumSymbolsByAddr;
-class IDiaEnumTables;
-
-class IDiaDataSource;
-class IDiaSession;
-
-class IDiaSymbol;
-class IDiaSectionContrib;
+// We read the PDB streams ourselves instead of going through DIA. I don't
+// want to depend on cvinfo.h either, so here goes the minimal subset of
+// constants and record layouts...
 
-class IDiaTable;
-
-// not transcribed here:
-class IDiaSourceFile;
-
-class IDiaEnumSourceFiles;
-class IDiaEnumLineNumbers;
-class IDiaEnumDebugStreams;
-class IDiaEnumInjectedSources;
-
-class IDiaEnumSymbols : public IUnknown
+enum
 {
-public:
-  virtual HRESULT __stdcall get__NewEnum(IUnknown **ret) = 0;
-  virtual HRESULT __stdcall get_Count(LONG *ret) = 0;
+  PDB_STREAM_PDB = 1,
+  PDB_STREAM_TPI = 2,
+  PDB_STREAM_DBI = 3,
 
-  virtual HRESULT __stdcall Item(DWORD index,IDiaSymbol **symbol) = 0;
-  virtual HRESULT __stdcall Next(ULONG celt,IDiaSymbol **rgelt,ULONG *pceltFetched) = 0;
-  virtual HRESULT __stdcall Skip(ULONG celt) = 0;
-  virtual HRESULT __stdcall Reset() = 0;
-
-  virtual HRESULT __stdcall Clone(IDiaEnumSymbols **penum) = 0;
+  NIL_STREAM = 0xffff,
 };
 
-class IDiaEnumSymbolsByAddr : public IUnknown
+enum
 {
-public:
-  virtual HRESULT __stdcall symbolByAddr(DWORD isect,DWORD offset,IDiaSymbol** ppSymbol) = 0;
-  virtual HRESULT __stdcall symbolByRVA(DWORD relativeVirtualAddress,IDiaSymbol** ppSymbol) = 0;
-  virtual HRESULT __stdcall symbolByVA(ULONGLONG virtualAddress,IDiaSymbol** ppSymbol) = 0;
+  DBI_HEADER_SIZE = 64,
+  DBI_MODINFO_HEADER_SIZE = 64,
+  DBI_DEBUG_SECTION_HEADERS = 5, // slot in the optional debug header
 
-  virtual HRESULT __stdcall Next(ULONG celt,IDiaSymbol ** rgelt,ULONG* pceltFetched) = 0;
-  virtual HRESULT __stdcall Prev(ULONG celt,IDiaSymbol ** rgelt,ULONG * pceltFetched) = 0;
+  SC_VERSION_60 = 0xeffe0000 + 19970605,
+  SC_VERSION_2 = 0xeffe0000 + 20140516,
 
-  virtual HRESULT __stdcall Clone(IDiaEnumSymbolsByAddr **ppenum) = 0;
+  TPI_HEADER_SIZE = 56,
 };
 
-class IDiaEnumTables : public IUnknown
+enum
 {
-public:
-  virtual HRESULT __stdcall get__NewEnum(IUnknown **ret) = 0;
-  virtual HRESULT __stdcall get_Count(LONG *ret) = 0;
-
-  virtual HRESULT __stdcall Item(VARIANT index,IDiaTable **table) = 0;
-  virtual HRESULT __stdcall Next(ULONG celt,IDiaTable ** rgelt,ULONG *pceltFetched) = 0;
-  virtual HRESULT __stdcall Skip(ULONG celt) = 0;
-  virtual HRESULT __stdcall Reset() = 0;
-
-  virtual HRESULT __stdcall Clone(IDiaEnumTables **ppenum) = 0;
+  IMAGE_SCN_CNT_CODE = 0x20,
+  IMAGE_SCN_CNT_INITIALIZED_DATA = 0x40,
+  IMAGE_SCN_CNT_UNINITIALIZED_DATA = 0x80,
 };
 
-class IDiaDataSource : public IUnknown
+// symbol record kinds ("_ST" ones are VC7.x, with length-prefixed names)
+enum
 {
-public:
-  virtual HRESULT __stdcall get_lastError(BSTR *ret) = 0;
-
-  virtual HRESULT __stdcall loadDataFromPdb(LPCOLESTR pdbPath) = 0;
-  virtual HRESULT __stdcall loadAndValidateDataFromPdb(LPCOLESTR pdbPath,GUID *pcsig70,DWORD sig,DWORD age) = 0;
-  virtual HRESULT __stdcall loadDataForExe(LPCOLESTR executable,LPCOLESTR searchPath,IUnknown *pCallback) = 0;
-  virtual HRESULT __stdcall loadDataFromIStream(IStream *pIStream) = 0;
-
-  virtual HRESULT __stdcall openSession(IDiaSession **ppSession) = 0;
-};
-
-class IDiaSession : public IUnknown
-{
-public:
-  virtual HRESULT __stdcall get_loadAddress(ULONGLONG *ret) = 0;
-  virtual HRESULT __stdcall put_loadAddress(ULONGLONG val) = 0;
-  virtual HRESULT __stdcall get_globalScape(IDiaSymbol **sym) = 0;
-
-  virtual HRESULT __stdcall getEnumTables(IDiaEnumTables** ppEnumTables) = 0;
-  virtual HRESULT __stdcall getSymbolsByAddr(IDiaEnumSymbolsByAddr** ppEnumbyAddr) = 0;
-
-  virtual HRESULT __stdcall findChildren(IDiaSymbol* parent,enum SymTagEnum symtag,LPCOLESTR name,DWORD compareFlags,IDiaEnumSymbols** ppResult) = 0;
-  virtual HRESULT __stdcall findSymbolByAddr(DWORD isect,DWORD offset,enum SymTagEnum symtag,IDiaSymbol** ppSymbol) = 0;
-  virtual HRESULT __stdcall findSymbolByRVA(DWORD rva,enum SymTagEnum symtag,IDiaSymbol** ppSymbol) = 0;
-  virtual HRESULT __stdcall findSymbolByVA(ULONGLONG va,enum SymTagEnum symtag,IDiaSymbol** ppSymbol) = 0;
-  virtual HRESULT __stdcall findSymbolByToken(ULONG token,enum SymTagEnum symtag,IDiaSymbol** ppSymbol) = 0;
-  virtual HRESULT __stdcall symsAreEquiv(IDiaSymbol* symbolA,IDiaSymbol* symbolB) = 0;
-  virtual HRESULT __stdcall symbolById(DWORD id,IDiaSymbol** ppSymbol) = 0;
-  virtual HRESULT __stdcall findSymbolByRVAEx(DWORD rva,enum SymTagEnum symtag,IDiaSymbol** ppSymbol,long* displacement) = 0;
-  virtual HRESULT __stdcall findSymbolByVAEx(ULONGLONG va,enum SymTagEnum symtag,IDiaSymbol** ppSymbol,long* displacement) = 0;
-
-  virtual HRESULT __stdcall findFile(IDiaSymbol* pCompiland,LPCOLESTR name,DWORD compareFlags,IDiaEnumSourceFiles** ppResult) = 0;
-  virtual HRESULT __stdcall findFileById(DWORD uniqueId,IDiaSourceFile** ppResult) = 0;
-
-  virtual HRESULT __stdcall findLines(IDiaSymbol* compiland,IDiaSourceFile* file,IDiaEnumLineNumbers** ppResult) = 0;
-  virtual HRESULT __stdcall findLinesByAddr(DWORD seg,DWORD offset,DWORD length,IDiaEnumLineNumbers** ppResult) = 0;
-  virtual HRESULT __stdcall findLinesByRVA(DWORD rva,DWORD length,IDiaEnumLineNumbers** ppResult) = 0;
-  virtual HRESULT __stdcall findLinesByVA(ULONGLONG va,DWORD length,IDiaEnumLineNumbers** ppResult) = 0;
-  virtual HRESULT __stdcall findLinesByLinenum(IDiaSymbol* compiland,IDiaSourceFile* file,DWORD linenum,DWORD column,IDiaEnumLineNumbers** ppResult) = 0;
-
-  virtual HRESULT __stdcall findInjectedSource(LPCOLESTR srcFile,IDiaEnumInjectedSources** ppResult) = 0;
-  virtual HRESULT __stdcall getEnumDebugStreams(IDiaEnumDebugStreams** ppEnumDebugStreams) = 0;
+  S_END = 0x0006,
+  S_THUNK32_ST = 0x0206,
+  S_BLOCK32_ST = 0x0207,
+  S_WITH32_ST = 0x0208,
+  S_LDATA32_ST = 0x1007,
+  S_GDATA32_ST = 0x1008,
+  S_PUB32_ST = 0x1009,
+  S_LPROC32_ST = 0x100a,
+  S_GPROC32_ST = 0x100b,
+  S_THUNK32 = 0x1102,
+  S_BLOCK32 = 0x1103,
+  S_WITH32 = 0x1104,
+  S_LDATA32 = 0x110c,
+  S_GDATA32 = 0x110d,
+  S_PUB32 = 0x110e,
+  S_LPROC32 = 0x110f,
+  S_GPROC32 = 0x1110,
+  S_SEPCODE = 0x1132,
+  S_LPROC32_ID = 0x1146,
+  S_GPROC32_ID = 0x1147,
+  S_PROC_ID_END = 0x114f,
+  S_LPROC32_DPC = 0x1155,
+  S_LPROC32_DPC_ID = 0x1156,
 };
 
-class IDiaSymbol : public IUnknown
-{
-public:
-  virtual HRESULT __stdcall get_symIndexId(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_symTag(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_name(BSTR *ret) = 0;
-  virtual HRESULT __stdcall get_lexicalParent(IDiaSymbol **ret) = 0;
-  virtual HRESULT __stdcall get_classParent(IDiaSymbol **ret) = 0;
-  virtual HRESULT __stdcall get_type(IDiaSymbol **ret) = 0;
-  virtual HRESULT __stdcall get_dataKind(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_locationType(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_addressSection(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_addressOffset(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_relativeVirtualAddress(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_virtualAddress(ULONGLONG *ret) = 0;
-  virtual HRESULT __stdcall get_registerId(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_offset(LONG *ret) = 0;
-  virtual HRESULT __stdcall get_length(ULONGLONG *ret) = 0;
-  virtual HRESULT __stdcall get_slot(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_volatileType(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_constType(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_unalignedType(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_access(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_libraryName(BSTR *ret) = 0;
-  virtual HRESULT __stdcall get_platform(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_language(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_editAndContinueEnabled(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_frontEndMajor(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_frontEndMinor(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_frontEndBuild(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_backEndMajor(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_backEndMinor(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_backEndBuild(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_sourceFileName(BSTR *ret) = 0;
-  virtual HRESULT __stdcall get_unused(BSTR *ret) = 0;
-  virtual HRESULT __stdcall get_thunkOrdinal(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_thisAdjust(LONG *ret) = 0;
-  virtual HRESULT __stdcall get_virtualBaseOffset(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_virtual(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_intro(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_pure(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_callingConvention(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_value(VARIANT *ret) = 0;
-  virtual HRESULT __stdcall get_baseType(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_token(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_timeStamp(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_guid(GUID *ret) = 0;
-  virtual HRESULT __stdcall get_symbolsFileName(BSTR *ret) = 0;
-  virtual HRESULT __stdcall get_reference(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_count(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_bitPosition(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_arrayIndexType(IDiaSymbol **ret) = 0;
-  virtual HRESULT __stdcall get_packed(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_constructor(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_overloadedOperator(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_nested(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_hasNestedTypes(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_hasAssignmentOperator(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_hasCastOperator(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_scoped(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_virtualBaseClass(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_indirectVirtualBaseClass(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_virtualBasePointerOffset(LONG *ret) = 0;
-  virtual HRESULT __stdcall get_virtualTableShape(IDiaSymbol **ret) = 0;
-  virtual HRESULT __stdcall get_lexicalParentId(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_classParentId(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_typeId(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_arrayIndexTypeId(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_virtualTableShapeId(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_code(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_function(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_managed(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_msil(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_virtualBaseDispIndex(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_undecoratedName(BSTR *ret) = 0;
-  virtual HRESULT __stdcall get_age(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_signature(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_compilerGenerated(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_addressTaken(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_rank(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_lowerBound(IDiaSymbol **ret) = 0;
-  virtual HRESULT __stdcall get_upperBound(IDiaSymbol **ret) = 0;
-  virtual HRESULT __stdcall get_lowerBoundId(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_upperBoundId(DWORD *ret) = 0;
-  
-  virtual HRESULT __stdcall get_dataBytes(DWORD cbData,DWORD *pcbData,BYTE data[]) = 0;
-  virtual HRESULT __stdcall findChildren(enum SymTagEnum symtag,LPCOLESTR name,DWORD compareFlags,IDiaEnumSymbols** ppResult) = 0;
-
-  virtual HRESULT __stdcall get_targetSection(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_targetOffset(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_targetRelativeVirtualAddress(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_targetVirtualAddress(ULONGLONG *ret) = 0;
-  virtual HRESULT __stdcall get_machineType(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_oemId(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_oemSymbolId(DWORD *ret) = 0;
-
-  virtual HRESULT __stdcall get_types(DWORD cTypes,DWORD *pcTypes,IDiaSymbol* types[]) = 0;
-  virtual HRESULT __stdcall get_typeIds(DWORD cTypes,DWORD *pcTypeIds,DWORD typeIds[]) = 0;
-  
-  virtual HRESULT __stdcall get_objectPointerType(IDiaSymbol **ret) = 0;
-  virtual HRESULT __stdcall get_udtKind(DWORD *ret) = 0;
-
-  virtual HRESULT __stdcall get_undecoratedNameEx(DWORD undecorateOptions,BSTR *name) = 0;
-};
-
-class IDiaSectionContrib : public IUnknown
-{
-public:
-  virtual HRESULT __stdcall get_compiland(IDiaSymbol **ret) = 0;
-  virtual HRESULT __stdcall get_addressSection(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_addressOffset(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_relativeVirtualAddress(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_virtualAddress(ULONGLONG *ret) = 0;
-  virtual HRESULT __stdcall get_length(DWORD *ret) = 0;
-
-  virtual HRESULT __stdcall get_notPaged(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_code(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_initializedData(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_uninitializedData(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_remove(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_comdat(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_discardable(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_notCached(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_share(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_execute(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_read(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_write(BOOL *ret) = 0;
-  virtual HRESULT __stdcall get_dataCrc(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_relocationsaCrc(DWORD *ret) = 0;
-  virtual HRESULT __stdcall get_compilandId(DWORD *ret) = 0;
+// type record kinds
+enum
+{
+  LF_MODIFIER = 0x1001,
+  LF_POINTER = 0x1002,
+  LF_ARRAY_ST = 0x1003,
+  LF_CLASS_ST = 0x1004,
+  LF_STRUCTURE_ST = 0x1005,
+  LF_UNION_ST = 0x1006,
+  LF_ENUM_ST = 0x1007,
+  LF_ARRAY = 0x1503,
+  LF_CLASS = 0x1504,
+  LF_STRUCTURE = 0x1505,
+  LF_UNION = 0x1506,
+  LF_ENUM = 0x1507,
+  LF_INTERFACE = 0x1519,
+
+  LF_NUMERIC = 0x8000,
+  LF_CHAR = 0x8000,
+  LF_SHORT = 0x8001,
+  LF_USHORT = 0x8002,
+  LF_LONG = 0x8003,
+  LF_ULONG = 0x8004,
+  LF_QUADWORD = 0x8009,
+  LF_UQUADWORD = 0x800a,
 };
 
-class IDiaTable : public IEnumUnknown
+enum
 {
-public:
-  virtual HRESULT __stdcall get__NewEnum(IUnknown **ret) = 0;
-  virtual HRESULT __stdcall get_name(BSTR *ret) = 0;
-  virtual HRESULT __stdcall get_Count(LONG *ret) = 0;
-  
-  virtual HRESULT __stdcall Item(DWORD index,IUnknown **element) = 0;
+  UDT_FWDREF = 0x80,
+  UDT_HASUNIQUENAME = 0x200,
 };
 
-class DECLSPEC_UUID("e60afbee-502d-46ae-858f-8272a09bd707") DiaSource71;
-class DECLSPEC_UUID("bce36434-2c24-499e-bf49-8bd99b0eeb68") DiaSource80;
-class DECLSPEC_UUID("79f1bb5f-b66e-48e5-b6a9-1545c323ca3d") IDiaDataSource;
+static const sU64 UnknownTypeSize = ~0ULL;
 
 /****************************************************************************/
 
 struct PDBFileReader::SectionContrib
 {
-  DWORD Section;
-  DWORD Offset;
-  DWORD Length;
-  DWORD Compiland;
+  sU32 Section;
+  sU32 Offset;
+  sU32 Length;
+  sU32 Compiland;
 	sInt Type;
 	sInt ObjFile;
+
+  bool operator <(const SectionContrib &b) const
+  {
+    return Section < b.Section || Section == b.Section && Offset < b.Offset;
+  }
 };
 
-const PDBFileReader::SectionContrib *PDBFileReader::ContribFromSectionOffset(sU32 sec,sU32 offs)
+// A range of module streams or a piece of the global symbol stream. Its
+// symbols go into a private DebugInfo that's merged into the real one after
+// all chunks are done, so chunks can be decoded on different threads.
+struct PDBFileReader::SymbolChunk
 {
-  sInt l,r,x;
+  sBool Global;
+  sU32 First,End;               // modules, or byte range of the global symbols
+  const DebugInfo *Target;      // only read from while decoding
+  DebugInfo Part;
+  sArray<sInt> FileMap;         // object file in Target -> object file in Part
+  sArray<PublicSymbol> Publics; // in Part
+  sInt NoObjFile;
+  std::string NameScratch;
+  sInt Counter;
+
+  SymbolChunk(sBool global,sU32 first,sU32 end,const DebugInfo &target)
+  {
+    Global = global;
+    First = first;
+    End = end;
+    Target = &target;
+    Part.Init();
+    Part.Symbols.SetPacked(target.Symbols.IsPacked());
+    FileMap.assign(target.m_Files.size(),-1);
+    NoObjFile = -1;
+    Counter = 0;
+  }
+
+  ~SymbolChunk()
+  {
+    Part.Exit();
+  }
 
-  l = 0;
-  r = nContribs;
-  
-  while(l < r)
+  sInt GetFile(sInt targetFile)
   {
-    x = (l + r) / 2;
-    const SectionContrib &cur = Contribs[x];
+    sInt &file = FileMap[targetFile];
+    if(file < 0)
+    {
+      const sChar *name = Target->GetStringPrep(Target->m_Files[targetFile].fileName);
+      file = Part.GetFile(Part.MakeStringRef(name,sGetStringLen(name)));
+    }
 
-    if(sec < cur.Section || sec == cur.Section && offs < cur.Offset)
-      r = x;
-    else if(sec > cur.Section || sec == cur.Section && offs >= cur.Offset + cur.Length)
-      l = x+1;
-		else if(sec == cur.Section && offs >= cur.Offset && offs < cur.Offset + cur.Length) // we got a winner
-			return &cur;
-		else
-			break; // there's nothing here!
+    return file;
   }
+};
+
+const PDBFileReader::SectionContrib *PDBFileReader::ContribFromSectionOffset(sU32 sec,sU32 offs)
+{
+  sInt index = ContribIndex.Find(((sU64) sec << 32) | offs);
 
   // normally, this shouldn't happen!
-  return 0;
+  return (index >= 0) ? &Contribs[index] : 0;
 }
 
 // helpers
-static sChar *BStrToString( BSTR str, sChar *defString = "", bool stripWhitespace = false )
+static inline sU16 GetU16(const sU8 *p)
+{
+  sU16 v;
+  sCopyMem(&v,p,sizeof(v));
+  return v;
+}
+
+static inline sU32 GetU32(const sU8 *p)
 {
-  if(!str)
+  sU32 v;
+  sCopyMem(&v,p,sizeof(v));
+  return v;
+}
+
+// reads a numeric leaf, returns pointer past it
+static const sU8 *GetNumeric(const sU8 *p,const sU8 *end,sU64 &value)
+{
+  value = 0;
+  if(p + 2 > end)
+    return end;
+
+  sU16 leaf = GetU16(p);
+  p += 2;
+  if(leaf < LF_NUMERIC)
   {
-    sInt len = sGetStringLen(defString);
-    sChar *buffer = new sChar[len+1];
-    sCopyString(buffer,defString,len+1);
+    value = leaf;
+    return p;
+  }
 
-    return buffer;
+  sInt size;
+  switch(leaf)
+  {
+  case LF_CHAR:                     size = 1; break;
+  case LF_SHORT: case LF_USHORT:    size = 2; break;
+  case LF_LONG: case LF_ULONG:      size = 4; break;
+  case LF_QUADWORD: case LF_UQUADWORD: size = 8; break;
+  default:                          return end;
   }
-  else
+
+  if(p + size > end)
+    return end;
+
+  sCopyMem(&value,p,size);
+  return p + size;
+}
+
+// Raw name in a record: zero terminated, or length-prefixed in "_ST" records.
+static sStringRef GetRawName(const sU8 *p,const sU8 *end,sBool pascal)
+{
+  if(pascal && p < end)
   {
-    sInt len = SysStringLen(str);
-    sChar *buffer = new sChar[len+1];
+    sInt len = *p++;
+    return sStringRef((const sChar *) p,(end - p > len) ? len : end - p);
+  }
 
-	sInt j = 0;
-    for( sInt i=0;i<len;i++ )
-	{
-		if( stripWhitespace && isspace(str[i]) )
-			continue;
-		buffer[j] = (str[i] >= 32 && str[i] < 128) ? str[i] : '?';
-		++j;
-	}
+  const sU8 *s = p;
+  while(p < end && *p)
+    p++;
 
-    buffer[j] = 0;
+  return sStringRef((const sChar *) s,p - s);
+}
 
-    return buffer;
+// size, property flags and lookup name of a class/struct/union record
+static sBool GetUDTInfo(sU16 leaf,const sU8 *p,const sU8 *end,sU16 &property,sU64 &size,sStringRef &name)
+{
+  sBool pascal = false;
+  const sU8 *sizeLeaf;
+
+  switch(leaf)
+  {
+  case LF_CLASS_ST: case LF_STRUCTURE_ST:
+    pascal = true;
+  case LF_CLASS: case LF_STRUCTURE: case LF_INTERFACE:
+    sizeLeaf = p + 16; // count, property, field list, derived, vshape
+    break;
+
+  case LF_UNION_ST:
+    pascal = true;
+  case LF_UNION:
+    sizeLeaf = p + 8; // count, property, field list
+    break;
+
+  default:
+    return false;
   }
+
+  if(sizeLeaf > end)
+    return false;
+
+  property = GetU16(p + 2);
+  p = GetNumeric(sizeLeaf,end,size);
+  name = GetRawName(p,end,pascal);
+
+  // prefer the decorated unique name to tell apart same-named local types
+  if((property & UDT_HASUNIQUENAME) && !pascal)
+  {
+    p += name.Len + 1;
+    if(p < end)
+      name = GetRawName(p,end,false);
+  }
+
+  return true;
 }
 
-static sInt GetBStr(BSTR str,sChar *defString,DebugInfo &to)
+static sU32 GetSimpleTypeSize(sU32 typeIndex)
 {
-  sChar *normalStr = BStrToString(str);
-  sInt result = to.MakeString(normalStr);
-  delete[] normalStr;
+  switch((typeIndex >> 8) & 0x0f) // pointer mode
+  {
+  case 0:   break;
+  case 1:   return 2;
+  case 2:
+  case 3:
+  case 4:   return 4;
+  case 5:   return 6;
+  case 6:   return 8;
+  case 7:   return 16;
+  default:  return 0;
+  }
 
-  return result;
+  switch(typeIndex & 0xff)
+  {
+  case 0x08:                                  return 4; // HRESULT
+  case 0x10: case 0x20: case 0x68: case 0x69:
+  case 0x70: case 0x7c: case 0x30:            return 1; // chars, int8, bool8
+  case 0x11: case 0x21: case 0x72: case 0x73:
+  case 0x71: case 0x7a: case 0x31: case 0x46: return 2; // shorts, wchar, char16, bool16, half
+  case 0x12: case 0x22: case 0x74: case 0x75:
+  case 0x7b: case 0x32: case 0x40: case 0x45: return 4; // longs, int32, char32, bool32, float
+  case 0x44:                                  return 6; // float48
+  case 0x13: case 0x23: case 0x76: case 0x77:
+  case 0x33: case 0x41:                       return 8; // quads, bool64, double
+  case 0x42:                                  return 10; // float80
+  case 0x14: case 0x24: case 0x78: case 0x79:
+  case 0x43:                                  return 16; // octs, int128, float128
+  default:                                    return 0;
+  }
 }
 
-void PDBFileReader::ProcessSymbol(IDiaSymbol *symbol,DebugInfo &to)
+sU64 PDBFileReader::GetTypeSize(sU32 typeIndex,sInt depth)
 {
-	// print a dot for each 1000 symbols processed
-	static int counter = 0;
-	++counter;
-	if( counter == 1000 ) {
-		fputc( '.', stderr );
-		counter = 0;
-	}
+  if(typeIndex < TypeIndexBegin)
+    return GetSimpleTypeSize(typeIndex);
 
-	DWORD section,offset,rva;
-	enum SymTagEnum tag;
-	ULONGLONG length = 0;
-	BSTR name = 0, srcFileName = 0;
+  sU32 index = typeIndex - TypeIndexBegin;
+  if(index >= TypeOffsets.size() || depth > 32)
+    return 0;
 
-	symbol->get_symTag((DWORD *) &tag);
-	symbol->get_relativeVirtualAddress(&rva);
-	symbol->get_length(&length);
-	symbol->get_addressSection(&section);
-	symbol->get_addressOffset(&offset);
+  if(TypeSizes[index] != UnknownTypeSize)
+    return TypeSizes[index];
 
-	// get length from type for data
-	if( tag == SymTagData )
-	{
-		IDiaSymbol *type = NULL;
-		if( symbol->get_type(&type) == S_OK ) // no SUCCEEDED test as may return S_FALSE!
-		{
-			if( FAILED(type->get_length(&length)) )
-				length = 0;
-			type->Release();
-		}
-		else
-			length = 0;
+  const sU8 *rec = TypeStream.GetData() + TypeOffsets[index];
+  const sU8 *end = rec + 2 + GetU16(rec);
+  sU16 leaf = GetU16(rec + 2);
+  const sU8 *p = rec + 4;
+
+  sU64 size = 0;
+  sU16 property;
+  sStringRef name;
+
+  switch(leaf)
+  {
+  case LF_MODIFIER:
+    if(p + 4 <= end)
+      size = GetTypeSize(GetU32(p),depth+1);
+    break;
+
+  case LF_POINTER:
+    if(p + 8 <= end)
+      size = (GetU32(p + 4) >> 13) & 0x3f;
+    break;
+
+  case LF_ARRAY: case LF_ARRAY_ST:
+    GetNumeric(p + 8,end,size); // element type, index type, size
+    break;
+
+  case LF_ENUM: case LF_ENUM_ST:
+    if(p + 8 <= end)
+      size = GetTypeSize(GetU32(p + 4),depth+1); // underlying type
+    break;
+
+  default:
+    if(GetUDTInfo(leaf,p,end,property,size,name) && (property & UDT_FWDREF))
+    {
+      std::map<sStringRef,sU64>::const_iterator it = UDTSizes.find(name);
+      size = (it != UDTSizes.end()) ? it->second : 0;
+    }
+    break;
+  }
+
+  TypeSizes[index] = size;
+  return size;
+}
+
+void PDBFileReader::ReadTypes()
+{
+  TypeOffsets.clear();
+  TypeSizes.clear();
+  UDTSizes.clear();
+  TypeIndexBegin = 0x1000;
+
+  if(!File->OpenStream(PDB_STREAM_TPI,TypeStream) || TypeStream.GetSize() < TPI_HEADER_SIZE)
+    return;
+
+  const sU8 *data = TypeStream.GetData();
+  sU32 headerSize = GetU32(data + 4);
+  TypeIndexBegin = GetU32(data + 8);
+  sU32 recordBytes = GetU32(data + 16);
+
+  sU32 pos = headerSize;
+  sU32 end = TypeStream.GetSize();
+  if(pos > end)
+    return;
+  if(recordBytes < end - pos)
+    end = pos + recordBytes;
+
+  // index the records and remember the sizes of complete UDTs, so that
+  // data declared through forward references can be resolved
+  sStringRef name;
+  while(pos + 4 <= end)
+  {
+    const sU8 *rec = data + pos;
+    sU32 len = GetU16(rec);
+    if(len < 2 || pos + 2 + len > end)
+      break;
+
+    sU16 property;
+    sU64 size;
+    if(GetUDTInfo(GetU16(rec + 2),rec + 4,rec + 2 + len,property,size,name) && !(property & UDT_FWDREF))
+      UDTSizes.insert(std::make_pair(name,size));
+
+    TypeOffsets.push_back(pos);
+    pos += 2 + len;
+  }
+
+  // resolve all sizes up front, symbol decoding only looks them up
+  TypeSizes.assign(TypeOffsets.size(),UnknownTypeSize);
+  for(sU32 i=0;i<TypeOffsets.size();i++)
+    GetTypeSize(TypeIndexBegin + i);
+}
+
+// Names that are already clean (printable ASCII, no whitespace to strip)
+// and zero terminated inside a mapped stream are used in place. Everything
+// else is cleaned up (non-ASCII turns into '?', optionally strips whitespace,
+// which often happens with templates) and copied.
+static sInt MakeName(const sU8 *p,const sU8 *end,sBool pascal,sBool stripWhitespace,sBool inPlace,const sChar *defString,std::string &scratch,DebugInfo &to)
+{
+  sStringRef raw = GetRawName(p,end,pascal);
+  const sU8 *s = (const sU8 *) raw.Str;
+  sU8 minChar = stripWhitespace ? 33 : 32;
+
+  sBool clean = inPlace && !pascal && raw.Len > 0 && s + raw.Len < end;
+  for(sInt i=0;clean && i<raw.Len;i++)
+    clean = s[i] >= minChar && s[i] < 128;
+
+  if(clean)
+    return to.MakeStringRef(raw.Str,raw.Len);
+
+  scratch.clear();
+  for(sInt i=0;i<raw.Len;i++)
+  {
+    sU8 c = s[i];
+    if(stripWhitespace && isspace(c))
+      continue;
+
+    scratch.push_back((c >= 32 && c < 128) ? (sChar) c : '?');
+  }
+
+  return to.MakeString(scratch.empty() ? defString : scratch.c_str());
+}
+
+void PDBFileReader::ProcessSymbol(sU32 section,sU32 offset,sU64 length,sInt name,SymbolChunk &chunk)
+{
+	// print a dot for each 1000 symbols processed
+	if( ++chunk.Counter == 1000 ) {
+		fputc( '.', stderr );
+		chunk.Counter = 0;
 	}
 
+	if(section == 0 || section > SectionRVAs.size())
+		return; // not in the image (absolute/TLS/debug-only)
+
 	const SectionContrib *contrib = ContribFromSectionOffset(section,offset);
-	sInt objFile = 0;
+	sInt objFile;
 	sInt sectionType = DIC_UNKNOWN;
 
+	DebugInfo &to = chunk.Part;
 	if(contrib)
 	{
-		objFile = contrib->ObjFile;
+		objFile = chunk.GetFile(contrib->ObjFile);
 		sectionType = contrib->Type;
 	}
-
-	symbol->get_name(&name);
+	else
+	{
+		if(chunk.NoObjFile < 0)
+			chunk.NoObjFile = to.GetFileByName("<noobjfile>");
+		objFile = chunk.NoObjFile;
+	}
 
 	// fill out structure
-	sChar *nameStr = BStrToString( name, "<noname>", true);
-
-	to.Symbols.push_back( DISymbol() );
-	DISymbol *outSym = &to.Symbols.back();
-	outSym->name = outSym->mangledName = to.MakeString(nameStr);
-	outSym->objFileNum = objFile;
-	outSym->VA = rva;
-	outSym->Size = (sU32) length;
-	outSym->Class = sectionType;
-	outSym->NameSpNum = to.GetNameSpaceByName(nameStr);
-
-	// clean up
-	delete[] nameStr;
-	if(name)         SysFreeString(name);
+	DISymbol outSym;
+	outSym.name = outSym.mangledName = name;
+	outSym.objFileNum = objFile;
+	outSym.VA = (sU64) SectionRVAs[section-1] + offset;
+	outSym.Size = length;
+	outSym.Class = sectionType;
+	outSym.NameSpNum = to.GetNameSpaceOf(name);
+	to.Symbols.push_back( outSym );
 }
 
-void PDBFileReader::ReadEverything(DebugInfo &to)
+void PDBFileReader::ProcessPublic(sU32 section,sU32 offset,sInt name,SymbolChunk &chunk)
 {
-  ULONG celt;
-  
-  Contribs = 0;
-  nContribs = 0;
-  
-  // read section table
-  IDiaEnumTables *enumTables;
-  if(Session->getEnumTables(&enumTables) == S_OK)
+  sInt count = chunk.Part.Symbols.size();
+  ProcessSymbol(section,offset,0,name,chunk);
+
+  // without a contribution there's nothing to limit the size by; those
+  // stay empty and are dropped with the double-covers
+  const SectionContrib *contrib = ContribFromSectionOffset(section,offset);
+  if(chunk.Part.Symbols.size() > count && contrib)
   {
-    VARIANT vIndex;
-    vIndex.vt = VT_BSTR;
-    vIndex.bstrVal = SysAllocString(L"Sections");
+    PublicSymbol pub;
+    pub.Symbol = count;
+    pub.End = (sU64) SectionRVAs[section-1] + contrib->Offset + contrib->Length;
+    chunk.Publics.push_back(pub);
+  }
+}
 
-    IDiaTable *secTable;
-    if(enumTables->Item(vIndex,&secTable) == S_OK)
+void PDBFileReader::ProcessSymbolRecords(const MSFStream &stream,sU32 start,sU32 size,sBool isModule,SymbolChunk &chunk)
+{
+  const sU8 *p = stream.GetData() + start;
+  const sU8 *end = p + size;
+  sBool inPlace = stream.IsMapped();
+  sInt depth = 0;
+
+  while(p + 4 <= end)
+  {
+    sU32 len = GetU16(p);
+    sU16 kind = GetU16(p + 2);
+    const sU8 *rec = p + 4;
+    const sU8 *recEnd = p + 2 + len;
+
+    if(len < 2 || recEnd > end)
+      break;
+
+    p = recEnd;
+
+    switch(kind)
     {
-      LONG count;
+    case S_GPROC32: case S_LPROC32: case S_GPROC32_ID: case S_LPROC32_ID:
+    case S_LPROC32_DPC: case S_LPROC32_DPC_ID: case S_GPROC32_ST: case S_LPROC32_ST:
+      // parent, end, next, length, debug start/end, type, offset, segment, flags, name
+      depth++;
+      if(rec + 35 <= recEnd)
+      {
+        sBool pascal = kind == S_GPROC32_ST || kind == S_LPROC32_ST;
+        ProcessSymbol(GetU16(rec + 32),GetU32(rec + 28),GetU32(rec + 12),
+          MakeName(rec + 35,recEnd,pascal,true,inPlace,"<noname>",chunk.NameScratch,chunk.Part),chunk);
+      }
+      break;
+
+    case S_THUNK32: case S_THUNK32_ST:
+      // parent, end, next, offset, segment, length, ordinal, name
+      depth++;
+      if(rec + 21 <= recEnd)
+      {
+        ProcessSymbol(GetU16(rec + 16),GetU32(rec + 12),GetU16(rec + 18),
+          MakeName(rec + 21,recEnd,kind == S_THUNK32_ST,true,inPlace,"<noname>",chunk.NameScratch,chunk.Part),chunk);
+      }
+      break;
+
+    case S_BLOCK32: case S_BLOCK32_ST: case S_WITH32: case S_WITH32_ST: case S_SEPCODE:
+      depth++;
+      break;
 
-      secTable->get_Count(&count);
-      Contribs = new SectionContrib[count];
-      nContribs = 0;
+    case S_END: case S_PROC_ID_END:
+      if(depth)
+        depth--;
+      break;
 
-      IDiaSectionContrib *item;
-      while(SUCCEEDED(secTable->Next(1,(IUnknown **)&item,&celt)) && celt == 1)
+    case S_GDATA32: case S_LDATA32: case S_GDATA32_ST: case S_LDATA32_ST:
+      // type, offset, segment, name. Top level data in module streams is
+      // also in the global symbol stream; only function statics aren't.
+      if((!isModule || depth > 0) && rec + 10 <= recEnd)
       {
-        SectionContrib &contrib = Contribs[nContribs++];
-
-        item->get_addressOffset(&contrib.Offset);
-        item->get_addressSection(&contrib.Section);
-        item->get_length(&contrib.Length);
-        item->get_compilandId(&contrib.Compiland);
-
-				BOOL code=FALSE,initData=FALSE,uninitData=FALSE;
-				item->get_code(&code);
-				item->get_initializedData(&initData);
-				item->get_uninitializedData(&uninitData);
-
-				if(code && !initData && !uninitData)
-					contrib.Type = DIC_CODE;
-				else if(!code && initData && !uninitData)
-					contrib.Type = DIC_DATA;
-				else if(!code && !initData && uninitData)
-					contrib.Type = DIC_BSS;
-				else
-					contrib.Type = DIC_UNKNOWN;
-
-				BSTR objFileName = 0;
-				
-				IDiaSymbol *compiland = 0;
-				item->get_compiland(&compiland);
-				if(compiland)
-				{
-					compiland->get_name(&objFileName);
-					compiland->Release();
-				}
-
-				sChar *objFileStr = BStrToString(objFileName,"<noobjfile>");
-				contrib.ObjFile = to.GetFileByName(objFileStr);
-
-				delete[] objFileStr;
-				if(objFileName)
-					SysFreeString(objFileName);
-
-        item->Release();
+        sBool pascal = kind == S_GDATA32_ST || kind == S_LDATA32_ST;
+        ProcessSymbol(GetU16(rec + 8),GetU32(rec + 4),GetTypeSize(GetU32(rec)),
+          MakeName(rec + 10,recEnd,pascal,true,inPlace,"<noname>",chunk.NameScratch,chunk.Part),chunk);
       }
+      break;
+
+    case S_PUB32: case S_PUB32_ST:
+      // flags, offset, segment, name. Everything with a procedure or data
+      // record is in here again, decorated; those are sorted out in
+      // SizePublics. The rest (code and data of objects without debug info,
+      // linker generated stuff) is only ever found through these.
+      if(!isModule && rec + 10 <= recEnd)
+        ProcessPublic(GetU16(rec + 8),GetU32(rec + 4),
+          MakeName(rec + 10,recEnd,kind == S_PUB32_ST,true,inPlace,"<noname>",chunk.NameScratch,chunk.Part),chunk);
+      break;
+    }
+  }
+}
+
+void PDBFileReader::MakeChunks(const DebugInfo &to)
+{
+  // a few chunks per thread, to even out differences in decoding speed
+  sU32 nTarget = GetThreadCount() * 4;
+
+  // module streams: consecutive runs with about the same amount of symbols
+  sU64 total = 0;
+  for(sInt i=0;i<ModuleSymSizes.size();i++)
+    total += ModuleSymSizes[i];
+
+  sU64 chunkSize = total / nTarget + 1;
+  sU64 sum = 0;
+  sU32 first = 0;
 
-      secTable->Release();
+  for(sU32 i=0;i<ModuleStreams.size();i++)
+  {
+    sum += ModuleSymSizes[i];
+    if(sum >= chunkSize || i + 1 == ModuleStreams.size())
+    {
+      Chunks.push_back(new SymbolChunk(false,first,i + 1,to));
+      first = i + 1;
+      sum = 0;
     }
+  }
+
+  // global symbols: pieces of about the same size, split at record boundaries
+  const sU8 *data = GlobalSymbols.GetData();
+  sU32 size = GlobalSymbols.GetSize();
+  sU32 pieceSize = size / nTarget + 1;
+  sU32 start = 0;
+  sU32 pos = 0;
+
+  while(pos + 4 <= size)
+  {
+    sU32 len = GetU16(data + pos);
+    if(len < 2)
+      break;
+
+    pos += 2 + len;
+    if(pos > size)
+      pos = size;
 
-    SysFreeString(vIndex.bstrVal);
-    enumTables->Release();
+    if(pos - start >= pieceSize)
+    {
+      Chunks.push_back(new SymbolChunk(true,start,pos,to));
+      start = pos;
+    }
   }
 
-  // enumerate symbols by (virtual) address
-  IDiaEnumSymbolsByAddr *enumByAddr;
-  if(SUCCEEDED(Session->getSymbolsByAddr(&enumByAddr)))
+  if(start < size)
+    Chunks.push_back(new SymbolChunk(true,start,size,to));
+}
+
+// public symbol order: by address, publics after other symbols there
+struct PublicOrder
+{
+  const DISymbolTable &Symbols;
+  const sArray<sU8> &IsPublic;
+
+  PublicOrder(const DISymbolTable &symbols,const sArray<sU8> &isPublic) : Symbols(symbols),IsPublic(isPublic) {}
+  bool operator()(sInt a,sInt b) const
+  {
+    sU64 va = Symbols.VA[a], vb = Symbols.VA[b];
+    return va < vb || va == vb && (IsPublic[a] < IsPublic[b] || IsPublic[a] == IsPublic[b] && a < b);
+  }
+};
+
+// Publics at or inside a symbol from the module or global streams are
+// duplicates of it; they keep size 0 and FinishedReading drops them with
+// the other double-covers. The others get the space up to the next symbol.
+void PDBFileReader::SizePublics(DebugInfo &to)
+{
+  if(Publics.empty())
+    return;
+
+  DISymbolTable &syms = to.Symbols;
+  sInt count = syms.size();
+  sArray<sU8> isPublic(count,0);
+  sArray<sU64> ends(count,0);
+  for(sInt i=0;i<Publics.size();i++)
   {
-    IDiaSymbol *symbol;
-    // get first symbol to get first RVA (argh)
-    if(SUCCEEDED(enumByAddr->symbolByAddr(1,0,&symbol)))
+    isPublic[Publics[i].Symbol] = 1;
+    ends[Publics[i].Symbol] = Publics[i].End;
+  }
+
+  sArray<sInt> order(count);
+  for(sInt i=0;i<count;i++)
+    order[i] = i;
+
+  std::sort(order.begin(),order.end(),PublicOrder(syms,isPublic));
+
+  // covered ones first; those can't limit the size of any other public
+  sU64 covered = 0;
+  for(sInt i=0;i<count;i++)
+  {
+    sInt in = order[i];
+    sU64 va = syms.VA[in];
+    if(!isPublic[in])
     {
-      DWORD rva;
-      if(symbol->get_relativeVirtualAddress(&rva) == S_OK)
+      if(va + syms.Size[in] > covered)
+        covered = va + syms.Size[in];
+    }
+    else if(va < covered)
+      ends[in] = 0;
+  }
+
+  // then sizes, walking down from the top
+  sU64 next = ~(sU64) 0;
+  for(sInt i=count-1;i>=0;i--)
+  {
+    sInt in = order[i];
+    sU64 va = syms.VA[in];
+    if(isPublic[in])
+    {
+      sU64 end = ends[in] < next ? ends[in] : next;
+      if(end > va)
+        syms.Size.Set(in,end - va);
+    }
+
+    if(i > 0 && syms.VA[order[i-1]] < va)
+      next = va;
+  }
+}
+
+void PDBFileReader::RunJob(sInt index)
+{
+  SymbolChunk &chunk = *Chunks[index];
+
+  if(chunk.Global)
+  {
+    ProcessSymbolRecords(GlobalSymbols,chunk.First,chunk.End - chunk.First,false,chunk);
+    return;
+  }
+
+  MSFStream symbols;
+  for(sU32 i=chunk.First;i<chunk.End;i++)
+  {
+    if(ModuleStreams[i] == NIL_STREAM || !File->OpenStream(ModuleStreams[i],symbols))
+      continue;
+
+    sU32 size = ModuleSymSizes[i];
+    if(size > symbols.GetSize())
+      size = symbols.GetSize();
+
+    if(size > 4) // skip signature
+      ProcessSymbolRecords(symbols,4,size - 4,true,chunk);
+  }
+}
+
+sBool PDBFileReader::ReadEverything(DebugInfo &to)
+{
+  MSFStream dbi;
+  if(!File->OpenStream(PDB_STREAM_DBI,dbi) || dbi.GetSize() < DBI_HEADER_SIZE)
+  {
+    fprintf(stderr,"  PDB has no DBI stream\n");
+    return false;
+  }
+
+  const sU8 *header = dbi.GetData();
+  sU32 symRecordStream = GetU16(header + 20);
+  sU32 modInfoSize = GetU32(header + 24);
+  sU32 secContribSize = GetU32(header + 28);
+  sU32 otherSize = GetU32(header + 32) + GetU32(header + 36) + GetU32(header + 40) + GetU32(header + 52);
+  sU32 dbgHeaderSize = GetU32(header + 48);
+
+  if(sU64(DBI_HEADER_SIZE) + modInfoSize + secContribSize + otherSize + dbgHeaderSize > dbi.GetSize())
+  {
+    fprintf(stderr,"  PDB has a damaged DBI stream\n");
+    return false;
+  }
+
+  const sU8 *modInfo = header + DBI_HEADER_SIZE;
+  const sU8 *secContrib = modInfo + modInfoSize;
+  const sU8 *dbgHeader = secContrib + secContribSize + otherSize;
+
+  // section headers, to turn section:offset pairs into RVAs
+  SectionRVAs.clear();
+  if(dbgHeaderSize >= (DBI_DEBUG_SECTION_HEADERS+1) * 2)
+  {
+    sU32 stream = GetU16(dbgHeader + DBI_DEBUG_SECTION_HEADERS * 2);
+    MSFStream sections;
+
+    if(stream != NIL_STREAM && File->OpenStream(stream,sections))
+    {
+      for(sU32 i=0;i+40<=sections.GetSize();i+=40)
+        SectionRVAs.push_back(GetU32(sections.GetData() + i + 12));
+    }
+  }
+
+  if(SectionRVAs.empty())
+  {
+    fprintf(stderr,"  PDB has no section headers\n");
+    return false;
+  }
+
+  // modules (compilands)
+  sArray<const sU8 *> moduleNames;
+  ModuleStreams.clear();
+  ModuleSymSizes.clear();
+
+  const sU8 *p = modInfo;
+  const sU8 *modEnd = modInfo + modInfoSize;
+  while(p + DBI_MODINFO_HEADER_SIZE < modEnd)
+  {
+    const sU8 *name = p + DBI_MODINFO_HEADER_SIZE;
+    const sU8 *nameEnd = (const sU8 *) memchr(name,0,modEnd - name);
+    const sU8 *objEnd = nameEnd ? (const sU8 *) memchr(nameEnd + 1,0,modEnd - nameEnd - 1) : 0;
+    if(!objEnd)
+      break;
+
+    moduleNames.push_back(name);
+    ModuleStreams.push_back(GetU16(p + 34));
+    ModuleSymSizes.push_back(GetU32(p + 36));
+
+    p = modInfo + ((objEnd + 1 - modInfo + 3) & ~3);
+  }
+
+  // section contributions
+  sArray<sInt> moduleFiles(moduleNames.size(),-1);
+  std::string scratch;
+
+  sU32 version = (secContribSize >= 4) ? GetU32(secContrib) : 0;
+  sU32 entrySize = (version == SC_VERSION_2) ? 32 : 28;
+
+  nContribs = 0;
+  if(version == SC_VERSION_60 || version == SC_VERSION_2)
+  {
+    Contribs = new SectionContrib[(secContribSize - 4) / entrySize];
+
+    for(p = secContrib + 4;p + entrySize <= secContrib + secContribSize;p += entrySize)
+    {
+      SectionContrib &contrib = Contribs[nContribs++];
+
+      contrib.Section = GetU16(p);
+      contrib.Offset = GetU32(p + 4);
+      contrib.Length = GetU32(p + 8);
+      contrib.Compiland = GetU16(p + 16);
+
+      sU32 chars = GetU32(p + 12);
+      sBool code = (chars & IMAGE_SCN_CNT_CODE) != 0;
+      sBool initData = (chars & IMAGE_SCN_CNT_INITIALIZED_DATA) != 0;
+      sBool uninitData = (chars & IMAGE_SCN_CNT_UNINITIALIZED_DATA) != 0;
+
+			if(code && !initData && !uninitData)
+				contrib.Type = DIC_CODE;
+			else if(!code && initData && !uninitData)
+				contrib.Type = DIC_DATA;
+			else if(!code && !initData && uninitData)
+				contrib.Type = DIC_BSS;
+			else
+				contrib.Type = DIC_UNKNOWN;
+
+      if(contrib.Compiland < moduleNames.size())
       {
-        symbol->Release();
+        sInt &file = moduleFiles[contrib.Compiland];
+        if(file < 0)
+          file = to.GetFile(MakeName(moduleNames[contrib.Compiland],modEnd,false,false,dbi.IsMapped(),"<noobjfile>",scratch,to));
 
-        // now, enumerate by rva.
-        if(SUCCEEDED(enumByAddr->symbolByRVA(rva,&symbol)))
-        {
-          do
-          {
-            ProcessSymbol(symbol,to);
-            symbol->Release();
-
-            if(FAILED(enumByAddr->Next(1,&symbol,&celt)))
-              break;
-          }
-          while(celt == 1);
-        }
+        contrib.ObjFile = file;
       }
       else
-        symbol->Release();
+        contrib.ObjFile = to.GetFileByName("<noobjfile>");
     }
 
-    enumByAddr->Release();
+    std::sort(Contribs,Contribs + nContribs);
+
+    // contributions don't reach into the next section
+    ContribIndex.Clear();
+    for(sInt i=0;i<nContribs;i++)
+    {
+      const SectionContrib &contrib = Contribs[i];
+      sU64 maxLength = 0x100000000ULL - contrib.Offset;
+      ContribIndex.Add(((sU64) contrib.Section << 32) | contrib.Offset,contrib.Length < maxLength ? contrib.Length : maxLength);
+    }
+    ContribIndex.Build();
   }
+  else
+    fprintf(stderr,"  unknown section contribution version %08x\n",version);
 
-  // clean up
-  delete[] Contribs;
+  // types, for the size of data symbols
+  ReadTypes();
+
+  // procedures, thunks and function statics are in the module streams,
+  // global and file static data is in the global symbol stream
+  if(symRecordStream == NIL_STREAM || !File->OpenStream(symRecordStream,GlobalSymbols))
+    GlobalSymbols = MSFStream();
+
+  // decode all of them in parallel. Streams that aren't mapped are read
+  // through a single FILE, so those are done on this thread only.
+  MakeChunks(to);
+  ParallelJobs::Run(Chunks.size(),File->IsMapped() ? 0 : 1);
+
+  Publics.clear();
+  for(sInt i=0;i<Chunks.size();i++)
+  {
+    SymbolChunk *chunk = Chunks[i];
+    sInt base = to.Symbols.size();
+    for(sInt j=0;j<chunk->Publics.size();j++)
+    {
+      Publics.push_back(chunk->Publics[j]);
+      Publics.back().Symbol += base;
+    }
+
+    to.MergePart(chunk->Part);
+    delete chunk;
+  }
+
+  SizePublics(to);
+
+  // type and symbol information isn't needed anymore
+  Chunks.clear();
+  GlobalSymbols = MSFStream();
+  sArray<sU32>().swap(ModuleStreams);
+  sArray<sU32>().swap(ModuleSymSizes);
+  TypeStream = MSFStream();
+  sArray<sU32>().swap(TypeOffsets);
+  sArray<sU64>().swap(TypeSizes);
+  UDTSizes.clear();
+  sArray<PublicSymbol>().swap(Publics);
+
+  return true;
 }
 
 /****************************************************************************/
 
-sBool PDBFileReader::ReadDebugInfo(sChar *fileName,DebugInfo &to)
+static sBool ReadFileAt(FILE *f,sU32 offset,void *buffer,sU32 size)
 {
-	static const struct DLLDesc
-	{
-		const char *Filename;
-		IID UseCLSID;
-	} DLLs[] = {
-		"msdia71.dll", __uuidof(DiaSource71),
-		"msdia80.dll", __uuidof(DiaSource80),
-		// add more here as new versions appear (as long as they're backwards-compatible)
-		0
-	};
-
-  sBool readOk = false;
-
-  if(FAILED(CoInitialize(0)))
-	{
-		fprintf(stderr, "  failed to initialize COM\n");
-    return false;
-	}
+  return fseek(f,offset,SEEK_SET) == 0 && fread(buffer,1,size,f) == size;
+}
 
-  IDiaDataSource *source = 0;
-  HRESULT hr = E_FAIL;
+// Looks up the PDB path in the CodeView record of the executable's debug
+// directory. If debugId is given, it gets the GUID and age from there too
+// (see PDBFileReader::GetDebugId).
+static sBool GetPDBPathFromExe(const sChar *exeName,std::string &pdbPath,sU8 *debugId = 0)
+{
+  FILE *f = fopen(exeName,"rb");
+  if(!f)
+    return false;
 
-	// Try creating things "the official way"
-	for(sInt i=0;DLLs[i].Filename;i++)
-	{
-		hr = CoCreateInstance(DLLs[i].UseCLSID,0,CLSCTX_INPROC_SERVER,
-			__uuidof(IDiaDataSource),(void**) &source);
+  sBool found = false;
+  sU8 buffer[264];
 
-		if(SUCCEEDED(hr))
-			break;
-	}
+  sU32 peOffset;
+  if(ReadFileAt(f,0x3c,&peOffset,4) && ReadFileAt(f,peOffset,buffer,24) && !memcmp(buffer,"PE\0\0",4))
+  {
+    sU32 nSections = GetU16(buffer + 6);
+    sU32 optHeaderSize = GetU16(buffer + 20);
+    sU32 optHeader = peOffset + 24;
+
+    // debug directory is data directory #6, position depends on PE32/PE32+
+    sU32 debugDir[2] = { 0,0 };
+    sU16 magic = 0;
+    if(ReadFileAt(f,optHeader,&magic,2))
+    {
+      sU32 dirOffset = (magic == 0x20b) ? 112 : 96;
+      if(dirOffset + 7*8 <= optHeaderSize)
+        ReadFileAt(f,optHeader + dirOffset + 6*8,debugDir,8);
+    }
 
-  if(FAILED(hr))
-  {
-		// None of the classes are registered, but most programmers will have the
-		// DLLs on their system anyway and can copy it over; try loading it directly.
-
-		for(sInt i=0;DLLs[i].Filename;i++)
-		{
-			HMODULE hDIADll = LoadLibrary(DLLs[i].Filename);
-			if(hDIADll)
-			{
-				typedef HRESULT (__stdcall *PDllGetClassObject)(REFCLSID rclsid,REFIID riid,void** ppvObj);
-				PDllGetClassObject DllGetClassObject = (PDllGetClassObject) GetProcAddress(hDIADll,"DllGetClassObject");
-				if(DllGetClassObject)
-				{
-					// first create a class factory
-          IClassFactory *classFactory;
-					hr = DllGetClassObject(DLLs[i].UseCLSID,IID_IClassFactory,(void**) &classFactory);
-					if(SUCCEEDED(hr))
-					{
-						hr = classFactory->CreateInstance(0,__uuidof(IDiaDataSource),(void**) &source);
-						classFactory->Release();
-					}
-				}
-
-				if(SUCCEEDED(hr))
-					break;
-				else
-					FreeLibrary(hDIADll);
-			}
-		}
-  }
-
-  if(source)
-  {
-    wchar_t wideFileName[260];
-    mbstowcs(wideFileName,fileName,260);
-    if(SUCCEEDED(source->loadDataForExe(wideFileName,0,0)))
+    // map its RVA to a file offset
+    sU32 debugDirPos = 0;
+    for(sU32 i=0;i<nSections && debugDir[0];i++)
     {
-      if(SUCCEEDED(source->openSession(&Session)))
+      if(!ReadFileAt(f,optHeader + optHeaderSize + i*40,buffer,40))
+        break;
+
+      sU32 virtSize = GetU32(buffer + 8);
+      sU32 virtAddr = GetU32(buffer + 12);
+      sU32 rawSize = GetU32(buffer + 16);
+      sU32 rawPtr = GetU32(buffer + 20);
+      if(virtSize < rawSize)
+        virtSize = rawSize;
+
+      if(debugDir[0] >= virtAddr && debugDir[0] < virtAddr + virtSize)
       {
-        ReadEverything(to);
+        debugDirPos = debugDir[0] - virtAddr + rawPtr;
+        break;
+      }
+    }
+
+    for(sU32 i=0;debugDirPos && !found && (i+1)*28<=debugDir[1];i++)
+    {
+      sU8 entry[28];
+      if(!ReadFileAt(f,debugDirPos + i*28,entry,28) || GetU32(entry + 12) != 2) // IMAGE_DEBUG_TYPE_CODEVIEW
+        continue;
 
-        readOk = true;
-        Session->Release();
+      sU32 size = GetU32(entry + 16);
+      if(size > sizeof(buffer) - 1)
+        size = sizeof(buffer) - 1;
+
+      if(!ReadFileAt(f,GetU32(entry + 24),buffer,size))
+        continue;
+
+      buffer[size] = 0;
+      if(size > 24 && !memcmp(buffer,"RSDS",4)) // VC7+: signature, guid, age, path
+      {
+        pdbPath = (const sChar *) buffer + 24;
+        if(debugId)
+          sCopyMem(debugId,buffer + 4,20);
+        found = true;
+      }
+      else if(size > 16 && !memcmp(buffer,"NB10",4)) // VC6: signature, offset, timestamp, age, path
+      {
+        pdbPath = (const sChar *) buffer + 16;
+        if(debugId)
+        {
+          memset(debugId,0,20);
+          sCopyMem(debugId,buffer + 8,4);
+          sCopyMem(debugId + 16,buffer + 12,4);
+        }
+        found = true;
       }
-			else
-				fprintf(stderr,"  failed to open DIA session\n");
     }
-		else
-			fprintf(stderr,"  failed to load debug symbols (PDB not found)\n");
+  }
 
-    source->Release();
+  fclose(f);
+  return found;
+}
+
+static const sChar *FileNamePart(const sChar *path)
+{
+  const sChar *name = path;
+  for(const sChar *p=path;*p;p++)
+  {
+    if(*p == '\\' || *p == '/')
+      name = p + 1;
   }
-	else
-		fprintf(stderr,"  couldn't find (or properly initialize) any DIA dll, copying msdia*.dll to app dir might help.\n");
 
-  CoUninitialize();
+  return name;
+}
+
+// GUID and age of a PDB, laid out like GetPDBPathFromExe's. The age that
+// has to match the executable's is the one in the DBI stream; tools that
+// add streams later (source indexing) bump the one in the info stream.
+static sBool GetPDBDebugId(MSFFile &file,sU8 *debugId)
+{
+  // PDB info stream: version, signature, age, then the GUID (VC7+)
+  MSFStream info;
+  if(!file.OpenStream(PDB_STREAM_PDB,info) || info.GetSize() < 12)
+    return false;
+
+  const sU8 *data = info.GetData();
+  memset(debugId,0,20);
+  if(GetU32(data) >= 20000404 && info.GetSize() >= 28)
+    sCopyMem(debugId,data + 12,16);
+  else
+    sCopyMem(debugId,data + 4,4);
+  sCopyMem(debugId + 16,data + 8,4);
+
+  // DBI header: signature, version, age
+  MSFStream dbi;
+  if(file.OpenStream(PDB_STREAM_DBI,dbi) && dbi.GetSize() >= 12)
+    sCopyMem(debugId + 16,dbi.GetData() + 8,4);
+
+  return true;
+}
+
+static sBool IsMatchingPDB(const sChar *pdbName,const sU8 *exeId)
+{
+  if(!MSFFile::IsMSF(pdbName))
+    return false;
+
+  MSFFile file;
+  sU8 pdbId[20];
+  return file.Open(pdbName) && GetPDBDebugId(file,pdbId) && !memcmp(pdbId,exeId,20);
+}
+
+// Same search order as DIA: the path recorded in the executable, then the
+// directory of the executable. Like DIA, PDBs whose GUID and age differ from
+// the executable's are skipped; stale is set to the first of those.
+static sBool FindPDBForExe(const sChar *exeName,std::string &pdbName,std::string &stale)
+{
+  std::string exeDir(exeName,FileNamePart(exeName) - exeName);
+  std::string recorded;
+  sU8 exeId[20];
+
+  sBool hasId = GetPDBPathFromExe(exeName,recorded,exeId);
+  std::string candidates[3];
+  sInt count = 0;
+  if(hasId)
+  {
+    candidates[count++] = recorded;
+    candidates[count++] = exeDir + FileNamePart(recorded.c_str());
+  }
+
+  pdbName = exeName;
+  std::string::size_type dot = pdbName.find_last_of('.');
+  if(dot != std::string::npos && dot >= exeDir.size())
+    pdbName.erase(dot);
+  pdbName += ".pdb";
+  candidates[count++] = pdbName;
+
+  stale.clear();
+  for(sInt i=0;i<count;i++)
+  {
+    // without a debug directory there's nothing to check against
+    if(!hasId ? MSFFile::IsMSF(candidates[i].c_str()) : IsMatchingPDB(candidates[i].c_str(),exeId))
+    {
+      pdbName = candidates[i];
+      return true;
+    }
+
+    if(stale.empty() && MSFFile::IsMSF(candidates[i].c_str()))
+      stale = candidates[i];
+  }
+
+  return false;
+}
+
+sBool PDBFileReader::GetDebugId(const sChar *fileName,sU8 *debugId)
+{
+  if(!MSFFile::IsMSF(fileName))
+  {
+    std::string pdbPath;
+    return GetPDBPathFromExe(fileName,pdbPath,debugId);
+  }
+
+  MSFFile file;
+  return file.Open(fileName) && GetPDBDebugId(file,debugId);
+}
+
+sBool PDBFileReader::ReadDebugInfo(sChar *fileName,DebugInfo &to)
+{
+  std::string pdbName,stale;
+
+  if(MSFFile::IsMSF(fileName))
+    pdbName = fileName;
+  else if(!FindPDBForExe(fileName,pdbName,stale))
+  {
+    if(!stale.empty())
+      fprintf(stderr,"  failed to load debug symbols (%s doesn't match the executable)\n",stale.c_str());
+    else
+      fprintf(stderr,"  failed to load debug symbols (PDB not found)\n");
+    return false;
+  }
+
+  MSFFile file;
+  if(!file.Open(pdbName.c_str()))
+  {
+    fprintf(stderr,"  failed to open %s (not a VC7+ PDB?)\n",pdbName.c_str());
+    return false;
+  }
+
+  File = &file;
+  Contribs = 0;
+  nContribs = 0;
+
+  sBool readOk = ReadEverything(to);
+
+  // names may point into the mapping, so it has to live as long as "to"
+  MappedFile *mapping = file.DetachMapping();
+  if(mapping)
+    to.AddSource(mapping);
+
+  // clean up
+  delete[] Contribs;
+  Contribs = 0;
+  nContribs = 0;
+  ContribIndex.Clear();
+  File = 0;
 
   return readOk;
 }
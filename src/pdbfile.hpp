@@ -6,28 +6,69 @@
 #define __PDBFILE_HPP_
 
 #include "debuginfo.hpp"
+#include "msffile.hpp"
+#include "parallel.hpp"
+#include "addressindex.hpp"
+#include <map>
 
 /****************************************************************************/
 
-class IDiaSession;
-
-class PDBFileReader : public DebugInfoReader
+class PDBFileReader : public DebugInfoReader, private ParallelJobs
 {
   struct SectionContrib;
+  struct SymbolChunk;
+
+  // A public symbol, by index in the DebugInfo it's in. Publics have no
+  // size of their own; they reach up to the next symbol or the end of the
+  // section contribution they're in, whichever comes first.
+  struct PublicSymbol
+  {
+    sInt Symbol;
+    sU64 End;                       // VA of the end of the contribution
+  };
 
   SectionContrib *Contribs;
   sInt nContribs;
+  AddressIndex ContribIndex;        // by section << 32 | offset
+
+  MSFFile *File;
+  sArray<sU32> SectionRVAs;
 
-  IDiaSession *Session;
+  // symbols are decoded in chunks on all cores, then merged
+  sArray<SymbolChunk *> Chunks;
+  sArray<PublicSymbol> Publics;     // symbols still without a size
+  sArray<sU32> ModuleStreams;
+  sArray<sU32> ModuleSymSizes;
+  MSFStream GlobalSymbols;
+
+  // type stream, only used to get the sizes of data symbols
+  MSFStream TypeStream;
+  sArray<sU32> TypeOffsets;
+  sArray<sU64> TypeSizes;
+  std::map<sStringRef,sU64> UDTSizes;
+  sU32 TypeIndexBegin;
 
   const SectionContrib *ContribFromSectionOffset(sU32 section,sU32 offset);
-  void ProcessSymbol(class IDiaSymbol *symbol,DebugInfo &to);
-  void ReadEverything(DebugInfo &to);
+  sU64 GetTypeSize(sU32 typeIndex,sInt depth = 0);
+  void ProcessSymbol(sU32 section,sU32 offset,sU64 length,sInt name,SymbolChunk &chunk);
+  void ProcessPublic(sU32 section,sU32 offset,sInt name,SymbolChunk &chunk);
+  void ProcessSymbolRecords(const MSFStream &stream,sU32 start,sU32 size,sBool isModule,SymbolChunk &chunk);
+
+  void ReadTypes();
+  void MakeChunks(const DebugInfo &to);
+  void RunJob(sInt index);
+  void SizePublics(DebugInfo &to);
+  sBool ReadEverything(DebugInfo &to);
 
 public:
   sBool ReadDebugInfo(sChar *fileName,DebugInfo &to);
+
+  // 16 byte GUID and 4 byte age identifying the PDB of an executable, or
+  // of a PDB itself (VC6: 4 byte signature, zeros, age). false if there's
+  // no such thing, e.g. not a PE file.
+  static sBool GetDebugId(const sChar *fileName,sU8 *debugId);
 };
 
 /****************************************************************************/
 
-#endif
\ No newline at end of file
+#endif
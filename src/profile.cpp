@@ -0,0 +1,165 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#include "profile.hpp"
+#include "mappedfile.hpp"
+#include <cstdio>
+
+/****************************************************************************/
+
+static const sInt SamplesPerBlock = 1 << 20;
+static const sInt ReadChunkSize = 1 << 20;
+
+static inline sBool IsBlank(sChar c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+// parses a hex (0x...) or decimal number, returns 0 if there is none
+static const sChar *ParseNumber(const sChar *p,const sChar *end,sU64 &value)
+{
+  sU64 v = 0;
+  const sChar *start;
+
+  if(end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+  {
+    p += 2;
+    start = p;
+    for(;p<end;p++)
+    {
+      sChar c = *p;
+      if(c >= '0' && c <= '9')      v = (v << 4) | (c - '0');
+      else if(c >= 'a' && c <= 'f') v = (v << 4) | (c - 'a' + 10);
+      else if(c >= 'A' && c <= 'F') v = (v << 4) | (c - 'A' + 10);
+      else break;
+    }
+  }
+  else
+  {
+    start = p;
+    for(;p<end && *p >= '0' && *p <= '9';p++)
+      v = v * 10 + (*p - '0');
+  }
+
+  value = v;
+  return (p != start) ? p : 0;
+}
+
+ProfileReader::ProfileReader()
+{
+  BadLines = 0;
+}
+
+void ProfileReader::FlushBlock(DebugInfo &to)
+{
+  if(!Block.empty())
+    to.AddSamples(&Block[0],Block.size());
+  Block.clear();
+}
+
+// Parses whole lines in [p,end) and returns where parsing stopped. Unless
+// this is the last piece of the file, an unterminated last line is left
+// for the next call.
+const sChar *ProfileReader::ParseLines(const sChar *p,const sChar *end,sBool last,DebugInfo &to)
+{
+  while(p < end)
+  {
+    const sChar *eol = (const sChar *) memchr(p,'\n',end - p);
+    if(!eol)
+    {
+      if(!last)
+        return p;
+      eol = end;
+    }
+
+    while(p < eol && IsBlank(*p))
+      p++;
+
+    if(p < eol && *p != '#')
+    {
+      DISample sample;
+      const sChar *q = ParseNumber(p,eol,sample.RVA);
+      sample.Count = 1;
+
+      if(q)
+      {
+        while(q < eol && (IsBlank(*q) || *q == ','))
+          q++;
+        if(q < eol && *q != '#')
+          q = ParseNumber(q,eol,sample.Count);
+      }
+
+      if(q)
+      {
+        while(q < eol && IsBlank(*q))
+          q++;
+      }
+
+      if(q && (q == eol || *q == '#'))
+      {
+        Block.push_back(sample);
+        if(Block.size() == SamplesPerBlock)
+          FlushBlock(to);
+      }
+      else
+        BadLines++;
+    }
+
+    p = (eol < end) ? eol + 1 : end;
+  }
+
+  return p;
+}
+
+sBool ProfileReader::ReadProfile(const sChar *fileName,DebugInfo &to)
+{
+  Block.clear();
+  Block.reserve(SamplesPerBlock);
+  BadLines = 0;
+
+  MappedFile mapped;
+  if(mapped.Open(fileName))
+  {
+    const sChar *data = (const sChar *) mapped.GetData();
+    ParseLines(data,data + mapped.GetSize(),true,to);
+  }
+  else
+  {
+    // doesn't fit into the address space (or can't be mapped): read it in
+    // chunks, carrying incomplete lines over to the next one
+    FILE *f = fopen(fileName,"rb");
+    if(!f)
+      return false;
+
+    sArray<sChar> buffer(ReadChunkSize);
+    sInt used = 0;
+
+    for(;;)
+    {
+      if(used == buffer.size())
+        buffer.resize(buffer.size() * 2);
+
+      sInt got = (sInt) fread(&buffer[used],1,buffer.size() - used,f);
+      used += got;
+      sBool last = (got == 0);
+
+      const sChar *start = &buffer[0];
+      const sChar *rest = ParseLines(start,start + used,last,to);
+      used -= sInt(rest - start);
+      memmove(&buffer[0],rest,used);
+
+      if(last)
+        break;
+    }
+
+    sBool ok = !ferror(f);
+    fclose(f);
+    if(!ok)
+      return false;
+  }
+
+  FlushBlock(to);
+  sArray<DISample>().swap(Block);
+  return true;
+}
@@ -0,0 +1,36 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __PROFILE_HPP__
+#define __PROFILE_HPP__
+
+#include "debuginfo.hpp"
+
+/****************************************************************************/
+
+// Reads a sample profile and attributes its hits to the symbols of a
+// DebugInfo that has finished reading. The file is text, one sample per
+// line: an RVA (hex with 0x prefix, otherwise decimal) and an optional hit
+// count (default 1), separated by blanks or a comma. Empty lines and lines
+// starting with '#' are skipped. Samples are handed to DebugInfo in big
+// blocks so the lookups can be batched.
+
+class ProfileReader
+{
+  sArray<DISample> Block;
+  sU64 BadLines;
+
+  const sChar *ParseLines(const sChar *p,const sChar *end,sBool last,DebugInfo &to);
+  void FlushBlock(DebugInfo &to);
+
+public:
+  ProfileReader();
+
+  sBool ReadProfile(const sChar *fileName,DebugInfo &to);
+  sU64 GetBadLineCount() const              { return BadLines; }
+};
+
+/****************************************************************************/
+
+#endif
@@ -0,0 +1,149 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#pragma warning(disable:4996)
+#include "types.hpp"
+#include "reportwriter.hpp"
+
+/****************************************************************************/
+
+static const sInt BufferSize = 256*1024;
+
+// length of the formatted text, without the terminating 0
+static sInt FormatLength(const sChar *format,va_list arg)
+{
+#if defined(WIN32)
+  return _vscprintf(format,arg);
+#else
+  va_list copy;
+  va_copy(copy,arg);
+  sInt len = vsnprintf(0,0,format,copy);
+  va_end(copy);
+
+  return len;
+#endif
+}
+
+// returns the length of the formatted text; if that's >= size, it didn't fit
+static sInt FormatInto(sChar *buffer,sInt size,const sChar *format,va_list arg)
+{
+#if defined(WIN32)
+  sInt len = _vsnprintf(buffer,size,format,arg);
+  return (len >= 0 && len < size) ? len : size;
+#else
+  va_list copy;
+  va_copy(copy,arg);
+  sInt len = vsnprintf(buffer,size,format,copy);
+  va_end(copy);
+
+  return len;
+#endif
+}
+
+ReportWriter::ReportWriter()
+{
+  File = 0;
+  OwnFile = false;
+  Buffer = new sChar[BufferSize];
+  Used = 0;
+}
+
+ReportWriter::~ReportWriter()
+{
+  Close();
+  delete[] Buffer;
+}
+
+void ReportWriter::Open(FILE *file)
+{
+  Close();
+  File = file;
+  OwnFile = false;
+}
+
+sBool ReportWriter::Open(const sChar *fileName)
+{
+  Close();
+  File = fopen(fileName,"w");
+  OwnFile = true;
+
+  return File != 0;
+}
+
+void ReportWriter::Close()
+{
+  Flush();
+
+  if(File && OwnFile)
+    fclose(File);
+
+  File = 0;
+  OwnFile = false;
+}
+
+void ReportWriter::Flush()
+{
+  if(File && Used)
+  {
+    fwrite(Buffer,1,Used,File);
+    fflush(File);
+  }
+
+  Used = 0;
+}
+
+void ReportWriter::Write(const sChar *text,sInt len)
+{
+  if(len > BufferSize - Used)
+  {
+    Flush();
+    if(len > BufferSize)
+    {
+      if(File)
+        fwrite(text,1,len,File);
+      return;
+    }
+  }
+
+  sCopyMem(Buffer + Used,text,len);
+  Used += len;
+}
+
+void ReportWriter::PrintF(const sChar *format,...)
+{
+  va_list arg;
+
+  va_start(arg,format);
+  VPrintF(format,arg);
+  va_end(arg);
+}
+
+void ReportWriter::VPrintF(const sChar *format,va_list arg)
+{
+  // usually fits into what's left of the buffer, otherwise make room
+  sInt len = FormatInto(Buffer + Used,BufferSize - Used,format,arg);
+  if(len >= 0 && len < BufferSize - Used)
+  {
+    Used += len;
+    return;
+  }
+
+  Flush();
+  len = FormatInto(Buffer,BufferSize,format,arg);
+  if(len >= 0 && len < BufferSize)
+  {
+    Used = len;
+    return;
+  }
+
+  // longer than the whole buffer
+  len = FormatLength(format,arg);
+  if(len > 0)
+  {
+    sArray<sChar> text(len + 1);
+    FormatInto(&text[0],len + 1,format,arg);
+    Write(&text[0],len);
+  }
+}
+
+/****************************************************************************/
@@ -0,0 +1,43 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __REPORTWRITER_HPP__
+#define __REPORTWRITER_HPP__
+
+#include "types.hpp"
+#include <cstdio>
+#include <cstdarg>
+
+/****************************************************************************/
+
+// Buffered text output for the report. Lines are formatted straight into
+// a big buffer that is written out whenever it fills up (or on Flush), so
+// the report never has to be held in memory as a whole. There's no limit
+// on line length.
+
+class ReportWriter
+{
+  FILE *File;
+  sBool OwnFile;
+  sChar *Buffer;
+  sInt Used;
+
+  void VPrintF(const sChar *format,va_list arg);
+
+public:
+  ReportWriter();
+  ~ReportWriter();
+
+  void Open(FILE *file);                  // e.g. stdout, not closed
+  sBool Open(const sChar *fileName);
+  void Close();
+
+  void Write(const sChar *text,sInt len);
+  void PrintF(const sChar *format,...);
+  void Flush();
+};
+
+/****************************************************************************/
+
+#endif
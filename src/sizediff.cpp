@@ -0,0 +1,304 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#pragma warning(disable:4996)
+#include "types.hpp"
+#include "sizediff.hpp"
+#include "parallel.hpp"
+#include "reportwriter.hpp"
+#include "sutil.h"
+#include <algorithm>
+
+/****************************************************************************/
+
+void SizeByName::Add(const sStringRef &name,sU32 hash,sU64 size)
+{
+  sInt id = Names.Intern(name.Str,name.Len,hash,true);
+  if(id == Sizes.size())
+    Sizes.push_back(size);
+  else
+    Sizes[id] += size;
+}
+
+/****************************************************************************/
+
+static const sChar *DiffSectionNames[DID_COUNT] = { "Symbols", "Object files", "Namespaces", "Templates" };
+static const sChar *DiffTableNames[DID_COUNT] = { "Symbol Size Changes", "Object File Size Changes", "Namespace Size Changes", "Template Size Changes" };
+static const sChar *DiffNameHeaders[DID_COUNT] = { "Symbol/Name", "Object/File", "Namespace/Name", "Template/Name" };
+static const sInt DiffReportSections[DID_COUNT] = { DIR_FUNCTIONS, DIR_FILES, DIR_NAMESPACES, DIR_TEMPLATES };
+static const sChar *ChangeNames[4] = { "added", "removed", "grown", "shrunk" };
+static const sChar *ClassNames[DIC_UNKNOWN+1] = { "end", "code", "data", "bss", "unknown" };
+
+// one job per symbol class, then one each for files, namespaces, templates
+class SizeDiffJobs : public ParallelJobs
+{
+  SizeDiff &Diff;
+
+protected:
+  void RunJob(sInt index)
+  {
+    if(index < DIC_UNKNOWN)
+      Diff.Join(DID_SYMBOLS,index + 1,Diff.ClassDeltas[index + 1]);
+    else
+    {
+      sInt what = index - DIC_UNKNOWN + 1;
+      Diff.Join(what,DIC_UNKNOWN,Diff.Deltas[what]);
+    }
+  }
+
+public:
+  SizeDiffJobs(SizeDiff &diff) : Diff(diff) {}
+
+  static sInt GetJobCount()         { return DIC_UNKNOWN + DID_COUNT - 1; }
+};
+
+SizeDiff::SizeDiff(const DebugInfo &oldInfo,const DebugInfo &newInfo)
+  : Old(oldInfo), New(newInfo)
+{
+}
+
+void SizeDiff::GetSizes(const DebugInfo &info,sInt what,sInt symbolClass,SizeByName &sizes) const
+{
+  const StringPool &strings = info.GetStrings();
+  sInt i;
+
+  switch(what)
+  {
+  case DID_SYMBOLS:
+    for(i=0;i<info.Symbols.size();i++)
+    {
+      if(info.Symbols.Class[i] == symbolClass)
+      {
+        sInt name = info.Symbols.name[i];
+        sizes.Add(strings.Get(name),strings.GetHash(name),info.Symbols.Size[i]);
+      }
+    }
+    break;
+
+  case DID_FILES:
+    for(i=0;i<info.m_Files.size();i++)
+    {
+      const DISymFile &file = info.m_Files[i];
+      sizes.Add(strings.Get(file.fileName),strings.GetHash(file.fileName),file.codeSize + file.dataSize + file.bssSize);
+    }
+    break;
+
+  case DID_NAMESPACES:
+    for(i=0;i<info.NameSps.size();i++)
+    {
+      const DISymNameSp &namesp = info.NameSps[i];
+      sizes.Add(strings.Get(namesp.name),strings.GetHash(namesp.name),namesp.codeSize + namesp.dataSize + namesp.bssSize);
+    }
+    break;
+
+  case DID_TEMPLATES:
+    for(i=0;i<info.Templates.size();i++)
+    {
+      const TemplateSymbol &tsym = info.Templates[i];
+      sStringRef name(tsym.name.c_str(),tsym.name.size());
+      sizes.Add(name,StringPool::Hash(name.Str,name.Len),tsym.size);
+    }
+    break;
+  }
+}
+
+// new build's names are the build side of the join, old ones probe it
+void SizeDiff::Join(sInt what,sInt symbolClass,sArray<SizeDelta> &out) const
+{
+  SizeByName oldSizes, newSizes;
+  GetSizes(Old,what,symbolClass,oldSizes);
+  GetSizes(New,what,symbolClass,newSizes);
+
+  sArray<sU8> matched(newSizes.GetCount(),0);
+  SizeDelta delta;
+  delta.Class = symbolClass;
+
+  out.clear();
+  for(sInt i=0;i<oldSizes.GetCount();i++)
+  {
+    sInt j = newSizes.Find(oldSizes.GetName(i),oldSizes.GetHash(i));
+
+    delta.Name = oldSizes.GetName(i).Str;
+    delta.OldSize = oldSizes.GetSize(i);
+    if(j < 0)
+    {
+      delta.NewSize = 0;
+      delta.Change = DIFF_REMOVED;
+      out.push_back(delta);
+      continue;
+    }
+
+    matched[j] = 1;
+    delta.NewSize = newSizes.GetSize(j);
+    if(delta.NewSize != delta.OldSize)
+    {
+      delta.Change = (delta.NewSize > delta.OldSize) ? DIFF_GROWN : DIFF_SHRUNK;
+      out.push_back(delta);
+    }
+  }
+
+  for(sInt j=0;j<newSizes.GetCount();j++)
+  {
+    if(!matched[j])
+    {
+      delta.Name = newSizes.GetName(j).Str;
+      delta.OldSize = 0;
+      delta.NewSize = newSizes.GetSize(j);
+      delta.Change = DIFF_ADDED;
+      out.push_back(delta);
+    }
+  }
+}
+
+void SizeDiff::Compare()
+{
+  SizeDiffJobs jobs(*this);
+  jobs.Run(SizeDiffJobs::GetJobCount());
+
+  sArray<SizeDelta> &symbols = Deltas[DID_SYMBOLS];
+  symbols.clear();
+  for(sInt i=0;i<=DIC_UNKNOWN;i++)
+  {
+    symbols.insert(symbols.end(),ClassDeltas[i].begin(),ClassDeltas[i].end());
+    sArray<SizeDelta>().swap(ClassDeltas[i]);
+  }
+}
+
+/****************************************************************************/
+
+// biggest change first, ties by index
+struct ByDeltaSize
+{
+  const sArray<SizeDelta> &Deltas;
+  ByDeltaSize(const sArray<SizeDelta> &deltas) : Deltas(deltas) {}
+
+  static sU64 Magnitude(const SizeDelta &d)
+  {
+    return d.NewSize > d.OldSize ? d.NewSize - d.OldSize : d.OldSize - d.NewSize;
+  }
+
+  bool operator()(sInt a,sInt b) const
+  {
+    sU64 ma = Magnitude(Deltas[a]), mb = Magnitude(Deltas[b]);
+    return ma > mb || ma == mb && a < b;
+  }
+};
+
+static const sChar *FormatDelta(sS64 delta,sChar *buffer,sInt size)
+{
+  sSPrintF(buffer,size,"%s%s",delta > 0 ? "+" : "",NVSHARE::formatNumber(delta));
+  return buffer;
+}
+
+void SizeDiff::WriteSection(ReportWriter &out,NVSHARE::HtmlDocument *document,sInt what)
+{
+  const sArray<SizeDelta> &deltas = Deltas[what];
+  sInt maxCount = New.ReportLimits[DiffReportSections[what]].maxCount;
+  sChar buffer[64];
+  sInt i;
+
+  // pick the biggest changes
+  sArray<sInt> list(deltas.size());
+  for(i=0;i<deltas.size();i++)
+    list[i] = i;
+
+  ByDeltaSize order(deltas);
+  if(maxCount > 0 && list.size() > maxCount)
+  {
+    std::partial_sort(list.begin(),list.begin() + maxCount,list.end(),order);
+    list.resize(maxCount);
+  }
+  else
+    std::sort(list.begin(),list.end(),order);
+
+  NVSHARE::HtmlTable *table = document->createHtmlTable(DiffTableNames[what]);
+  if(what == DID_SYMBOLS)
+  {
+    table->addHeader("%s,Symbol/Class,Old/Size,New/Size,Size/Delta,Change/Kind",DiffNameHeaders[what]);
+    table->addSort("Sorted by growth",5,false,3,false);
+    table->addSort("Sorted by shrinkage",5,true,3,false);
+  }
+  else
+  {
+    table->addHeader("%s,Old/Size,New/Size,Size/Delta,Change/Kind",DiffNameHeaders[what]);
+    table->addSort("Sorted by growth",4,false,2,false);
+    table->addSort("Sorted by shrinkage",4,true,2,false);
+  }
+  table->computeTotals();
+
+  out.Flush();
+  out.PrintF("\n%s by size change:\n",DiffSectionNames[what]);
+
+  for(i=0;i<list.size();i++)
+  {
+    const SizeDelta &d = deltas[list[i]];
+    const sChar *name = (what == DID_SYMBOLS) ? GetUndecorate(d.Name) : d.Name;
+
+    table->addColumn(name);
+    if(what == DID_SYMBOLS)
+      table->addColumn(ClassNames[d.Class]);
+    table->addColumn((unsigned long long) d.OldSize);
+    table->addColumn((unsigned long long) d.NewSize);
+    table->addColumn((long long) d.GetDelta());
+    table->addColumn(ChangeNames[d.Change]);
+    table->nextRow();
+
+    out.PrintF("%15s %15s %15s: %s%s%s\n",
+      FormatDelta(d.GetDelta(),buffer,sizeof(buffer)),
+      NVSHARE::formatNumber(d.OldSize),
+      NVSHARE::formatNumber(d.NewSize),
+      name,
+      d.Change == DIFF_ADDED ? " (added)" : d.Change == DIFF_REMOVED ? " (removed)" : "",
+      what == DID_SYMBOLS && d.Class != DIC_CODE ? (d.Class == DIC_DATA ? " [data]" : d.Class == DIC_BSS ? " [bss]" : " [unknown]") : "");
+  }
+
+  sInt counts[4] = { 0, 0, 0, 0 };
+  sS64 net = 0;
+  for(i=0;i<deltas.size();i++)
+  {
+    counts[deltas[i].Change]++;
+    net += deltas[i].GetDelta();
+  }
+
+  out.PrintF("%d added, %d removed, %d grown, %d shrunk, net %s bytes\n",
+    counts[DIFF_ADDED],counts[DIFF_REMOVED],counts[DIFF_GROWN],counts[DIFF_SHRUNK],
+    FormatDelta(net,buffer,sizeof(buffer)));
+}
+
+void SizeDiff::WriteReport(ReportWriter &out)
+{
+  NVSHARE::HtmlTableInterface *iface = NVSHARE::getHtmlTableInterface();
+  NVSHARE::HtmlDocument *document = iface->createHtmlDocument("Executable Size Changes");
+  sChar buffer[64];
+
+  for(sInt i=0;i<DID_COUNT;i++)
+    WriteSection(out,document,i);
+
+  out.Flush();
+
+  static const sChar *overall[3] = { "Overall code:", "Overall data:", "Overall BSS: " };
+  out.PrintF("\n");
+  for(sInt i=0;i<3;i++)
+  {
+    sU64 oldSize = Old.ClassStats[DIC_CODE + i].totalSize;
+    sU64 newSize = New.ClassStats[DIC_CODE + i].totalSize;
+    out.PrintF("%s %15s -> %15s (%s)\n",overall[i],
+      NVSHARE::formatNumber(oldSize),NVSHARE::formatNumber(newSize),
+      FormatDelta(sS64(newSize - oldSize),buffer,sizeof(buffer)));
+  }
+
+  out.Flush();
+
+  size_t len = 0;
+  const char *doc = document->saveDocument(len,NVSHARE::HST_SIMPLE_HTML);
+  fprintf(stderr,"Saving 'exesizer.html'\n");
+  FILE *fph = fopen("exesizer.html","wb");
+  if(fph)
+  {
+    fwrite(doc,len,1,fph);
+    fclose(fph);
+  }
+
+  document->releaseDocumentMemory(doc);
+  iface->releaseHtmlDocument(document);
+}
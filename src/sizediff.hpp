@@ -0,0 +1,85 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __SIZEDIFF_HPP__
+#define __SIZEDIFF_HPP__
+
+#include "debuginfo.hpp"
+
+/****************************************************************************/
+
+// Sizes of named things (symbols of one class, object files, ...) in one
+// build. Names are referenced, not copied, and must be 0-terminated and
+// stay valid; adding a name again adds to its size. Lookups by name use
+// the hash of the name as computed by StringPool::Hash.
+
+class SizeByName
+{
+  StringPool Names;                 // id = item index
+  sArray<sU64> Sizes;
+
+public:
+  void Add(const sStringRef &name,sU32 hash,sU64 size);
+
+  sInt GetCount() const                     { return Sizes.size(); }
+  const sStringRef &GetName(sInt i) const   { return Names.Get(i); }
+  sU32 GetHash(sInt i) const                { return Names.GetHash(i); }
+  sU64 GetSize(sInt i) const                { return Sizes[i]; }
+  sInt Find(const sStringRef &name,sU32 hash) const { return Names.Find(name.Str,name.Len,hash); }
+};
+
+#define DIFF_ADDED		0
+#define DIFF_REMOVED	1
+#define DIFF_GROWN		2
+#define DIFF_SHRUNK		3
+
+struct SizeDelta
+{
+  const sChar *Name;
+  sInt Class;                       // DIC_* for symbols, DIC_UNKNOWN otherwise
+  sInt Change;                      // DIFF_*
+  sU64 OldSize;
+  sU64 NewSize;
+
+  sS64 GetDelta() const             { return sS64(NewSize - OldSize); }
+};
+
+// differences between the sizes in two builds
+#define DID_SYMBOLS		0
+#define DID_FILES		1
+#define DID_NAMESPACES	2
+#define DID_TEMPLATES	3
+#define DID_COUNT		4
+
+// Compares two analyzed DebugInfos (FinishAnalyze done on both). Things are
+// matched by name with a hash join: the new build's names are put into a
+// StringPool, the old build's names are looked up in it with the hashes
+// their own pool already has. Symbols are matched per class; symbols of a
+// class that share a name are added up. The joins run in parallel.
+
+class SizeDiff
+{
+  friend class SizeDiffJobs;
+
+  const DebugInfo &Old;
+  const DebugInfo &New;
+  sArray<SizeDelta> Deltas[DID_COUNT];
+  sArray<SizeDelta> ClassDeltas[DIC_UNKNOWN+1]; // symbols, before merging
+
+  void GetSizes(const DebugInfo &info,sInt what,sInt symbolClass,SizeByName &sizes) const;
+  void Join(sInt what,sInt symbolClass,sArray<SizeDelta> &out) const;
+  void WriteSection(ReportWriter &out,NVSHARE::HtmlDocument *document,sInt what);
+
+public:
+  SizeDiff(const DebugInfo &oldInfo,const DebugInfo &newInfo);
+
+  void Compare();
+  const sArray<SizeDelta> &GetDeltas(sInt what) const { return Deltas[what]; }
+
+  void WriteReport(ReportWriter &out);
+};
+
+/****************************************************************************/
+
+#endif
@@ -0,0 +1,479 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#pragma warning(disable:4996)
+#include "types.hpp"
+#include "snapshot.hpp"
+#include "mappedfile.hpp"
+#include <cstdio>
+
+/****************************************************************************/
+
+static const sChar SnapshotMagic[8] = { 'S','I','Z','E','R','S','N','P' };
+
+struct SnapshotHeader
+{
+  sChar Magic[8];
+  sU32 Version;
+  sU32 SectionCount;
+  sU64 FileSize;
+  sU64 Checksum;                    // of everything after the header
+};
+
+struct SnapshotSection
+{
+  sU64 Offset;
+  sU64 Count;                       // elements
+  sU32 Id;
+  sU32 ElementSize;
+};
+
+// sections, in file order
+enum
+{
+  SS_STRING_OFFSETS,                // sU64, one more than there are strings
+  SS_STRING_HASHES,                 // sU32
+  SS_STRING_TEXT,                   // 0 terminated
+  SS_SYMBOL_NAME,                   // sInt string ids
+  SS_SYMBOL_MANGLEDNAME,
+  SS_SYMBOL_NAMESP,
+  SS_SYMBOL_OBJFILE,
+  SS_SYMBOL_VA,                     // sU64
+  SS_SYMBOL_SIZE,
+  SS_SYMBOL_CLASS,                  // sU8
+  SS_SYMBOL_TEMPLATE,               // sInt, -1 = none
+  SS_FILE_NAME,                     // sInt string ids
+  SS_NAMESP_NAME,
+  SS_TEMPLATE_OFFSETS,              // sU64, one more than there are templates
+  SS_TEMPLATE_TEXT,
+  SS_TEMPLATE_SIZE,                 // sU64
+  SS_TEMPLATE_COUNT,                // sU32
+  SS_COUNT
+};
+
+static const sU32 ElementSizes[SS_COUNT] = { 8,4,1, 4,4,4,4,8,8,1,4, 4,4, 8,1,8,4 };
+
+// 64 bits at a time, size must be a multiple of 8
+static sU64 Checksum(sU64 hash,const sU8 *data,sU64 size)
+{
+  for(sU64 i=0;i<size;i+=8)
+  {
+    sU64 word;
+    sCopyMem(&word,data + i,8);
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29;
+  }
+
+  return hash;
+}
+
+static const sU64 ChecksumSeed = 0x53495a45ull;
+
+static sU64 AlignUp(sU64 x)
+{
+  return (x + 7) & ~7ull;
+}
+
+/****************************************************************************/
+
+// Buffered output that checksums everything it writes. The buffer is
+// only ever written out in multiples of 8 bytes, sections are padded.
+class SnapshotWriter
+{
+  enum { BufferSize = 256*1024 };
+
+  FILE *File;
+  sU8 *Buffer;
+  sInt Used;
+
+  void FlushBuffer()
+  {
+    Hash = Checksum(Hash,Buffer,Used);
+    if(fwrite(Buffer,1,Used,File) != Used)
+      Ok = false;
+    Written += Used;
+    Used = 0;
+  }
+
+public:
+  sU64 Hash;
+  sU64 Written;
+  sBool Ok;
+
+  SnapshotWriter(FILE *file) : File(file), Used(0), Hash(ChecksumSeed), Written(0), Ok(true)
+  {
+    Buffer = new sU8[BufferSize];
+  }
+
+  ~SnapshotWriter()
+  {
+    delete[] Buffer;
+  }
+
+  void Write(const void *data,sU64 size)
+  {
+    const sU8 *src = (const sU8 *) data;
+    while(size)
+    {
+      sInt chunk = BufferSize - Used;
+      if(chunk > size)
+        chunk = (sInt) size;
+
+      sCopyMem(Buffer + Used,src,chunk);
+      Used += chunk;
+      src += chunk;
+      size -= chunk;
+
+      if(Used == BufferSize)
+        FlushBuffer();
+    }
+  }
+
+  void Align()
+  {
+    static const sU8 zeros[8] = { 0 };
+    Write(zeros,AlignUp(Written + Used) - (Written + Used));
+  }
+
+  void Flush()
+  {
+    Align();
+    FlushBuffer();
+  }
+};
+
+template<class T> static void WriteColumn(SnapshotWriter &out,const sArray<T> &column)
+{
+  if(!column.empty())
+    out.Write(&column[0],sU64(column.size()) * sizeof(T));
+  out.Align();
+}
+
+static void WriteColumn(SnapshotWriter &out,const DIU64Column &column)
+{
+  for(sInt i=0;i<column.size();i++)
+  {
+    sU64 value = column[i];
+    out.Write(&value,sizeof(value));
+  }
+  out.Align();
+}
+
+sBool DebugInfoSnapshot::IsSnapshot(const sChar *fileName)
+{
+  sChar magic[sizeof(SnapshotMagic)];
+  FILE *f = fopen(fileName,"rb");
+  if(!f)
+    return false;
+
+  sBool isSnapshot = fread(magic,1,sizeof(magic),f) == sizeof(magic)
+    && !memcmp(magic,SnapshotMagic,sizeof(magic));
+  fclose(f);
+  return isSnapshot;
+}
+
+sBool DebugInfoSnapshot::Save(const sChar *fileName,const DebugInfo &info)
+{
+  const StringPool &strings = info.m_Strings;
+  sInt stringCount = strings.GetCount();
+  sInt symCount = info.Symbols.size();
+  sInt templateCount = info.Templates.size();
+  sInt i;
+
+  sVERIFY(info.m_TemplateBySymbol.size() == symCount);
+
+  sU64 stringBytes = 0;
+  for(i=0;i<stringCount;i++)
+    stringBytes += strings.Get(i).Len + 1;
+
+  sU64 templateBytes = 0;
+  for(i=0;i<templateCount;i++)
+    templateBytes += info.Templates[i].name.size() + 1;
+
+  // section table
+  const sU64 counts[SS_COUNT] =
+  {
+    sU64(stringCount) + 1, sU64(stringCount), stringBytes,
+    sU64(symCount), sU64(symCount), sU64(symCount), sU64(symCount),
+    sU64(symCount), sU64(symCount), sU64(symCount), sU64(symCount),
+    info.m_Files.size(), info.NameSps.size(),
+    sU64(templateCount) + 1, templateBytes, sU64(templateCount), sU64(templateCount)
+  };
+
+  SnapshotSection sections[SS_COUNT];
+  sU64 offset = sizeof(SnapshotHeader) + sizeof(sections);
+  for(i=0;i<SS_COUNT;i++)
+  {
+    sections[i].Offset = offset;
+    sections[i].Count = counts[i];
+    sections[i].Id = i;
+    sections[i].ElementSize = ElementSizes[i];
+    offset = AlignUp(offset + counts[i] * ElementSizes[i]);
+  }
+
+  FILE *f = fopen(fileName,"wb");
+  if(!f)
+    return false;
+
+  SnapshotHeader header;
+  sCopyMem(header.Magic,SnapshotMagic,sizeof(SnapshotMagic));
+  header.Version = Version;
+  header.SectionCount = SS_COUNT;
+  header.FileSize = offset;
+  header.Checksum = 0;
+  sBool ok = fwrite(&header,sizeof(header),1,f) == 1;
+
+  SnapshotWriter out(f);
+  out.Write(sections,sizeof(sections));
+
+  // strings
+  sU64 textOffset = 0;
+  for(i=0;i<=stringCount;i++)
+  {
+    out.Write(&textOffset,sizeof(textOffset));
+    if(i < stringCount)
+      textOffset += strings.Get(i).Len + 1;
+  }
+  out.Align();
+
+  for(i=0;i<stringCount;i++)
+  {
+    sU32 hash = strings.GetHash(i);
+    out.Write(&hash,sizeof(hash));
+  }
+  out.Align();
+
+  for(i=0;i<stringCount;i++)
+    out.Write(strings.Get(i).Str,strings.Get(i).Len + 1);
+  out.Align();
+
+  // symbols
+  const DISymbolTable &syms = info.Symbols;
+  WriteColumn(out,syms.name);
+  WriteColumn(out,syms.mangledName);
+  WriteColumn(out,syms.NameSpNum);
+  WriteColumn(out,syms.objFileNum);
+  WriteColumn(out,syms.VA);
+  WriteColumn(out,syms.Size);
+  WriteColumn(out,syms.Class);
+  WriteColumn(out,info.m_TemplateBySymbol);
+
+  // files, namespaces
+  for(i=0;i<info.m_Files.size();i++)
+    out.Write(&info.m_Files[i].fileName,sizeof(sInt));
+  out.Align();
+
+  for(i=0;i<info.NameSps.size();i++)
+    out.Write(&info.NameSps[i].name,sizeof(sInt));
+  out.Align();
+
+  // templates
+  textOffset = 0;
+  for(i=0;i<=templateCount;i++)
+  {
+    out.Write(&textOffset,sizeof(textOffset));
+    if(i < templateCount)
+      textOffset += info.Templates[i].name.size() + 1;
+  }
+  out.Align();
+
+  for(i=0;i<templateCount;i++)
+    out.Write(info.Templates[i].name.c_str(),info.Templates[i].name.size() + 1);
+  out.Align();
+
+  for(i=0;i<templateCount;i++)
+    out.Write(&info.Templates[i].size,sizeof(sU64));
+  out.Align();
+
+  for(i=0;i<templateCount;i++)
+    out.Write(&info.Templates[i].count,sizeof(sU32));
+  out.Flush();
+
+  sVERIFY(out.Written + sizeof(header) == header.FileSize);
+
+  header.Checksum = out.Hash;
+  ok = ok && out.Ok && fseek(f,0,SEEK_SET) == 0 && fwrite(&header,sizeof(header),1,f) == 1;
+  ok = (fclose(f) == 0) && ok;
+
+  if(!ok)
+    remove(fileName);
+  return ok;
+}
+
+/****************************************************************************/
+
+static sBool Corrupt(const sChar *fileName,const sChar *why)
+{
+  fprintf(stderr,"  %s: %s\n",fileName,why);
+  return false;
+}
+
+sBool DebugInfoSnapshot::Load(const sChar *fileName,DebugInfo &info)
+{
+  MappedFile *mapped = new MappedFile;
+  if(!mapped->Open(fileName))
+  {
+    delete mapped;
+    return Corrupt(fileName,"can't map snapshot");
+  }
+
+  if(!LoadMapped(fileName,*mapped,info))
+  {
+    Reset(info);
+    delete mapped;
+    return false;
+  }
+
+  // strings point into the mapping, so it belongs to info now
+  info.AddSource(mapped);
+  return true;
+}
+
+void DebugInfoSnapshot::Reset(DebugInfo &info)
+{
+  info.m_Strings.Clear();
+  info.Symbols.clear();
+  info.m_TemplateBySymbol.clear();
+  info.m_Files.clear();
+  info.NameSps.clear();
+  info.Templates.clear();
+  info.m_SymbolIndex.Clear();
+}
+
+sBool DebugInfoSnapshot::LoadMapped(const sChar *fileName,const MappedFile &mapped,DebugInfo &info)
+{
+  const sU8 *data = mapped.GetData();
+  sU64 size = mapped.GetSize();
+  sInt i;
+
+  // header and section table
+  SnapshotHeader header;
+  if(size < sizeof(header))
+    return Corrupt(fileName,"snapshot truncated");
+
+  sCopyMem(&header,data,sizeof(header));
+  if(memcmp(header.Magic,SnapshotMagic,sizeof(SnapshotMagic)))
+    return Corrupt(fileName,"not a snapshot");
+  if(header.Version != Version)
+    return Corrupt(fileName,"snapshot from a different version");
+  if(header.FileSize != size || (size - sizeof(header)) % 8 != 0)
+    return Corrupt(fileName,"snapshot truncated");
+  if(header.SectionCount != SS_COUNT || size < sizeof(header) + SS_COUNT * sizeof(SnapshotSection))
+    return Corrupt(fileName,"bad snapshot section table");
+  if(Checksum(ChecksumSeed,data + sizeof(header),size - sizeof(header)) != header.Checksum)
+    return Corrupt(fileName,"snapshot checksum mismatch");
+
+  const SnapshotSection *sections = (const SnapshotSection *) (data + sizeof(header));
+  const void *ptr[SS_COUNT];
+  for(i=0;i<SS_COUNT;i++)
+  {
+    const SnapshotSection &sec = sections[i];
+    if(sec.Id != i || sec.ElementSize != ElementSizes[i] || sec.Offset % 8 != 0 || sec.Offset > size
+      || sec.Count > (size - sec.Offset) / sec.ElementSize)
+      return Corrupt(fileName,"bad snapshot section table");
+
+    ptr[i] = data + sec.Offset;
+  }
+
+  sU64 stringCount = sections[SS_STRING_HASHES].Count;
+  sU64 symCount = sections[SS_SYMBOL_NAME].Count;
+  sU64 templateCount = sections[SS_TEMPLATE_SIZE].Count;
+
+  sBool consistent = sections[SS_STRING_OFFSETS].Count == stringCount + 1
+    && sections[SS_TEMPLATE_OFFSETS].Count == templateCount + 1
+    && sections[SS_TEMPLATE_COUNT].Count == templateCount
+    && stringCount < 0x7fffffff && symCount < 0x7fffffff && templateCount < 0x7fffffff;
+  for(i=SS_SYMBOL_NAME;i<=SS_SYMBOL_TEMPLATE;i++)
+    consistent = consistent && sections[i].Count == symCount;
+  if(!consistent)
+    return Corrupt(fileName,"bad snapshot section table");
+
+  // strings, referenced in place with the hashes they were saved with
+  const sU64 *offsets = (const sU64 *) ptr[SS_STRING_OFFSETS];
+  const sU32 *hashes = (const sU32 *) ptr[SS_STRING_HASHES];
+  const sChar *text = (const sChar *) ptr[SS_STRING_TEXT];
+  sU64 textSize = sections[SS_STRING_TEXT].Count;
+
+  StringPool &strings = info.m_Strings;
+  strings.Reserve((sInt) stringCount);
+  for(i=0;i<(sInt) stringCount;i++)
+  {
+    sU64 start = offsets[i], end = offsets[i+1];
+    if(start >= end || end > textSize || text[end-1] != 0 || end - start > 0x7fffffff)
+      return Corrupt(fileName,"bad snapshot string table");
+    if(strings.Intern(text + start,sInt(end - start - 1),hashes[i],true) != i)
+      return Corrupt(fileName,"bad snapshot string table");
+  }
+
+  // symbols, one copy per column
+  DISymbolTable &syms = info.Symbols;
+  sInt n = (sInt) symCount;
+  syms.name.assign((const sInt *) ptr[SS_SYMBOL_NAME],(const sInt *) ptr[SS_SYMBOL_NAME] + n);
+  syms.mangledName.assign((const sInt *) ptr[SS_SYMBOL_MANGLEDNAME],(const sInt *) ptr[SS_SYMBOL_MANGLEDNAME] + n);
+  syms.NameSpNum.assign((const sInt *) ptr[SS_SYMBOL_NAMESP],(const sInt *) ptr[SS_SYMBOL_NAMESP] + n);
+  syms.objFileNum.assign((const sInt *) ptr[SS_SYMBOL_OBJFILE],(const sInt *) ptr[SS_SYMBOL_OBJFILE] + n);
+  syms.VA.assign((const sU64 *) ptr[SS_SYMBOL_VA],n);
+  syms.Size.assign((const sU64 *) ptr[SS_SYMBOL_SIZE],n);
+  syms.Class.assign((const sU8 *) ptr[SS_SYMBOL_CLASS],(const sU8 *) ptr[SS_SYMBOL_CLASS] + n);
+  info.m_TemplateBySymbol.assign((const sInt *) ptr[SS_SYMBOL_TEMPLATE],(const sInt *) ptr[SS_SYMBOL_TEMPLATE] + n);
+
+  // files and namespaces; their sizes are filled in by the analysis
+  const sInt *fileNames = (const sInt *) ptr[SS_FILE_NAME];
+  info.m_Files.resize(sections[SS_FILE_NAME].Count);
+  for(i=0;i<info.m_Files.size();i++)
+  {
+    DISymFile &file = info.m_Files[i];
+    file.fileName = fileNames[i];
+    file.codeSize = file.dataSize = file.bssSize = file.hits = 0;
+  }
+
+  const sInt *namespNames = (const sInt *) ptr[SS_NAMESP_NAME];
+  info.NameSps.resize(sections[SS_NAMESP_NAME].Count);
+  for(i=0;i<info.NameSps.size();i++)
+  {
+    DISymNameSp &namesp = info.NameSps[i];
+    namesp.name = namespNames[i];
+    namesp.codeSize = namesp.dataSize = namesp.bssSize = namesp.hits = 0;
+  }
+
+  // templates
+  const sU64 *templateOffsets = (const sU64 *) ptr[SS_TEMPLATE_OFFSETS];
+  const sChar *templateText = (const sChar *) ptr[SS_TEMPLATE_TEXT];
+  sU64 templateTextSize = sections[SS_TEMPLATE_TEXT].Count;
+  const sU64 *templateSizes = (const sU64 *) ptr[SS_TEMPLATE_SIZE];
+  const sU32 *templateCounts = (const sU32 *) ptr[SS_TEMPLATE_COUNT];
+
+  info.Templates.resize((sInt) templateCount);
+  for(i=0;i<(sInt) templateCount;i++)
+  {
+    sU64 start = templateOffsets[i], end = templateOffsets[i+1];
+    if(start >= end || end > templateTextSize)
+      return Corrupt(fileName,"bad snapshot template table");
+
+    TemplateSymbol &tsym = info.Templates[i];
+    tsym.name.assign(templateText + start,end - start - 1);
+    tsym.size = templateSizes[i];
+    tsym.count = templateCounts[i];
+    tsym.hits = 0;
+  }
+
+  // ids must point at something
+  sInt fileCount = info.m_Files.size(), namespCount = info.NameSps.size();
+  for(i=0;i<n;i++)
+  {
+    if(sU32(syms.name[i]) >= stringCount || sU32(syms.mangledName[i]) >= stringCount
+      || sU32(syms.objFileNum[i]) >= sU32(fileCount) || sU32(syms.NameSpNum[i]) >= sU32(namespCount)
+      || syms.Class[i] > DIC_UNKNOWN || info.m_TemplateBySymbol[i] >= (sInt) templateCount || info.m_TemplateBySymbol[i] < -1)
+      return Corrupt(fileName,"bad snapshot symbol table");
+  }
+
+  for(i=0;i<fileCount;i++)
+    if(sU32(info.m_Files[i].fileName) >= stringCount)
+      return Corrupt(fileName,"bad snapshot file table");
+  for(i=0;i<namespCount;i++)
+    if(sU32(info.NameSps[i].name) >= stringCount)
+      return Corrupt(fileName,"bad snapshot namespace table");
+
+  info.BuildSymbolIndex();
+  return true;
+}
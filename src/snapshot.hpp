@@ -0,0 +1,42 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __SNAPSHOT_HPP__
+#define __SNAPSHOT_HPP__
+
+#include "debuginfo.hpp"
+
+/****************************************************************************/
+
+// Parsed debug info saved to disk, so later runs can skip the PDB. A
+// snapshot holds what FinishedReading leaves behind: strings, symbols in
+// address order, object files, namespaces and templates. The file is a
+// header, a section table and the sections, each a flat array starting
+// on an 8 byte boundary. Loading maps the file and copies every column in
+// one go; strings are referenced in place. The header has a version and
+// a checksum over the rest of the file, anything that doesn't match is
+// refused. Numbers are stored in the machine's byte order.
+
+class MappedFile;
+
+class DebugInfoSnapshot
+{
+  static sBool LoadMapped(const sChar *fileName,const MappedFile &mapped,DebugInfo &info);
+  static void Reset(DebugInfo &info);
+
+public:
+  enum { Version = 1 };
+
+  static sBool IsSnapshot(const sChar *fileName);
+
+  // info must have finished reading
+  static sBool Save(const sChar *fileName,const DebugInfo &info);
+  // into a DebugInfo that has just been Init()ed; don't call FinishedReading.
+  // On failure info is left as it was.
+  static sBool Load(const sChar *fileName,DebugInfo &info);
+};
+
+/****************************************************************************/
+
+#endif
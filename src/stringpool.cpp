@@ -0,0 +1,179 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+#include "types.hpp"
+#include "stringpool.hpp"
+
+/****************************************************************************/
+
+static const sInt BlockSize = 256*1024;
+static const sInt BigString = BlockSize / 16; // gets its own block
+static const sU32 InitialSlots = 1024;
+
+StringPool::StringPool()
+{
+  SlotMask = 0;
+  BlockPtr = 0;
+  BlockLeft = 0;
+  ArenaBytes = 0;
+}
+
+StringPool::~StringPool()
+{
+  Clear();
+}
+
+void StringPool::Clear()
+{
+  for(sInt i=0;i<Blocks.size();i++)
+    delete[] Blocks[i];
+
+  sArray<sChar *>().swap(Blocks);
+  sArray<sStringRef>().swap(Strings);
+  sArray<sU32>().swap(Hashes);
+  sArray<Slot>().swap(Slots);
+  SlotMask = 0;
+  BlockPtr = 0;
+  BlockLeft = 0;
+  ArenaBytes = 0;
+}
+
+// FNV-1a
+sU32 StringPool::Hash(const sChar *s,sInt len)
+{
+  sU32 hash = 2166136261u;
+  for(sInt i=0;i<len;i++)
+    hash = (hash ^ (sU8) s[i]) * 16777619u;
+
+  return hash;
+}
+
+const sChar *StringPool::Store(const sChar *s,sInt len)
+{
+  sChar *out;
+
+  if(len + 1 > BigString)
+  {
+    out = new sChar[len + 1];
+    Blocks.push_back(out);
+  }
+  else
+  {
+    if(len + 1 > BlockLeft)
+    {
+      BlockPtr = new sChar[BlockSize];
+      BlockLeft = BlockSize;
+      Blocks.push_back(BlockPtr);
+    }
+
+    out = BlockPtr;
+    BlockPtr += len + 1;
+    BlockLeft -= len + 1;
+  }
+
+  sCopyMem(out,s,len);
+  out[len] = 0;
+  ArenaBytes += len + 1;
+  return out;
+}
+
+void StringPool::Grow()
+{
+  Rehash(Slots.empty() ? InitialSlots : Slots.size() * 2);
+}
+
+void StringPool::Reserve(sInt count)
+{
+  sU32 slots = Slots.empty() ? InitialSlots : Slots.size();
+  while(sU32(count) * 2 > slots)
+    slots *= 2;
+
+  if(slots != Slots.size())
+    Rehash(slots);
+
+  Strings.reserve(count);
+  Hashes.reserve(count);
+}
+
+void StringPool::Rehash(sU32 count)
+{
+  Slot empty = { 0,-1 };
+  Slots.assign(count,empty);
+  SlotMask = count - 1;
+
+  for(sInt id=0;id<Strings.size();id++)
+  {
+    sU32 i = Hashes[id] & SlotMask;
+    while(Slots[i].Id >= 0)
+      i = (i + 1) & SlotMask;
+
+    Slots[i].Hash = Hashes[id];
+    Slots[i].Id = id;
+  }
+}
+
+sInt StringPool::Find(const sChar *s,sInt len,sU32 hash) const
+{
+  if(Slots.empty())
+    return -1;
+
+  for(sU32 i=hash & SlotMask;Slots[i].Id >= 0;i=(i + 1) & SlotMask)
+  {
+    const Slot &slot = Slots[i];
+    if(slot.Hash == hash)
+    {
+      const sStringRef &str = Strings[slot.Id];
+      if(str.Len == len && !memcmp(str.Str,s,len))
+        return slot.Id;
+    }
+  }
+
+  return -1;
+}
+
+sInt StringPool::Intern(const sChar *s,sInt len,sU32 hash,sBool persistent)
+{
+  // keep the table at most half full
+  if((Strings.size() + 1) * 2 > Slots.size())
+    Grow();
+
+  sU32 i;
+  for(i=hash & SlotMask;Slots[i].Id >= 0;i=(i + 1) & SlotMask)
+  {
+    const Slot &slot = Slots[i];
+    if(slot.Hash == hash)
+    {
+      const sStringRef &str = Strings[slot.Id];
+      if(str.Len == len && !memcmp(str.Str,s,len))
+        return slot.Id;
+    }
+  }
+
+  sInt id = Strings.size();
+  Strings.push_back(sStringRef(persistent ? s : Store(s,len),len));
+  Hashes.push_back(hash);
+  Slots[i].Hash = hash;
+  Slots[i].Id = id;
+
+  return id;
+}
+
+void StringPool::TakeArena(StringPool &other)
+{
+  Blocks.insert(Blocks.end(),other.Blocks.begin(),other.Blocks.end());
+  ArenaBytes += other.ArenaBytes;
+
+  other.Blocks.clear();
+  other.BlockPtr = 0;
+  other.BlockLeft = 0;
+  other.ArenaBytes = 0;
+}
+
+sU64 StringPool::GetTableBytes() const
+{
+  return sU64(Strings.capacity()) * sizeof(sStringRef)
+    + sU64(Hashes.capacity()) * sizeof(sU32)
+    + sU64(Slots.capacity()) * sizeof(Slot);
+}
+
+/****************************************************************************/
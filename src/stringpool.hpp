@@ -0,0 +1,73 @@
+// Executable size report utility.
+// Aras Pranckevicius, http://aras-p.info/projSizer.html
+// Based on code by Fabian "ryg" Giesen, http://farbrausch.com/~fg/
+
+#ifndef __STRINGPOOL_HPP__
+#define __STRINGPOOL_HPP__
+
+#include "types.hpp"
+
+/****************************************************************************/
+
+// Interned strings with stable integer ids. Each unique string is stored
+// once, zero terminated, in a bump allocated arena (or not at all if the
+// caller guarantees it outlives the pool); lookup is an open addressing
+// hash table. Callers that already know the hash of a string can pass it
+// in, substrings can be interned without copying them anywhere first.
+
+class StringPool
+{
+  struct Slot
+  {
+    sU32 Hash;
+    sInt Id;                        // -1 = empty
+  };
+
+  sArray<sStringRef> Strings;       // by id
+  sArray<sU32> Hashes;              // by id
+  sArray<Slot> Slots;
+  sU32 SlotMask;
+
+  sArray<sChar *> Blocks;
+  sChar *BlockPtr;
+  sInt BlockLeft;
+  sU64 ArenaBytes;                  // taken by strings, not what's allocated
+
+  const sChar *Store(const sChar *s,sInt len);
+  void Grow();
+  void Rehash(sU32 slotCount);
+
+public:
+  StringPool();
+  ~StringPool();
+
+  void Clear();
+  void Reserve(sInt count);         // room for count strings without rehashing
+
+  static sU32 Hash(const sChar *s,sInt len);
+
+  // returns the id of s[0..len-1], adding it if it's new. New strings are
+  // copied into the arena unless "persistent": s[len] is 0 and s stays
+  // valid for as long as the pool does.
+  sInt Intern(const sChar *s,sInt len,sU32 hash,sBool persistent = false);
+  sInt Intern(const sChar *s,sInt len)      { return Intern(s,len,Hash(s,len)); }
+
+  // -1 if not there
+  sInt Find(const sChar *s,sInt len,sU32 hash) const;
+
+  sInt GetCount() const                     { return Strings.size(); }
+  const sStringRef &Get(sInt id) const      { return Strings[id]; }
+  const sChar *GetString(sInt id) const     { return Strings[id].Str; }
+  sU32 GetHash(sInt id) const               { return Hashes[id]; }
+
+  // moves the other pool's arena over, so its strings stay valid as long
+  // as we do (the other pool must not be used anymore, except for Clear)
+  void TakeArena(StringPool &other);
+
+  sU64 GetArenaBytes() const                { return ArenaBytes; }
+  sU64 GetTableBytes() const;
+};
+
+/****************************************************************************/
+
+#endif
@@ -64,7 +64,16 @@
 
 #if defined(LINUX) || defined(PLAYSTATION3)
 #include <math.h>
-#include "linux_compat.h"
+#include <strings.h>
+#include <ctype.h>
+#define stricmp(a,b) strcasecmp(a,b)
+#define _finite(a) isfinite(a)
+static char * strlwr(char *str)
+{
+	for (char *scan=str; *scan; scan++)
+		*scan = (char)tolower(*scan);
+	return str;
+}
 #endif
 
 namespace NVSHARE
@@ -687,26 +696,29 @@ const char	*fstring(float v)
 static	char  gFormat[MAXNUMERIC*MAXFNUM];
 static int    gIndex=0;
 
-const char * formatNumber(int number) // JWR  format this integer into a fancy comma delimited string
+const char * formatNumber(long long number) // JWR  format this integer into a fancy comma delimited string
 {
 	char * dest = &gFormat[gIndex*MAXNUMERIC];
 	gIndex++;
 	if ( gIndex == MAXFNUM ) gIndex = 0;
 
-	char scratch[512];
-
-#if defined (LINUX_GENERIC) || defined(LINUX) || defined(__CELLOS_LV2__)
-	snprintf(scratch, 10, "%d", number);
-#else
-	itoa(number,scratch,10);
-#endif
+	char scratch[MAXNUMERIC];
+	unsigned long long v = number < 0 ? 0ULL-(unsigned long long)number : (unsigned long long)number;
+	int len = 0;
+	do
+	{
+		scratch[len++] = (char)('0' + v%10);
+		v/=10;
+	} while ( v );
 
 	char *str = dest;
-	unsigned int len = (unsigned int)strlen(scratch);
-	for (unsigned int i=0; i<len; i++)
+	if ( number < 0 )
+	{
+		*str++ = '-';
+	}
+	for (int place=len-1; place>=0; place--)
 	{
-		int place = (len-1)-i;
-		*str++ = scratch[i];
+		*str++ = scratch[place];
 		if ( place && (place%3) == 0 ) *str++ = ',';
 	}
 	*str = 0;
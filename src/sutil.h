@@ -86,7 +86,7 @@ const char *   lastDot(const char *src);
 const char *   lastSlash(const char *src); // last forward or backward slash character, null if none found.
 const char *   lastChar(const char *src,char c);
 const char  	*fstring(float v);
-const char *   formatNumber(int number); // JWR  format this integer into a fancy comma delimited string
+const char *   formatNumber(long long number); // JWR  format this integer into a fancy comma delimited string
 bool           fqnMatch(const char *n1,const char *n2); // returns true if two fully specified file names are 'the same' but ignores case sensitivty and treats either a forward or backslash as the same character.
 bool           getBool(const char *str);
 bool           needsQuote(const char *str); // if this string needs quotes around it (spaces, commas, #, etc)
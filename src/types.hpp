@@ -7,6 +7,9 @@
 #include <cstring>
 #include <string>
 #include <cassert>
+#if !defined(WIN32)
+#include <strings.h>
+#endif
 
 #pragma warning(disable:4018)
 #pragma warning(disable:4267)
@@ -16,11 +19,31 @@ typedef signed int sInt;
 typedef char sChar;
 typedef float sF32;
 typedef double sF64;
+typedef unsigned char sU8;
+typedef unsigned short sU16;
 typedef unsigned int sU32;
+typedef unsigned long long sU64;
+typedef signed long long sS64;
 typedef bool sBool;
 
 #define sArray std::vector
 
+// Pointer + length string that doesn't own its characters.
+struct sStringRef
+{
+  const sChar *Str;
+  sInt Len;
+
+  sStringRef() : Str(""), Len(0) {}
+  sStringRef(const sChar *str,sInt len) : Str(str), Len(len) {}
+
+  bool operator <(const sStringRef &b) const
+  {
+    int cmp = memcmp(Str,b.Str,Len < b.Len ? Len : b.Len);
+    return cmp < 0 || cmp == 0 && Len < b.Len;
+  }
+};
+
 inline sChar* sCopyString( sChar* a, const sChar* b, int len )
 {
 	return strncpy( a, b, len );
@@ -28,9 +51,14 @@ inline sChar* sCopyString( sChar* a, const sChar* b, int len )
 
 #define sCopyMem memcpy
 #define sFindString strstr
-#define sSPrintF _snprintf
 #define sGetStringLen strlen
+#if defined(WIN32)
+#define sSPrintF _snprintf
 #define sCmpStringI stricmp
+#else
+#define sSPrintF snprintf
+#define sCmpStringI strcasecmp
+#endif
 #define sAppendString strncat
 #define sSwap std::swap
 #define sVERIFY assert
\ No newline at end of file